@@ -6,76 +6,218 @@
 
 #include "paraformer-server.h"
 
+DecodePool::DecodePool(int num_threads) {
+  for (int i = 0; i < num_threads; i++) {
+    workers_.emplace_back(&DecodePool::WorkerFunc, this);
+  }
+}
+
+DecodePool::~DecodePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void DecodePool::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  cond_.notify_one();
+}
+
+void DecodePool::WorkerFunc() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
 GrpcEngine::GrpcEngine(
-  grpc::ServerReaderWriter<Response, Request>* stream,
-  std::shared_ptr<FUNASR_HANDLE> asr_handler)
-  : stream_(std::move(stream)),
-    asr_handler_(std::move(asr_handler)) {
+  ASR::AsyncService* service,
+  grpc::ServerCompletionQueue* cq,
+  std::shared_ptr<FUNASR_HANDLE> asr_handler,
+  DecodePool* decode_pool,
+  funasr::AdmissionControl* admission)
+  : service_(service),
+    cq_(cq),
+    stream_(&context_),
+    connect_tag_{this, CONNECT},
+    read_tag_{this, READ},
+    write_tag_{this, WRITE},
+    finish_tag_{this, FINISH},
+    asr_handler_(std::move(asr_handler)),
+    decode_pool_(decode_pool),
+    admission_(admission),
+    punc_cache_(2) {
 
   request_ = std::make_shared<Request>();
+  service_->RequestRecognize(&context_, &stream_, cq_, cq_, &connect_tag_);
 }
 
-void GrpcEngine::DecodeThreadFunc() {
-  FUNASR_HANDLE tpass_online_handler = FunTpassOnlineInit(*asr_handler_, chunk_size_);
-  int step = (sampling_rate_ * step_duration_ms_ / 1000) * 2; // int16 = 2bytes;
-  std::vector<std::vector<std::string>> punc_cache(2);
+void GrpcEngine::DecodeStep(const char* data, int len, bool is_final) {
+  FUNASR_RESULT result = nullptr;
+  try {
+    result = FunTpassInferBuffer(*asr_handler_,
+                                 tpass_online_handler_,
+                                 data,
+                                 len,
+                                 punc_cache_,
+                                 is_final,
+                                 sampling_rate_,
+                                 encoding_,
+                                 mode_);
+  } catch (std::exception const& e) {
+    LOG(ERROR) << e.what();
+  }
 
-  bool is_final = false;
-  std::string online_result = "";
-  std::string tpass_result = "";
+  if (result) {
+    std::string online_message = FunASRGetResult(result, 0);
+    if(online_message != ""){
+      Response response;
+      response.set_mode(DecodeMode::online);
+      response.set_text(online_message);
+      response.set_is_final(is_final);
+      Send(response);
+      LOG(INFO) << "send online results: " << online_message;
+    }
+    std::string tpass_message = FunASRGetTpassResult(result, 0);
+    if(tpass_message != ""){
+      Response response;
+      response.set_mode(DecodeMode::two_pass);
+      response.set_text(tpass_message);
+      response.set_is_final(is_final);
+      Send(response);
+      LOG(INFO) << "send offline results: " << tpass_message;
+    }
+    FunASRFreeResult(result);
+  }
+}
 
-  LOG(INFO) << "Decoder init, start decoding loop with mode";
+// runs on the decode pool, decodes what has been received so far and returns
+// instead of waiting for more, the next read schedules it again
+void GrpcEngine::DecodeThreadFunc() {
+  bool is_cancelled = false;
+  {
+    std::lock_guard<std::mutex> lock(*p_mutex_);
+    is_cancelled = is_cancelled_;
+  }
+  if (tpass_online_handler_ == nullptr && !is_cancelled) {
+    tpass_online_handler_ = FunTpassOnlineInit(*asr_handler_, chunk_size_);
+    LOG(INFO) << "Decoder init, start decoding with mode " << mode_;
+  }
 
   while (true) {
-    if (audio_buffer_.length() > step || is_end_) {
-      if (audio_buffer_.length() <= step && is_end_) {
-        is_final = true;
-        step = audio_buffer_.length();
+    bool is_end = false;
+    bool is_cancelled = false;
+    {
+      std::lock_guard<std::mutex> lock(*p_mutex_);
+      decode_buffer_ += audio_buffer_;
+      audio_buffer_.clear();
+      is_end = is_end_;
+      is_cancelled = is_cancelled_;
+    }
+
+    // whole steps while more than one step is buffered, what is left goes
+    // in the final step
+    size_t offset = 0;
+    while (!is_cancelled && decode_buffer_.length() - offset > step_) {
+      DecodeStep(decode_buffer_.data() + offset, step_, false);
+      offset += step_;
+    }
+    decode_buffer_.erase(0, offset);
+
+    if (is_end) {
+      if (!is_cancelled) {
+        DecodeStep(decode_buffer_.data(), decode_buffer_.length(), true);
+      }
+      if (tpass_online_handler_ != nullptr) {
+        FunTpassOnlineUninit(tpass_online_handler_);
+        tpass_online_handler_ = nullptr;
       }
+      decode_buffer_.clear();
+    }
 
-      FUNASR_RESULT result = FunTpassInferBuffer(*asr_handler_,
-                                                 tpass_online_handler,
-                                                 audio_buffer_.c_str(),
-                                                 step,
-                                                 punc_cache,
-                                                 is_final,
-                                                 sampling_rate_,
-                                                 encoding_,
-                                                 mode_);
-      p_mutex_->lock();
-      audio_buffer_ = audio_buffer_.substr(step);
-      p_mutex_->unlock();
-
-      if (result) {
-        std::string online_message = FunASRGetResult(result, 0);
-        online_result += online_message;
-        if(online_message != ""){
-          Response response;
-          response.set_mode(DecodeMode::online);
-          response.set_text(online_message);
-          response.set_is_final(is_final);
-          stream_->Write(response);
-          LOG(INFO) << "send online results: " << online_message;
-        }
-        std::string tpass_message = FunASRGetTpassResult(result, 0);
-        tpass_result += tpass_message;
-        if(tpass_message != ""){
-          Response response;
-          response.set_mode(DecodeMode::two_pass);
-          response.set_text(tpass_message);
-          response.set_is_final(is_final);
-          stream_->Write(response);
-          LOG(INFO) << "send offline results: " << tpass_message;
-        }
-        FunASRFreeResult(result);
+    bool finish = false;
+    {
+      std::lock_guard<std::mutex> lock(*p_mutex_);
+      if (!is_end && (is_end_ || decode_buffer_.length() + audio_buffer_.length() > step_)) {
+        continue;
       }
+      is_decoding_ = false;
+      is_decoded_ = is_end;
+      finish = ReadyToFinishLocked();
+    }
+    if (finish) {
+      // the stream may be deleted as soon as Finish is issued
+      stream_.Finish(finish_status_, &finish_tag_);
+    }
+    return;
+  }
+}
 
-      if (is_final) {
-        FunTpassOnlineUninit(tpass_online_handler);
-        break;
+void GrpcEngine::ScheduleDecodeLocked() {
+  // decode_buffer_ is not touched while no task of this stream is running
+  if (is_decoding_ || is_decoded_ || !is_start_) {
+    return;
+  }
+  if (is_end_ || audio_buffer_.length() + decode_buffer_.length() > step_) {
+    // the ticket covers the audio handed over now, a running task also
+    // takes what arrives while it decodes
+    funasr::AdmissionTicket ticket;
+    if (!is_cancelled_) {
+      ticket = admission_->Admit(audio_buffer_.length(), sampling_rate_);
+      if (!ticket) {
+        RejectLocked("server busy");
       }
     }
-    sleep(0.001);
+    // a cancelled stream only runs its last task, which frees the decoder
+    if (is_cancelled_ && !is_end_) {
+      return;
+    }
+    is_decoding_ = true;
+    decode_pool_->Post([this, ticket]() { DecodeThreadFunc(); });
+  }
+}
+
+void GrpcEngine::RejectLocked(const std::string& reason) {
+  LOG(WARNING) << "reject stream: " << reason;
+  is_cancelled_ = true;
+  audio_buffer_.clear();
+  finish_status_ = grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, reason);
+}
+
+bool GrpcEngine::ReadyToFinishLocked() {
+  if (is_finishing_ || !is_decoded_ || !write_queue_.empty()) {
+    return false;
+  }
+  is_finishing_ = true;
+  return true;
+}
+
+void GrpcEngine::Send(Response& response) {
+  std::lock_guard<std::mutex> lock(*p_mutex_);
+  if (is_cancelled_) {
+    return;
+  }
+  // one write in flight per stream, the rest wait for its completion
+  write_queue_.push_back(response);
+  if (write_queue_.size() == 1) {
+    stream_.Write(write_queue_.front(), &write_tag_);
   }
 }
 
@@ -95,6 +237,7 @@ void GrpcEngine::OnSpeechStart() {
     sampling_rate_ = request_->sampling_rate();
   }
   LOG(INFO) << "sampling_rate is " << sampling_rate_;
+  step_ = (sampling_rate_ * step_duration_ms_ / 1000) * 2; // int16 = 2bytes;
 
   switch(request_->wav_format()) {
     case WavFormat::pcm: encoding_ = "pcm";
@@ -117,47 +260,101 @@ void GrpcEngine::OnSpeechStart() {
       break;
   }
   LOG(INFO) << "decode mode is " << mode_str;
-  
-  decode_thread_ = std::make_shared<std::thread>(&GrpcEngine::DecodeThreadFunc, this);
+
+  std::lock_guard<std::mutex> lock(*p_mutex_);
   is_start_ = true;
 }
 
-void GrpcEngine::OnSpeechData() {
-  p_mutex_->lock();
+bool GrpcEngine::OnSpeechData() {
+  std::lock_guard<std::mutex> lock(*p_mutex_);
+  if (is_cancelled_) {
+    return false;
+  }
   audio_buffer_ += request_->audio_data();
-  p_mutex_->unlock();
+  if (admission_->ConnectionOverLimit(audio_buffer_.length())) {
+    RejectLocked("stream audio over limit");
+    return false;
+  }
+  ScheduleDecodeLocked();
+  return !is_cancelled_;
 }
 
 void GrpcEngine::OnSpeechEnd() {
-  is_end_ = true;
-  LOG(INFO) << "Read all pcm data, wait for decoding thread";
-  if (decode_thread_ != nullptr) {
-    decode_thread_->join();
+  bool finish = false;
+  {
+    std::lock_guard<std::mutex> lock(*p_mutex_);
+    is_end_ = true;
+    if (is_start_) {
+      LOG(INFO) << "Read all pcm data, wait for decoding";
+      ScheduleDecodeLocked();
+    } else {
+      is_decoded_ = true;
+    }
+    finish = ReadyToFinishLocked();
+  }
+  if (finish) {
+    stream_.Finish(finish_status_, &finish_tag_);
   }
 }
 
-void GrpcEngine::operator()() {
-  try {
-    LOG(INFO) << "start engine main loop";
-    while (stream_->Read(request_.get())) {
-      LOG(INFO) << "receive data";
-      if (!is_start_) {
-        OnSpeechStart();
+void GrpcEngine::Proceed(int op, bool ok) {
+  switch (op) {
+    case CONNECT:
+      if (!ok) {
+        // the server is shutting down
+        delete this;
+        return;
+      }
+      // wait for the next stream while this one is served
+      new GrpcEngine(service_, cq_, asr_handler_, decode_pool_, admission_);
+      LOG(INFO) << "Get Recognize request";
+      stream_.Read(request_.get(), &read_tag_);
+      break;
+    case READ:
+      if (ok) {
+        if (!is_start_) {
+          OnSpeechStart();
+        }
+        // a rejected stream is finished at once instead of read to its end
+        if (OnSpeechData() && !request_->is_final()) {
+          stream_.Read(request_.get(), &read_tag_);
+          break;
+        }
+      }
+      OnSpeechEnd();
+      break;
+    case WRITE: {
+      bool finish = false;
+      {
+        std::lock_guard<std::mutex> lock(*p_mutex_);
+        if (ok) {
+          write_queue_.pop_front();
+        } else {
+          // the client is gone, drop the results and stop decoding
+          is_cancelled_ = true;
+          write_queue_.clear();
+        }
+        if (!write_queue_.empty()) {
+          stream_.Write(write_queue_.front(), &write_tag_);
+        }
+        finish = ReadyToFinishLocked();
       }
-      OnSpeechData();
-      if (request_->is_final()) {
-        break;
+      if (finish) {
+        stream_.Finish(finish_status_, &finish_tag_);
       }
+      break;
     }
-    OnSpeechEnd();
-    LOG(INFO) << "Connect finish";
-  } catch (std::exception const& e) {
-    LOG(ERROR) << e.what();
+    case FINISH:
+      LOG(INFO) << "Connect finish";
+      delete this;
+      break;
   }
 }
 
-GrpcService::GrpcService(std::map<std::string, std::string>& config, int onnx_thread)
-  : config_(config) {
+GrpcService::GrpcService(std::map<std::string, std::string>& config, int onnx_thread, int decoder_thread_num,
+                         const funasr::AdmissionLimits& admission_limits)
+  : config_(config),
+    admission_(admission_limits) {
 
   asr_handler_ = std::make_shared<FUNASR_HANDLE>(std::move(FunTpassInit(config_, onnx_thread)));
   LOG(INFO) << "GrpcService model loaded";
@@ -184,20 +381,65 @@ GrpcService::GrpcService(std::map<std::string, std::string>& config, int onnx_th
   }
   FunTpassOnlineUninit(tmp_online_handler);
   LOG(INFO) << "GrpcService model warmup";
+
+  decode_pool_ = std::make_unique<DecodePool>(decoder_thread_num);
+  LOG(INFO) << "GrpcService decoder threads: " << decoder_thread_num;
 }
 
-grpc::Status GrpcService::Recognize(
-  grpc::ServerContext* context,
-  grpc::ServerReaderWriter<Response, Request>* stream) {
-  LOG(INFO) << "Get Recognize request";
-  GrpcEngine engine(
-    stream,
-    asr_handler_
-  );
-
-  std::thread t(std::move(engine));
-  t.join();
-  return grpc::Status::OK;
+void GrpcService::HandleRpcs(grpc::ServerCompletionQueue* cq) {
+  new GrpcEngine(&service_, cq, asr_handler_, decode_pool_.get(), &admission_);
+  void* tag = nullptr;
+  bool ok = false;
+  // blocks while no stream has anything to do
+  while (cq->Next(&tag, &ok)) {
+    GrpcTag* grpc_tag = static_cast<GrpcTag*>(tag);
+    grpc_tag->engine->Proceed(grpc_tag->op, ok);
+  }
+}
+
+void GrpcService::ReportHealth(grpc::HealthCheckServiceInterface* health) {
+  bool serving = true;
+  long long last_rejected = 0;
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    funasr::AdmissionStats stats = admission_.GetStats();
+    if (stats.saturated == serving || stats.rejected != last_rejected) {
+      LOG(INFO) << "admission: tasks=" << stats.tasks
+                << ", queued_seconds=" << stats.queued_seconds
+                << ", admitted=" << stats.admitted
+                << ", rejected=" << stats.rejected;
+    }
+    last_rejected = stats.rejected;
+    if (stats.saturated == serving) {
+      serving = !stats.saturated;
+      health->SetServingStatus(serving);
+    }
+  }
+}
+
+void GrpcService::Run(std::string& server_address, int io_thread_num) {
+  // grpc.health.v1 for the load balancer, see ReportHealth
+  grpc::EnableDefaultHealthCheckService(true);
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+  builder.RegisterService(&service_);
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs;
+  for (int i = 0; i < io_thread_num; i++) {
+    cqs.emplace_back(builder.AddCompletionQueue());
+  }
+  std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
+  LOG(INFO) << "Server listening on " << server_address;
+  if (server->GetHealthCheckService() != nullptr) {
+    std::thread(&GrpcService::ReportHealth, this, server->GetHealthCheckService()).detach();
+  }
+
+  std::vector<std::thread> io_threads;
+  for (auto& cq : cqs) {
+    io_threads.emplace_back(&GrpcService::HandleRpcs, this, cq.get());
+  }
+  for (auto& io_thread : io_threads) {
+    io_thread.join();
+  }
 }
 
 void GetValue(TCLAP::ValueArg<std::string>& value_arg, std::string key, std::map<std::string, std::string>& config) {
@@ -220,6 +462,12 @@ int main(int argc, char* argv[]) {
   TCLAP::ValueArg<std::string>  punc_dir("", PUNC_DIR, "the punc online model path, which contains model.onnx, punc.yaml", false, "", "string");
   TCLAP::ValueArg<std::string>  punc_quant("", PUNC_QUANT, "false (Default), load the model of model.onnx in punc_dir. If set true, load the model of model_quant.onnx in punc_dir", false, "true", "string");
   TCLAP::ValueArg<std::int32_t>  onnx_thread("", "onnx-inter-thread", "onnxruntime SetIntraOpNumThreads", false, 1, "int32_t");
+  TCLAP::ValueArg<std::int32_t>  io_thread_num("", "io-thread-num", "number of completion queue threads serving the streams", false, 2, "int32_t");
+  TCLAP::ValueArg<std::int32_t>  decoder_thread_num("", "decoder-thread-num", "number of threads decoding the streams", false, std::max(1u, std::thread::hardware_concurrency()), "int32_t");
+  TCLAP::ValueArg<std::int32_t>  compute_thread_num("", "compute-thread-num", "threads doing model compute, shared by all models: 0 gives each model session its own pool of onnx-inter-thread threads, -1 uses the number of cores", false, 0, "int32_t");
+  TCLAP::ValueArg<std::int32_t>  max_decode_tasks("", "max-decode-tasks", "max decode tasks queued or running, streams over it are finished with RESOURCE_EXHAUSTED, 0 is unbounded", false, 0, "int32_t");
+  TCLAP::ValueArg<std::int32_t>  max_connection_audio_mb("", "max-connection-audio-mb", "max MB of audio one stream may have waiting for the decoder, 0 is unbounded", false, 0, "int32_t");
+  TCLAP::ValueArg<float>  max_queued_audio_seconds("", "max-queued-audio-seconds", "max seconds of audio queued for decoding over all streams, 0 is unbounded", false, 0, "float");
   TCLAP::ValueArg<std::string> port_id("", PORT_ID, "port id", true, "", "string");
 
   cmd.add(model_dir);
@@ -230,6 +478,12 @@ int main(int argc, char* argv[]) {
   cmd.add(punc_dir);
   cmd.add(punc_quant);
   cmd.add(onnx_thread);
+  cmd.add(io_thread_num);
+  cmd.add(decoder_thread_num);
+  cmd.add(compute_thread_num);
+  cmd.add(max_decode_tasks);
+  cmd.add(max_connection_audio_mb);
+  cmd.add(max_queued_audio_seconds);
   cmd.add(port_id);
   cmd.parse(argc, argv);
 
@@ -252,14 +506,13 @@ int main(int argc, char* argv[]) {
   }
   std::string server_address;
   server_address = "0.0.0.0:" + port;
-  GrpcService service(config, onnx_thread);
-
-  grpc::ServerBuilder builder;
-  builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-  builder.RegisterService(&service);
-  std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
-  LOG(INFO) << "Server listening on " << server_address;
-  server->Wait();
+  FunSetComputeThreads(compute_thread_num, onnx_thread);
+  funasr::AdmissionLimits admission_limits;
+  admission_limits.max_tasks = max_decode_tasks;
+  admission_limits.max_conn_bytes = (long long)max_connection_audio_mb.getValue() << 20;
+  admission_limits.max_queued_seconds = max_queued_audio_seconds;
+  GrpcService service(config, onnx_thread, decoder_thread_num, admission_limits);
+  service.Run(server_address, io_thread_num);
 
   return 0;
 }
@@ -4,13 +4,18 @@
  */
 /* 2023 by burkliu(刘柏基) liubaiji@xverse.cn */
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <string>
 #include <thread>
 #include <mutex>
 #include <unistd.h>
 
+#include "grpcpp/health_check_service_interface.h"
 #include "grpcpp/server_builder.h"
 #include "paraformer.grpc.pb.h"
+#include "admission-control.h"
 #include "funasrruntime.h"
 #include "tclap/CmdLine.h"
 #include "com-define.h"
@@ -28,41 +33,113 @@ typedef struct
   float  snippet_time;
 } FUNASR_RECOG_RESULT;
 
+// fixed set of decoder threads shared by all streams, idle threads wait on
+// the condition variable
+class DecodePool {
+ public:
+  explicit DecodePool(int num_threads);
+  ~DecodePool();
+  void Post(std::function<void()> task);
+
+ private:
+  void WorkerFunc();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool stop_ = false;
+};
+
+class GrpcEngine;
+
+// completion queue tag, names the stream and the operation that finished
+typedef struct
+{
+  GrpcEngine* engine;
+  int op;
+} GrpcTag;
+
+// one Recognize stream on the async api. The completion queue threads read
+// the audio and write the results, the decoding runs as tasks on the decode
+// pool, at most one task per stream at a time. A task needs an admission
+// ticket, a stream that gets none is finished with RESOURCE_EXHAUSTED. The
+// object deletes itself once Finish has completed.
 class GrpcEngine {
  public:
-  GrpcEngine(grpc::ServerReaderWriter<Response, Request>* stream, std::shared_ptr<FUNASR_HANDLE> asr_handler);
-  void operator()();
+  enum { CONNECT, READ, WRITE, FINISH };
+
+  GrpcEngine(ASR::AsyncService* service, grpc::ServerCompletionQueue* cq,
+             std::shared_ptr<FUNASR_HANDLE> asr_handler, DecodePool* decode_pool,
+             funasr::AdmissionControl* admission);
+  void Proceed(int op, bool ok);
 
  private:
   void DecodeThreadFunc();
+  void DecodeStep(const char* data, int len, bool is_final);
   void OnSpeechStart();
-  void OnSpeechData();
+  // false once the stream is cancelled or rejected, no more is read then
+  bool OnSpeechData();
   void OnSpeechEnd();
+  void Send(Response& response);
+  // the caller holds p_mutex_
+  void ScheduleDecodeLocked();
+  // the caller holds p_mutex_, true once when Finish is due
+  bool ReadyToFinishLocked();
+  // the caller holds p_mutex_, drops the audio and fails the stream busy
+  void RejectLocked(const std::string& reason);
 
-  grpc::ServerReaderWriter<Response, Request>* stream_;
+  ASR::AsyncService* service_;
+  grpc::ServerCompletionQueue* cq_;
+  grpc::ServerContext context_;
+  grpc::ServerAsyncReaderWriter<Response, Request> stream_;
+  GrpcTag connect_tag_, read_tag_, write_tag_, finish_tag_;
   std::shared_ptr<Request> request_;
-  std::shared_ptr<Response> response_;
   std::shared_ptr<FUNASR_HANDLE> asr_handler_;
-  std::string audio_buffer_;
-  std::shared_ptr<std::thread> decode_thread_ = nullptr;
+  DecodePool* decode_pool_;
+  funasr::AdmissionControl* admission_;
   bool is_start_ = false;
+
+  // guarded by p_mutex_
+  std::string audio_buffer_;  // received and not yet handed to the decoder
   bool is_end_ = false;
+  bool is_decoding_ = false;
+  bool is_decoded_ = false;
+  bool is_cancelled_ = false;
+  std::deque<Response> write_queue_;  // front is being written
+  bool is_finishing_ = false;
+  grpc::Status finish_status_ = grpc::Status::OK;
+
+  // only touched by the decode task of this stream
+  std::string decode_buffer_;
+  FUNASR_HANDLE tpass_online_handler_ = nullptr;
+  std::vector<std::vector<std::string>> punc_cache_;
 
   std::vector<int> chunk_size_ = {5, 10, 5};
   int sampling_rate_ = 16000;
   std::string encoding_;
   ASR_TYPE mode_ = ASR_TWO_PASS;
   int step_duration_ms_ = 100;
+  size_t step_ = 0;
 
   std::unique_ptr<std::mutex> p_mutex_= std::make_unique<std::mutex>(); // mutex is not moveable
 };
 
-class GrpcService final : public ASR::Service {
+class GrpcService {
   public:
-    GrpcService(std::map<std::string, std::string>& config, int num_thread);
-    grpc::Status Recognize(grpc::ServerContext* context, grpc::ServerReaderWriter<Response, Request>* stream);
+    GrpcService(std::map<std::string, std::string>& config, int num_thread, int decoder_thread_num,
+                const funasr::AdmissionLimits& admission_limits);
+    // serves on the completion queue threads, does not return
+    void Run(std::string& server_address, int io_thread_num);
 
   private:
+    void HandleRpcs(grpc::ServerCompletionQueue* cq);
+    // NOT_SERVING in the health service while new work is turned away
+    void ReportHealth(grpc::HealthCheckServiceInterface* health);
+
     std::map<std::string, std::string> config_;
     std::shared_ptr<FUNASR_HANDLE> asr_handler_;
+    ASR::AsyncService service_;
+    std::unique_ptr<DecodePool> decode_pool_;
+    funasr::AdmissionControl admission_;
 };
@@ -36,17 +36,19 @@ namespace http
       if (data_msg->status == 1)
         return;
 
+      auto self(shared_from_this());
       s_timer->expires_after(std::chrono::seconds(10));
-      s_timer->async_wait([=](const asio::error_code &ec)
+      s_timer->async_wait([this, self](const asio::error_code &ec)
                           {
     if (!ec) {
       std::cout << "time is out!" << std::endl;
       if (data_msg->status == 1) return;
       data_msg->status = 1;
       s_timer->cancel();
-      auto wf = std::bind(&connection::write_back, std::ref(*this), "");
-      // close the connection
+      auto wf = std::bind(&connection::write_back, self, "");
+      // close the connection, the pending feed tasks see the status and release the handles
       strand_->post(wf);
+      strand_->post(std::bind(&ModelDecoder::release_session, model_decoder, data_msg));
     } });
     }
 
@@ -60,14 +62,6 @@ namespace http
                                                        // new connection
         data_msg->samples = std::make_shared<std::vector<char>>();
         // data_msg->samples->reserve(16000*20);
-        data_msg->msg = nlohmann::json::parse("{}");
-        data_msg->msg["wav_format"] = "pcm";
-        data_msg->msg["wav_name"] = "wav-default-id";
-        data_msg->msg["itn"] = true;
-        data_msg->msg["audio_fs"] = 16000; // default is 16k
-        data_msg->msg["access_num"] = 0;   // the number of access for this object,
-                                           // when it is 0, we can free it saftly
-        data_msg->msg["is_eof"] = false;
         data_msg->status = 0;
 
         strand_ = std::make_shared<asio::io_context::strand>(io_decoder);
@@ -130,11 +124,8 @@ namespace http
                                    merged_hws_map);
 
           // nn
-          std::vector<std::vector<float>> new_hotwords_embedding =
-              CompileHotwordEmbedding(model_decoder->get_asr_handle(), nn_hotwords);
           data_msg->hotwords_embedding =
-              std::make_shared<std::vector<std::vector<float>>>(
-                  new_hotwords_embedding);
+              CompileSharedHotwordEmbedding(model_decoder->get_asr_handle(), nn_hotwords);
         }
 
         
@@ -151,7 +142,7 @@ namespace http
       s_timer->cancel();
 
       reply_ = reply::stock_reply(
-          data_msg->msg["asr_result"].dump()); // reply::stock_reply();
+          data_msg->asr_result.dump()); // reply::stock_reply();
       do_write();
     }
     void connection::do_read()
@@ -230,29 +221,121 @@ namespace http
 
     void connection::handle_body()
     {
-       
-
       process_multipart_data();
-      if (in_file_part_ == false)
+      if (data_msg->status == 1)
+        return; // rejected or timed out, already answered
+      if (multipart_finished_)
       {
         std::cout << "文件获取结束" << std::endl;
-        std::cout << "开始解码，数据大小= " << data_msg->samples->size() << std::endl;
-
-        auto close_thread = std::bind(&connection::write_back, std::ref(*this), "close");
-        auto decoder_thread = std::bind(&ModelDecoder::do_decoder,
-                           std::ref(*model_decoder), std::ref(data_msg));
-
         // for decode task
-        strand_->post(decoder_thread);
-        // for close task
-        strand_->post(close_thread);
-        data_msg->sem_resultok.acquire();
-        std::cout << "解码线程提交结束！！！！ " << std::endl;
+        funasr::AdmissionTicket ticket;
+        if (is_incremental() && body_bytes_ > 0)
+        {
+          // the upload was admitted with its first part
+          ticket = upload_ticket_.lock();
+          if (!ticket)
+            return; // the session is already released
+        }
+        else
+        {
+          size_t task_bytes = is_incremental() ? 0 : data_msg->samples->size();
+          ticket = model_decoder->get_admission().Admit(task_bytes, data_msg->audio_fs);
+          if (!ticket)
+          {
+            reject(reply::service_unavailable, "server busy");
+            return;
+          }
+        }
+        if (is_incremental())
+        {
+          strand_->post(std::bind(&ModelDecoder::do_feed, model_decoder, data_msg,
+                                  std::make_shared<std::string>(), true, ticket));
+        }
+        else
+        {
+          std::cout << "开始解码，数据大小= " << data_msg->samples->size() << std::endl;
+          strand_->post(std::bind(&ModelDecoder::do_decoder, model_decoder, data_msg, ticket));
+        }
+        // for close task, runs after the result is set
+        strand_->post(std::bind(&connection::write_back, shared_from_this(), "close"));
       }
       else
         do_read();
       return;
-       
+    }
+
+    void connection::emit_part_data(const char *data, size_t len)
+    {
+      if (len == 0 || data_msg->status == 1)
+        return;
+      body_bytes_ += len;
+      if (model_decoder->get_admission().ConnectionOverLimit(body_bytes_))
+      {
+        reject(reply::payload_too_large, "upload over limit");
+        return;
+      }
+      if (is_incremental())
+      {
+        // one decode task per upload: admitted with the first part, the
+        // later parts add their audio to its queued seconds
+        funasr::AdmissionTicket ticket;
+        if (body_bytes_ == len)
+        {
+          ticket = model_decoder->get_admission().Admit(len, data_msg->audio_fs);
+          if (!ticket)
+          {
+            reject(reply::service_unavailable, "server busy");
+            return;
+          }
+          upload_ticket_ = ticket;
+        }
+        else
+        {
+          ticket = upload_ticket_.lock();
+          if (!ticket)
+            return; // the session is already released
+          model_decoder->get_admission().AddQueued(ticket, len, data_msg->audio_fs);
+        }
+        // decoded on the strand while the rest of the upload is read
+        strand_->post(std::bind(&ModelDecoder::do_feed, model_decoder, data_msg,
+                                std::make_shared<std::string>(data, len), false, ticket));
+      }
+      else
+      {
+        data_msg->samples->insert(data_msg->samples->end(), data, data + len);
+      }
+    }
+
+    void connection::reply_now(const reply &rep)
+    {
+      if (data_msg->status.exchange(1) == 1)
+        return;
+      s_timer->cancel();
+      strand_->post(std::bind(&ModelDecoder::release_session, model_decoder, data_msg));
+      reply_ = rep;
+      do_write();
+    }
+
+    void connection::reject(reply::status_type status, const std::string &reason)
+    {
+      std::cout << "reject " << data_msg->wav_name << ": " << reason << std::endl;
+      nlohmann::json jsonresult;
+      jsonresult["text"] = "";
+      jsonresult["wav_name"] = data_msg->wav_name;
+      jsonresult["busy"] = true;
+      jsonresult["reason"] = reason;
+      reply rep = reply::stock_reply(status, jsonresult.dump());
+      if (status == reply::service_unavailable)
+        rep.headers.push_back({"Retry-After", "1"});
+      reply_now(rep);
+    }
+
+    void connection::handle_get(const std::string &headers)
+    {
+      if (headers.compare(0, 11, "GET /stats ") == 0)
+        reply_now(reply::stock_reply(model_decoder->get_admission().StatsJson()));
+      else
+        reply_now(reply::stock_reply(reply::not_found));
     }
 
     // 辅助函数：解析 Content-Length
@@ -279,6 +362,13 @@ namespace http
 
     void connection::handle_error(asio::error_code ec)
     {
+      if (data_msg->status != 1)
+      {
+        // the upload is cut off, no result will be sent
+        data_msg->status = 1;
+        s_timer->cancel();
+        strand_->post(std::bind(&ModelDecoder::release_session, model_decoder, data_msg));
+      }
       if (ec == asio::error::eof)
       {
         std::cout << "Connection closed gracefully\n";
@@ -301,7 +391,6 @@ namespace http
                             socket_.shutdown(asio::ip::tcp::socket::shutdown_both,
                                              ignored_ec);
                           }
-                          data_msg->sem_resultok.release();
                           // No new asynchronous operations are started. This means
                           // that all shared_ptr references to the connection object
                           // will disappear and the object will be destroyed
@@ -153,10 +153,10 @@ namespace http
             bool try_parse_headers()
             {
 
-                size_t header_end = received_data_.find("\r\n\r\n");
+                size_t header_end = received_data_.find("\r\n\r\n", header_scan_pos_);
                 if (header_end == std::string::npos)
                 {
-
+                    header_scan_pos_ = keep_tail(received_data_.size(), 4);
                     return false;
                 }
 
@@ -171,6 +171,18 @@ namespace http
                     return false;
                 }
 
+                // GET 只用来查询准入状态, 不解码
+                if (headers.compare(0, 4, "GET ") == 0)
+                {
+                    handle_get(headers);
+                    return false;
+                }
+                if (model_decoder->get_admission().ConnectionOverLimit(content_length_))
+                {
+                    reject(reply::payload_too_large, "upload over limit");
+                    return false;
+                }
+
                 // 检查Expect头
                 std::string continue100 = "Expect: 100-continue";
                 size_t pos = headers.find(continue100);
@@ -183,6 +195,7 @@ namespace http
                     headers.erase(pos, continue100.length());
 
                     received_data_ = headers;
+                    header_scan_pos_ = 0;
                     state_ = State::SendingContinue;
                     if (http_version_minor_ < 1)
                         send_417_expectation_failed();
@@ -198,15 +211,15 @@ namespace http
                 {
                     std::cout << "set wav_format=pcm, file_name=" << filename_
                               << std::endl;
-                    data_msg->msg["wav_format"] = "pcm";
+                    data_msg->wav_format = "pcm";
                 }
                 else
                 {
                     std::cout << "set wav_format=" << ext << ", file_name=" << filename_
                               << std::endl;
-                    data_msg->msg["wav_format"] = ext;
+                    data_msg->wav_format = ext;
                 }
-                data_msg->msg["wav_name"] = filename_;
+                data_msg->wav_name = filename_;
  
                 state_ = State::ReadingBody;
                 return true;
@@ -233,6 +246,8 @@ namespace http
                 }
             }
             // multipart 数据处理核心
+            // 流式解析: 已扫描过的字节不再重复查找, 文件内容一到就交给 emit_part_data,
+            // 只保留可能是分隔符开头的最后 delimiter_.size()-1 个字节
             void process_multipart_data()
             {
                 if (boundary_.empty())
@@ -243,51 +258,86 @@ namespace http
                         std::cerr << "Invalid multipart format\n";
                         return;
                     }
+                    delimiter_ = "\r\n--" + boundary_;
                 }
 
-                while (true)
+                while (!multipart_finished_)
                 {
                     if (!in_file_part_)
                     {
-
                         // 查找boundary起始
-                        size_t boundary_pos = received_data_.find("--" + boundary_);
-                        if (boundary_pos == std::string::npos)
+                        std::string dash_boundary = "--" + boundary_;
+                        if (boundary_pos_ == std::string::npos)
+                        {
+                            boundary_pos_ = received_data_.find(dash_boundary, scan_pos_);
+                            if (boundary_pos_ == std::string::npos)
+                            {
+                                scan_pos_ = keep_tail(received_data_.size(), dash_boundary.size());
+                                break;
+                            }
+                            scan_pos_ = boundary_pos_ + dash_boundary.size();
+                        }
+
+                        // 结束boundary: --boundary--
+                        size_t after_boundary = boundary_pos_ + dash_boundary.size();
+                        if (received_data_.size() < after_boundary + 2)
+                            break;
+                        if (received_data_.compare(after_boundary, 2, "--") == 0)
+                        {
+                            received_data_.clear();
+                            multipart_finished_ = true;
                             break;
+                        }
 
                         // 移动到part头部
-                        size_t part_start = received_data_.find("\r\n\r\n", boundary_pos);
+                        size_t part_start = received_data_.find("\r\n\r\n", scan_pos_);
                         if (part_start == std::string::npos)
+                        {
+                            scan_pos_ = std::max(scan_pos_, keep_tail(received_data_.size(), 4));
                             break;
+                        }
 
                         part_start += 4; // 跳过空行
-                        parse_part_headers(received_data_.substr(boundary_pos, part_start - boundary_pos));
+                        parse_part_headers(received_data_.substr(boundary_pos_, part_start - boundary_pos_));
 
                         received_data_.erase(0, part_start);
+                        boundary_pos_ = std::string::npos;
+                        scan_pos_ = 0;
 
                         in_file_part_ = true;
                     }
                     else
                     {
                         // 查找boundary结束
-
-                        size_t boundary_end = received_data_.find("\r\n--" + boundary_);
+                        size_t boundary_end = received_data_.find(delimiter_);
 
                         if (boundary_end == std::string::npos)
-
+                        {
+                            // 写入内容, 末尾可能是半个分隔符, 留到下次
+                            size_t emit_len = keep_tail(received_data_.size(), delimiter_.size());
+                            if (emit_len > 0)
+                            {
+                                emit_part_data(received_data_.data(), emit_len);
+                                received_data_.erase(0, emit_len);
+                            }
                             break;
+                        }
 
-                        // 写入内容
+                        emit_part_data(received_data_.data(), boundary_end);
 
-                        std::string tmpstr = received_data_.substr(0, boundary_end);
-                        data_msg->samples->insert(data_msg->samples->end(), tmpstr.begin(), tmpstr.end());
-
-                        received_data_.erase(0, boundary_end + 2); // 保留\r\n供下次解析
+                        received_data_.erase(0, boundary_end + 2); // 保留--boundary供下次解析
+                        boundary_pos_ = 0;
+                        scan_pos_ = delimiter_.size() - 2;
 
                         in_file_part_ = false;
                     }
                 }
             }
+            // 可以跳过的字节数, 末尾 pattern_len-1 个字节可能是 pattern 的开头
+            static size_t keep_tail(size_t size, size_t pattern_len)
+            {
+                return size >= pattern_len ? size - pattern_len + 1 : 0;
+            }
             std::string parese_file_ext(std::string file_name)
             {
                 int pos = file_name.rfind('.');
@@ -335,9 +385,19 @@ namespace http
             void do_write();
 
             void do_decoder();
+            // 文件内容: pcm 直接送去边收边解码, 其它格式先攒起来
+            void emit_part_data(const char *data, size_t len);
+            bool is_incremental() const { return data_msg->wav_format == "pcm"; }
 
             void setup_timer();
 
+            // 不经解码直接应答: 释放会话, strand 上排队的任务看到 status 后返回
+            void reply_now(const reply &rep);
+            // 超过准入限制, 回复 busy json, 503 时带 Retry-After
+            void reject(reply::status_type status, const std::string &reason);
+            // GET /stats 返回准入队列的状态
+            void handle_get(const std::string &headers);
+
             /// Socket for the connection.
             asio::ip::tcp::socket socket_;
 
@@ -367,7 +427,10 @@ namespace http
 
             std::string received_data_;  // 累积接收的数据
             bool header_parsed_ = false; // 头部解析状态标记
+            size_t header_scan_pos_ = 0; // 头部已查找过的位置
             size_t content_length_ = 0;  // Content-Length 值
+            size_t body_bytes_ = 0;      // 已收到的文件内容字节数
+            std::weak_ptr<void> upload_ticket_; // pcm 上传的准入票, 收到第一段时取得, 由会话持有
             enum class State
             {
                 ReadingHeaders,
@@ -381,6 +444,10 @@ namespace http
             int http_version_major_ = 1;
             int http_version_minor_ = 1;
             std::string boundary_ = "";
+            std::string delimiter_ = "";                 // \r\n--boundary
+            size_t scan_pos_ = 0;                        // received_data_ 中已查找过的位置
+            size_t boundary_pos_ = std::string::npos;    // 当前part的--boundary
+            bool multipart_finished_ = false;
             bool in_file_part_ = false;
             std::string current_part_filename_;
             size_t expected_part_size_ = 0;
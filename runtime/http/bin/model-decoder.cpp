@@ -14,74 +14,35 @@
 
 extern std::unordered_map<std::string, int> hws_map_;
 extern int fst_inc_wts_;
+extern int hotword_cache_mb_, hotword_fst_cache_mb_;
 extern float global_beam_, lattice_beam_, am_scale_;
+extern funasr::AdmissionLimits admission_limits_;
+extern int vad_thread_num_, vad_window_seconds_;
 
 // feed msg to asr engine for decoder
-void ModelDecoder::do_decoder(std::shared_ptr<FUNASR_MESSAGE> session_msg) {
+void ModelDecoder::do_decoder(std::shared_ptr<FUNASR_MESSAGE> session_msg,
+                              funasr::AdmissionTicket ticket) {
   try {
     //   std::this_thread::sleep_for(std::chrono::milliseconds(1000*10));
     if (session_msg->status == 1) return;
     //std::cout << "in do_decoder" << std::endl;
     std::shared_ptr<std::vector<char>> buffer = session_msg->samples;
     int num_samples = buffer->size();  // the size of the buf
-    std::string wav_name =session_msg->msg["wav_name"];
-    bool itn = session_msg->msg["itn"];
-    int audio_fs = session_msg->msg["audio_fs"];;
-    std::string wav_format = session_msg->msg["wav_format"];
-
-    if (num_samples > 0 && session_msg->hotwords_embedding->size() > 0) {
-      std::string asr_result = "";
-      std::string stamp_res = "";
-      std::string stamp_sents = "";
+    bool itn = session_msg->itn;
+    int audio_fs = session_msg->audio_fs;
+    std::string wav_format = session_msg->wav_format;
 
+    if (num_samples > 0 && !session_msg->hotwords_embedding->Empty()) {
+      FUNASR_RESULT Result = nullptr;
       try {
-        std::vector<std::vector<float>> hotwords_embedding_(
-            *(session_msg->hotwords_embedding));
-   
-
-        FUNASR_RESULT Result = FunOfflineInferBuffer(
+        Result = FunOfflineInferBuffer(
             asr_handle, buffer->data(), buffer->size(), RASR_NONE, nullptr,
-            std::move(hotwords_embedding_), audio_fs, wav_format, itn,
+            session_msg->hotwords_embedding, audio_fs, wav_format, itn,
             session_msg->decoder_handle);
-
-        if (Result != nullptr) {
-          asr_result = FunASRGetResult(Result, 0);  // get decode result
-          stamp_res = FunASRGetStamp(Result);
-          stamp_sents = FunASRGetStampSents(Result);
-          FunASRFreeResult(Result);
-
-        } else {
-          std::this_thread::sleep_for(std::chrono::milliseconds(20));
-        }
       } catch (std::exception const &e) {
         std::cout << "error in decoder!!! "<<e.what()  <<std::endl;
       }
-
-      nlohmann::json jsonresult;        // result json
-      jsonresult["text"] = asr_result;  // put result in 'text'
-      jsonresult["mode"] = "offline";
-      jsonresult["is_final"] = false;
-      if (stamp_res != "") {
-        jsonresult["timestamp"] = stamp_res;
-      }
-      if (stamp_sents != "") {
-        try {
-          nlohmann::json json_stamp = nlohmann::json::parse(stamp_sents);
-          jsonresult["stamp_sents"] = json_stamp;
-        } catch (std::exception const &e) {
-          std::cout << "error:" << e.what();
-          jsonresult["stamp_sents"] = "";
-        }
-      }
-      jsonresult["wav_name"] = wav_name;
-
-      std::cout << "buffer.size=" << buffer->size()
-                << ",result json=" << jsonresult.dump() << std::endl;
-
-      FunWfstDecoderUnloadHwsRes(session_msg->decoder_handle);
-      FunASRWfstDecoderUninit(session_msg->decoder_handle);
-      session_msg->status = 1;
-      session_msg->msg["asr_result"] = jsonresult;
+      set_result(session_msg, Result, buffer->size());
       return;
     } else {
       std::cout << "Sent empty msg";
@@ -90,7 +51,7 @@ void ModelDecoder::do_decoder(std::shared_ptr<FUNASR_MESSAGE> session_msg) {
       jsonresult["text"] = "";    // put result in 'text'
       jsonresult["mode"] = "offline";
       jsonresult["is_final"] = false;
-      jsonresult["wav_name"] = wav_name;
+      jsonresult["wav_name"] = session_msg->wav_name;
     }
 
   } catch (std::exception const &e) {
@@ -98,12 +59,104 @@ void ModelDecoder::do_decoder(std::shared_ptr<FUNASR_MESSAGE> session_msg) {
   }
 }
 
+void ModelDecoder::do_feed(std::shared_ptr<FUNASR_MESSAGE> session_msg,
+                           std::shared_ptr<std::string> chunk,
+                           bool input_finished,
+                           funasr::AdmissionTicket ticket) {
+  try {
+    if (session_msg->status == 1) {
+      // timed out or closed before the upload ended
+      release_session(session_msg);
+      return;
+    }
+    if (session_msg->upload_ticket == nullptr) {
+      session_msg->upload_ticket = ticket;
+    }
+    if (session_msg->incremental_handle == nullptr) {
+      session_msg->incremental_handle = FunOfflineIncrementalInit(asr_handle);
+    }
+    session_msg->num_bytes += chunk->size();
+
+    FUNASR_RESULT Result = nullptr;
+    try {
+      Result = FunOfflineIncrementalInferBuffer(
+          asr_handle, session_msg->incremental_handle, chunk->data(),
+          chunk->size(), input_finished, session_msg->audio_fs,
+          session_msg->hotwords_embedding, session_msg->itn,
+          session_msg->decoder_handle);
+    } catch (std::exception const &e) {
+      std::cout << "error in decoder!!! " << e.what() << std::endl;
+    }
+    admission_.AddQueued(ticket, -(long long)chunk->size(), session_msg->audio_fs);
+    if (input_finished) {
+      set_result(session_msg, Result, session_msg->num_bytes);
+    }
+  } catch (std::exception const &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+  }
+}
+
+void ModelDecoder::set_result(std::shared_ptr<FUNASR_MESSAGE> &session_msg,
+                              FUNASR_RESULT result, size_t num_bytes) {
+  std::string asr_result = "";
+  std::string stamp_res = "";
+  std::string stamp_sents = "";
+  if (result != nullptr) {
+    asr_result = FunASRGetResult(result, 0);  // get decode result
+    stamp_res = FunASRGetStamp(result);
+    stamp_sents = FunASRGetStampSents(result);
+    FunASRFreeResult(result);
+  }
+
+  nlohmann::json jsonresult;        // result json
+  jsonresult["text"] = asr_result;  // put result in 'text'
+  jsonresult["mode"] = "offline";
+  jsonresult["is_final"] = false;
+  if (stamp_res != "") {
+    jsonresult["timestamp"] = stamp_res;
+  }
+  if (stamp_sents != "") {
+    try {
+      nlohmann::json json_stamp = nlohmann::json::parse(stamp_sents);
+      jsonresult["stamp_sents"] = json_stamp;
+    } catch (std::exception const &e) {
+      std::cout << "error:" << e.what();
+      jsonresult["stamp_sents"] = "";
+    }
+  }
+  jsonresult["wav_name"] = session_msg->wav_name;
+
+  std::cout << "buffer.size=" << num_bytes
+            << ",result json=" << jsonresult.dump() << std::endl;
+
+  release_session(session_msg);
+  session_msg->status = 1;
+  session_msg->asr_result = jsonresult;
+}
+
+void ModelDecoder::release_session(std::shared_ptr<FUNASR_MESSAGE> session_msg) {
+  session_msg->upload_ticket = nullptr;
+  if (session_msg->incremental_handle != nullptr) {
+    FunOfflineIncrementalUninit(session_msg->incremental_handle);
+    session_msg->incremental_handle = nullptr;
+  }
+  if (session_msg->decoder_handle != nullptr) {
+    FunWfstDecoderUnloadHwsRes(session_msg->decoder_handle);
+    FunASRWfstDecoderUninit(session_msg->decoder_handle);
+    session_msg->decoder_handle = nullptr;
+  }
+}
+
 // init asr model
 FUNASR_HANDLE ModelDecoder::initAsr(std::map<std::string, std::string> &model_path,
                            int thread_num) {
   try {
     // init model with api
     asr_handle = FunOfflineInit(model_path, thread_num);
+    FunSetHotwordCacheLimit(asr_handle, (long long)hotword_cache_mb_ << 20,
+                            (long long)hotword_fst_cache_mb_ << 20);
+    admission_.SetLimits(admission_limits_);
+    FunOfflineSetVadParallel(asr_handle, vad_thread_num_, vad_window_seconds_ * 1000);
     LOG(INFO) << "model successfully inited"; 
     return asr_handle;
 
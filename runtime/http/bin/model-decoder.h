@@ -23,6 +23,7 @@
 #include <functional>
  
 
+#include "admission-control.h"
 #include "asio.hpp"
 #include "asr_sessions.h"
 #include "com-define.h"
@@ -39,7 +40,20 @@ class ModelDecoder {
     asr_handle = initAsr(model_path, thread_num);
  
   }
-  void do_decoder(std::shared_ptr<FUNASR_MESSAGE> session_msg);
+  // the tasks hold their admission ticket until they return
+  void do_decoder(std::shared_ptr<FUNASR_MESSAGE> session_msg,
+                  funasr::AdmissionTicket ticket);
+  // pcm of an upload that is still arriving, the segments the vad closes are
+  // recognized right away and the result is set with input_finished. Runs on
+  // the connection's strand so the pieces are fed in order. All the pieces of
+  // an upload carry its one ticket, which the session keeps until the result
+  // is set; each piece takes its audio off the ticket once it is fed
+  void do_feed(std::shared_ptr<FUNASR_MESSAGE> session_msg,
+               std::shared_ptr<std::string> chunk, bool input_finished,
+               funasr::AdmissionTicket ticket);
+  // frees the engine handles and the upload ticket of a session, safe to
+  // call more than once
+  void release_session(std::shared_ptr<FUNASR_MESSAGE> session_msg);
 
   FUNASR_HANDLE initAsr(std::map<std::string, std::string> &model_path, int thread_num);
 
@@ -48,9 +62,18 @@ class ModelDecoder {
   {
     return asr_handle;
   }
+  // bounds the decode tasks queued by all connections
+  funasr::AdmissionControl &get_admission()
+  {
+    return admission_;
+  }
  private:
- 
+  // builds the reply of a finished session from the engine result
+  void set_result(std::shared_ptr<FUNASR_MESSAGE> &session_msg,
+                  FUNASR_RESULT result, size_t num_bytes);
+
   FUNASR_HANDLE asr_handle;  // asr engine handle
+  funasr::AdmissionControl admission_;
   bool isonline = false;  // online or offline engine, now only support offline
 };
 
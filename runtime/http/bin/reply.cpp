@@ -29,6 +29,7 @@ const std::string bad_request = "HTTP/1.0 400 Bad Request\r\n";
 const std::string unauthorized = "HTTP/1.0 401 Unauthorized\r\n";
 const std::string forbidden = "HTTP/1.0 403 Forbidden\r\n";
 const std::string not_found = "HTTP/1.0 404 Not Found\r\n";
+const std::string payload_too_large = "HTTP/1.0 413 Payload Too Large\r\n";
 const std::string internal_server_error =
     "HTTP/1.0 500 Internal Server Error\r\n";
 const std::string not_implemented = "HTTP/1.0 501 Not Implemented\r\n";
@@ -61,6 +62,8 @@ asio::const_buffer to_buffer(reply::status_type status) {
       return asio::buffer(forbidden);
     case reply::not_found:
       return asio::buffer(not_found);
+    case reply::payload_too_large:
+      return asio::buffer(payload_too_large);
     case reply::internal_server_error:
       return asio::buffer(internal_server_error);
     case reply::not_implemented:
@@ -157,6 +160,11 @@ const char not_found[] =
     "<head><title>Not Found</title></head>"
     "<body><h1>404 Not Found</h1></body>"
     "</html>";
+const char payload_too_large[] =
+    "<html>"
+    "<head><title>Payload Too Large</title></head>"
+    "<body><h1>413 Payload Too Large</h1></body>"
+    "</html>";
 const char internal_server_error[] =
     "<html>"
     "<head><title>Internal Server Error</title></head>"
@@ -204,6 +212,8 @@ std::string to_string(reply::status_type status) {
       return forbidden;
     case reply::not_found:
       return not_found;
+    case reply::payload_too_large:
+      return payload_too_large;
     case reply::internal_server_error:
       return internal_server_error;
     case reply::not_implemented:
@@ -219,8 +229,11 @@ std::string to_string(reply::status_type status) {
 
 }  // namespace stock_replies
 reply reply::stock_reply(std::string jsonresult) {
+  return stock_reply(reply::ok, jsonresult);
+}
+reply reply::stock_reply(reply::status_type status, std::string jsonresult) {
   reply rep;
-  rep.status = reply::ok;
+  rep.status = status;
   rep.content = jsonresult+"\n";
   rep.headers.resize(2);
   rep.headers[0].name = "Content-Length";
@@ -36,6 +36,7 @@ struct reply {
     unauthorized = 401,
     forbidden = 403,
     not_found = 404,
+    payload_too_large = 413,
     internal_server_error = 500,
     not_implemented = 501,
     bad_gateway = 502,
@@ -56,6 +57,7 @@ struct reply {
   /// Get a stock reply.
   static reply stock_reply(status_type status);
   static reply stock_reply(std::string jsonresult);
+  static reply stock_reply(status_type status, std::string jsonresult);
 };
 
 }  // namespace server2
@@ -56,7 +56,7 @@ void runReg(FUNASR_HANDLE tpass_handle, std::vector<int> chunk_size, vector<stri
     // load hotwords list and build graph
     FunWfstDecoderLoadHwsRes(decoder_handle, inc_bias, hws_map);
        
-    std::vector<std::vector<float>> hotwords_embedding = CompileHotwordEmbedding(tpass_handle, nn_hotwords_, ASR_TWO_PASS);
+    funasr::HotwordEmbeddingPtr hotwords_embedding = CompileSharedHotwordEmbedding(tpass_handle, nn_hotwords_, ASR_TWO_PASS);
     
     // init online features
     FUNASR_HANDLE tpass_online_handle=FunTpassOnlineInit(tpass_handle, chunk_size);
@@ -171,7 +171,7 @@ int main(int argc, char** argv)
     // load hotwords list and build graph
     FunWfstDecoderLoadHwsRes(decoder_handle, fst_inc_wts.getValue(), hws_map);
 
-    std::vector<std::vector<float>> hotwords_embedding = CompileHotwordEmbedding(tpass_handle, nn_hotwords_, ASR_TWO_PASS);
+    funasr::HotwordEmbeddingPtr hotwords_embedding = CompileSharedHotwordEmbedding(tpass_handle, nn_hotwords_, ASR_TWO_PASS);
     // init online features
     std::vector<int> chunk_size = {5,10,5};
     FUNASR_HANDLE tpass_online_handle=FunTpassOnlineInit(tpass_handle, chunk_size);
@@ -0,0 +1,91 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+// Micro-benchmark of the lfr/cmvn frontend: the reference loops against
+// ApplyLfrCmvn with each kernel this cpu runs, for the vad (lfr 5x1) and
+// asr (lfr 7x6) configurations, on a segment of fbank frames.
+
+#ifndef _WIN32
+#include <sys/time.h>
+#else
+#include <win_func.h>
+#endif
+
+#include <glog/logging.h>
+#include "tclap/CmdLine.h"
+
+#include <vector>
+#include "feat-matrix.h"
+#include "lfr-reference.h"
+using namespace std;
+
+namespace {
+
+const int kInDim = 80;
+
+long ElapsedUs(const struct timeval &start, const struct timeval &end) {
+    return (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    TCLAP::CmdLine cmd("funasr-onnx-lfr-bench", ' ', "1.0");
+    TCLAP::ValueArg<float> seconds("", "seconds", "seconds of audio in the segment, 100 fbank frames each", false, 30, "float");
+    TCLAP::ValueArg<std::int32_t> rounds("", "rounds", "runs of each frontend, the mean is reported", false, 100, "int32_t");
+    cmd.add(seconds);
+    cmd.add(rounds);
+    cmd.parse(argc, argv);
+
+    int num_frames = std::max(1, (int)(seconds.getValue() * 100));
+    int num_rounds = std::max(1, rounds.getValue());
+    vector<vector<float>> feats = funasr::RandomFeats(num_frames, kInDim, 1);
+    funasr::FeatMatrix matrix(0, kInDim);
+    for (const auto &row : feats) {
+        matrix.AppendRow(row.data());
+    }
+
+    const int lfr_configs[2][2] = {{5, 1}, {7, 6}};
+    const funasr::CmvnKernel kernels[] = {funasr::CMVN_KERNEL_SCALAR, funasr::CMVN_KERNEL_AVX2,
+                                          funasr::CMVN_KERNEL_AVX512, funasr::CMVN_KERNEL_NEON};
+    struct timeval start, end;
+    for (const auto &lfr : lfr_configs) {
+        int lfr_m = lfr[0], lfr_n = lfr[1];
+        vector<vector<float>> cmvn = funasr::RandomFeats(2, lfr_m * kInDim, lfr_m);
+        const vector<float> &means = cmvn[0];
+        const vector<float> &vars = cmvn[1];
+
+        gettimeofday(&start, nullptr);
+        for (int r = 0; r < num_rounds; r++) {
+            vector<vector<float>> ref_feats = feats;
+            funasr::ReferenceLfrCmvn(ref_feats, lfr_m, lfr_n, means, vars);
+        }
+        gettimeofday(&end, nullptr);
+        float ref_us = (float)ElapsedUs(start, end) / num_rounds;
+        LOG(INFO) << "lfr " << lfr_m << "x" << lfr_n << ", " << num_frames << " frames, reference: "
+                  << ref_us / 1000 << " ms";
+
+        vector<float> out((size_t)funasr::LfrFrameNum(num_frames, lfr_n) * lfr_m * kInDim);
+        for (auto kernel : kernels) {
+            if (!funasr::CmvnKernelSupported(kernel)) {
+                continue;
+            }
+            gettimeofday(&start, nullptr);
+            for (int r = 0; r < num_rounds; r++) {
+                funasr::ApplyLfrCmvn(matrix, lfr_m, lfr_n, means, vars, out.data(), kernel);
+            }
+            gettimeofday(&end, nullptr);
+            float us = (float)ElapsedUs(start, end) / num_rounds;
+            LOG(INFO) << "lfr " << lfr_m << "x" << lfr_n << ", " << num_frames << " frames, "
+                      << funasr::CmvnKernelName(kernel) << ": " << us / 1000 << " ms, "
+                      << (us > 0 ? ref_us / us : 0) << "x the reference";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+// Checks that ApplyLfrCmvn and OnlineLfrCmvn give bit for bit the output of
+// the reference loops, with the scalar kernel and every simd kernel this cpu
+// runs, for the vad (lfr 5x1) and asr (lfr 7x6) frontends. Exits 1 on a
+// mismatch.
+
+#include <glog/logging.h>
+#include <string.h>
+#include <vector>
+#include "feat-matrix.h"
+#include "lfr-reference.h"
+using namespace std;
+
+namespace {
+
+const int kInDim = 80;
+const int kMaxFrames = 69;
+
+bool SameRows(const vector<vector<float>> &a, const vector<vector<float>> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].size() != b[i].size() ||
+            memcmp(a[i].data(), b[i].data(), sizeof(float) * a[i].size()) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SameData(const vector<vector<float>> &rows, const vector<float> &data) {
+    size_t offset = 0;
+    for (const auto &row : rows) {
+        if (offset + row.size() > data.size() ||
+            memcmp(row.data(), data.data() + offset, sizeof(float) * row.size()) != 0) {
+            return false;
+        }
+        offset += row.size();
+    }
+    return offset == data.size();
+}
+
+// ApplyLfrCmvn of T frames against ReferenceLfrCmvn
+bool CheckOffline(int lfr_m, int lfr_n, int T, funasr::CmvnKernel kernel,
+                  const vector<float> &means, const vector<float> &vars) {
+    vector<vector<float>> feats = funasr::RandomFeats(T, kInDim, T);
+    funasr::FeatMatrix matrix(0, kInDim);
+    for (const auto &row : feats) {
+        matrix.AppendRow(row.data());
+    }
+    funasr::ReferenceLfrCmvn(feats, lfr_m, lfr_n, means, vars);
+
+    vector<float> out((size_t)funasr::LfrFrameNum(T, lfr_n) * lfr_m * kInDim);
+    funasr::ApplyLfrCmvn(matrix, lfr_m, lfr_n, means, vars, out.data(), kernel);
+    return SameData(feats, out);
+}
+
+// OnlineLfrCmvn of T frames against ReferenceOnlineLfrCmvn, the output rows,
+// the returned frame index and the frames kept for the next chunk
+bool CheckOnline(int lfr_m, int lfr_n, int T, bool input_finished, funasr::CmvnKernel kernel,
+                 const vector<float> &means, const vector<float> &vars) {
+    vector<vector<float>> ref_feats = funasr::RandomFeats(T, kInDim, 1000 + T);
+    vector<vector<float>> feats = ref_feats;
+    vector<vector<float>> ref_cache, cache;
+    int ref_idx = funasr::ReferenceOnlineLfrCmvn(ref_feats, lfr_m, lfr_n, means, vars, input_finished, ref_cache);
+    int idx = funasr::OnlineLfrCmvn(feats, lfr_m, lfr_n, means, vars, input_finished, cache, kernel);
+    return idx == ref_idx && SameRows(feats, ref_feats) && SameRows(cache, ref_cache);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    const int lfr_configs[2][2] = {{5, 1}, {7, 6}};
+    const funasr::CmvnKernel kernels[] = {funasr::CMVN_KERNEL_SCALAR, funasr::CMVN_KERNEL_AVX2,
+                                          funasr::CMVN_KERNEL_AVX512, funasr::CMVN_KERNEL_NEON};
+    int checks = 0, failures = 0;
+    for (auto kernel : kernels) {
+        if (!funasr::CmvnKernelSupported(kernel)) {
+            LOG(INFO) << "kernel " << funasr::CmvnKernelName(kernel) << ": not supported, skipped";
+            continue;
+        }
+        for (const auto &lfr : lfr_configs) {
+            int lfr_m = lfr[0], lfr_n = lfr[1];
+            vector<vector<float>> cmvn = funasr::RandomFeats(2, lfr_m * kInDim, lfr_m);
+            const vector<float> &means = cmvn[0];
+            const vector<float> &vars = cmvn[1];
+            for (int T = 1; T <= kMaxFrames; T++) {
+                const char* failed = nullptr;
+                // a streaming chunk holds at least the left context of its first window
+                bool online = T > (lfr_m - 1) / 2;
+                if (!CheckOffline(lfr_m, lfr_n, T, kernel, means, vars)) {
+                    failed = "offline";
+                } else if (online && !CheckOnline(lfr_m, lfr_n, T, true, kernel, means, vars)) {
+                    failed = "online finished";
+                } else if (online && !CheckOnline(lfr_m, lfr_n, T, false, kernel, means, vars)) {
+                    failed = "online unfinished";
+                }
+                checks++;
+                if (failed) {
+                    failures++;
+                    LOG(ERROR) << "kernel " << funasr::CmvnKernelName(kernel) << ", lfr " << lfr_m << "x" << lfr_n
+                               << ", " << T << " frames: " << failed << " output differs from the reference";
+                }
+            }
+        }
+        LOG(INFO) << "kernel " << funasr::CmvnKernelName(kernel) << ": checked";
+    }
+    LOG(INFO) << checks << " checks, " << failures << " failures";
+    return failures == 0 ? 0 : 1;
+}
@@ -49,7 +49,7 @@ void runReg(FUNASR_HANDLE asr_handle, vector<string> wav_list, vector<string> wa
     // load hotwords list and build graph
     FunWfstDecoderLoadHwsRes(decoder_handle, fst_inc_wts, hws_map);
 
-    std::vector<std::vector<float>> hotwords_embedding = CompileHotwordEmbedding(asr_handle, nn_hotwords_);
+    funasr::HotwordEmbeddingPtr hotwords_embedding = CompileSharedHotwordEmbedding(asr_handle, nn_hotwords_);
     
     // warm up
     for (size_t i = 0; i < 1; i++)
@@ -144,7 +144,7 @@ int main(int argc, char *argv[])
     TCLAP::ValueArg<std::int32_t> thread_num("", THREAD_NUM, "multi-thread num for rtf", false, 1, "int32_t");
     TCLAP::ValueArg<std::string>    hotword("", HOTWORD, "the hotword file, one hotword perline, Format: Hotword Weight (could be: 阿里巴巴 20)", false, "", "string");
     TCLAP::SwitchArg use_gpu("", INFER_GPU, "Whether to use GPU for inference, default is false", false);
-    TCLAP::ValueArg<std::int32_t> batch_size("", BATCHSIZE, "batch_size for ASR model when using GPU", false, 4, "int32_t");
+    TCLAP::ValueArg<std::int32_t> batch_size("", BATCHSIZE, "batch_size for ASR model", false, 4, "int32_t");
 
     cmd.add(model_dir);
     cmd.add(quantize);
@@ -0,0 +1,121 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+// The lfr/cmvn loops the frontends used before ApplyLfrCmvn and
+// OnlineLfrCmvn, kept as the reference of funasr-onnx-lfr-check and
+// funasr-onnx-lfr-bench.
+
+#ifndef LFR_REFERENCE_H
+#define LFR_REFERENCE_H
+
+#include <math.h>
+#include <random>
+#include <vector>
+
+namespace funasr {
+
+inline void ReferenceLfrCmvn(std::vector<std::vector<float>> &feats, int lfr_m, int lfr_n,
+                             const std::vector<float> &means, const std::vector<float> &vars) {
+    std::vector<std::vector<float>> out_feats;
+    int T = feats.size();
+    int T_lrf = ceil(1.0 * T / lfr_n);
+
+    // Pad frames at start(copy first frame)
+    for (int i = 0; i < (lfr_m - 1) / 2; i++) {
+        feats.insert(feats.begin(), feats[0]);
+    }
+    // Merge lfr_m frames as one,lfr_n frames per window
+    T = T + (lfr_m - 1) / 2;
+    std::vector<float> p;
+    for (int i = 0; i < T_lrf; i++) {
+        if (lfr_m <= T - i * lfr_n) {
+            for (int j = 0; j < lfr_m; j++) {
+                p.insert(p.end(), feats[i * lfr_n + j].begin(), feats[i * lfr_n + j].end());
+            }
+            out_feats.emplace_back(p);
+            p.clear();
+        } else {
+            // Fill to lfr_m frames at last window if less than lfr_m frames  (copy last frame)
+            int num_padding = lfr_m - (T - i * lfr_n);
+            for (int j = 0; j < (int)(feats.size() - i * lfr_n); j++) {
+                p.insert(p.end(), feats[i * lfr_n + j].begin(), feats[i * lfr_n + j].end());
+            }
+            for (int j = 0; j < num_padding; j++) {
+                p.insert(p.end(), feats[feats.size() - 1].begin(), feats[feats.size() - 1].end());
+            }
+            out_feats.emplace_back(p);
+            p.clear();
+        }
+    }
+    // Apply cmvn
+    for (auto &out_feat: out_feats) {
+        for (int j = 0; j < (int)means.size(); j++) {
+            out_feat[j] = (out_feat[j] + means[j]) * vars[j];
+        }
+    }
+    feats = out_feats;
+}
+
+inline int ReferenceOnlineLfrCmvn(std::vector<std::vector<float>> &feats, int lfr_m, int lfr_n,
+                                  const std::vector<float> &means, const std::vector<float> &vars,
+                                  bool input_finished, std::vector<std::vector<float>> &splice_cache) {
+    std::vector<std::vector<float>> out_feats;
+    int T = feats.size();
+    int T_lrf = ceil((T - (lfr_m - 1) / 2) / (float)lfr_n);
+    int lfr_splice_frame_idxs = T_lrf;
+    std::vector<float> p;
+    for (int i = 0; i < T_lrf; i++) {
+        if (lfr_m <= T - i * lfr_n) {
+            for (int j = 0; j < lfr_m; j++) {
+                p.insert(p.end(), feats[i * lfr_n + j].begin(), feats[i * lfr_n + j].end());
+            }
+            out_feats.emplace_back(p);
+            p.clear();
+        } else {
+            if (input_finished) {
+                int num_padding = lfr_m - (T - i * lfr_n);
+                for (int j = 0; j < (int)(feats.size() - i * lfr_n); j++) {
+                    p.insert(p.end(), feats[i * lfr_n + j].begin(), feats[i * lfr_n + j].end());
+                }
+                for (int j = 0; j < num_padding; j++) {
+                    p.insert(p.end(), feats[feats.size() - 1].begin(), feats[feats.size() - 1].end());
+                }
+                out_feats.emplace_back(p);
+                p.clear();
+            } else {
+                lfr_splice_frame_idxs = i;
+                break;
+            }
+        }
+    }
+    lfr_splice_frame_idxs = std::min(T - 1, lfr_splice_frame_idxs * lfr_n);
+    splice_cache.clear();
+    splice_cache.insert(splice_cache.begin(), feats.begin() + lfr_splice_frame_idxs, feats.end());
+
+    // Apply cmvn
+    for (auto &out_feat: out_feats) {
+        for (int j = 0; j < (int)means.size(); j++) {
+            out_feat[j] = (out_feat[j] + means[j]) * vars[j];
+        }
+    }
+    feats = out_feats;
+    return lfr_splice_frame_idxs;
+}
+
+// num_frames fbank-like frames of dim floats, the same for the same seed
+inline std::vector<std::vector<float>> RandomFeats(int num_frames, int dim, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> dist(-8.0f, 4.0f);
+    std::vector<std::vector<float>> feats(num_frames, std::vector<float>(dim));
+    for (auto &row : feats) {
+        for (auto &v : row) {
+            v = dist(gen);
+        }
+    }
+    return feats;
+}
+
+} // namespace funasr
+#endif
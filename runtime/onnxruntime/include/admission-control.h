@@ -0,0 +1,147 @@
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace funasr {
+// limits of the work a server takes on, 0 is unbounded
+typedef struct {
+    int max_tasks = 0;              // decode tasks queued or running
+    long long max_conn_bytes = 0;   // audio bytes buffered by one connection
+    float max_queued_seconds = 0;   // audio seconds admitted and not decoded yet, all connections
+} AdmissionLimits;
+
+typedef struct {
+    int tasks;                  // decode tasks queued or running
+    float queued_seconds;       // audio seconds admitted and not decoded yet
+    long long admitted;         // tasks admitted so far
+    long long rejected;         // tasks and connections turned away so far
+    bool saturated;             // new work is turned away right now
+} AdmissionStats;
+
+// held by a decode task from the time it is queued until it is done
+typedef std::shared_ptr<void> AdmissionTicket;
+
+class AdmissionControl {
+  /**
+   * Bounds the decode work a server has queued. A server asks for a ticket
+   * before it posts a task and the task keeps the ticket until it is done,
+   * so the counters drop however the task ends. When a limit would be
+   * passed the server answers the client busy instead of queueing, and the
+   * gauges let a load balancer move traffic away before that happens.
+  */
+  public:
+    explicit AdmissionControl(const AdmissionLimits &limits = AdmissionLimits())
+    :limits_(limits){
+    }
+
+    void SetLimits(const AdmissionLimits &limits) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        limits_ = limits;
+    }
+
+    // a task with bytes of int16 audio at audio_fs, nullptr when over a limit
+    AdmissionTicket Admit(size_t bytes, int audio_fs) {
+        long long queued_ms = (long long)bytes * 1000 / (2 * (audio_fs > 0 ? audio_fs : 16000));
+        std::lock_guard<std::mutex> lock(mtx_);
+        // with nothing queued a task is let in whatever its length, else a
+        // file longer than the limit could never be decoded
+        if ((limits_.max_tasks > 0 && tasks_ >= limits_.max_tasks) ||
+            (limits_.max_queued_seconds > 0 && queued_ms_ > 0 &&
+             queued_ms_ + queued_ms > limits_.max_queued_seconds * 1000)) {
+            rejected_++;
+            return nullptr;
+        }
+        tasks_++;
+        queued_ms_ += queued_ms;
+        admitted_++;
+        // the ticket owns the milliseconds it has queued, AddQueued moves them
+        return AdmissionTicket(new long long(queued_ms), [this](void* ticket_ms) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            tasks_--;
+            queued_ms_ -= *(long long*)ticket_ms;
+            delete (long long*)ticket_ms;
+        });
+    }
+
+    // adds (bytes > 0) or removes (bytes < 0) audio of the task holding
+    // ticket, for an upload admitted once that is decoded while it arrives.
+    // Never refuses, the task is already in
+    void AddQueued(const AdmissionTicket &ticket, long long bytes, int audio_fs) {
+        if (!ticket) {
+            return;
+        }
+        long long queued_ms = bytes * 1000 / (2 * (audio_fs > 0 ? audio_fs : 16000));
+        std::lock_guard<std::mutex> lock(mtx_);
+        long long &ticket_ms = *(long long*)ticket.get();
+        queued_ms = std::max(queued_ms, -ticket_ms);
+        ticket_ms += queued_ms;
+        queued_ms_ += queued_ms;
+    }
+
+    bool ConnectionOverLimit(size_t buffered_bytes) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return limits_.max_conn_bytes > 0 && (long long)buffered_bytes > limits_.max_conn_bytes;
+    }
+
+    // true when a new connection would be turned away
+    bool RejectConnection() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (SaturatedLocked()) {
+            rejected_++;
+            return true;
+        }
+        return false;
+    }
+
+    AdmissionStats GetStats() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        AdmissionStats stats;
+        stats.tasks = tasks_;
+        stats.queued_seconds = queued_ms_ / 1000.0f;
+        stats.admitted = admitted_;
+        stats.rejected = rejected_;
+        stats.saturated = SaturatedLocked();
+        return stats;
+    }
+
+    // the gauges as a json object, for the load balancer
+    std::string StatsJson() {
+        AdmissionStats stats = GetStats();
+        AdmissionLimits limits;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            limits = limits_;
+        }
+        std::ostringstream oss;
+        oss << "{\"tasks\":" << stats.tasks
+            << ",\"max_tasks\":" << limits.max_tasks
+            << ",\"queued_seconds\":" << stats.queued_seconds
+            << ",\"max_queued_seconds\":" << limits.max_queued_seconds
+            << ",\"admitted\":" << stats.admitted
+            << ",\"rejected\":" << stats.rejected
+            << ",\"saturated\":" << (stats.saturated ? "true" : "false") << "}";
+        return oss.str();
+    }
+
+  private:
+    bool SaturatedLocked() const {
+        return (limits_.max_tasks > 0 && tasks_ >= limits_.max_tasks) ||
+               (limits_.max_queued_seconds > 0 && queued_ms_ >= limits_.max_queued_seconds * 1000);
+    }
+
+    std::mutex mtx_;
+    AdmissionLimits limits_;
+    int tasks_ = 0;
+    long long queued_ms_ = 0;
+    long long admitted_ = 0;
+    long long rejected_ = 0;
+};
+
+} // namespace funasr
+#endif
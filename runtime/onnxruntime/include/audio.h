@@ -1,8 +1,10 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include <memory>
 #include <queue>
 #include <stdint.h>
+#include <vector>
 #include "vad-model.h"
 #include "offline-stream.h"
 #include "com-define.h"
@@ -35,11 +37,43 @@ class AudioFrame {
     // 2pass
     bool is_final = false;
     float* data = nullptr;
+    // false when data points into the stream's SampleRing instead of a malloc'd copy
+    bool own_data = true;
     int len;
     int global_start = 0; // the start of a frame in the global time axis. in ms
     int global_end = 0;   // the end of a frame in the global time axis. in ms
 };
 
+class SampleRing {
+/**
+ * 2pass sample history of one stream. Samples are addressed by their
+ * absolute index in the stream. Every sample is stored at i%capacity and
+ * i%capacity+capacity, so any window of up to capacity samples is one
+ * contiguous block and frames can point into it instead of copying.
+ * Dropping old samples only moves Begin().
+*/
+  public:
+    explicit SampleRing(int capacity=0);
+    // grows (and moves the data) when the kept window would not fit
+    void Append(const float* samples, int n);
+    // samples before begin are not needed any more
+    void Discard(int begin);
+    // clears the samples and restarts the indexes at 0, keeps the memory
+    void Clear();
+    // pointer to sample index, valid for End()-index samples until the next Append()
+    float* Data(int index);
+    int Begin() const {return begin_;};
+    int End() const {return end_;};
+    int Size() const {return end_ - begin_;};
+
+  private:
+    void Reserve(int capacity);
+    std::vector<float> buf_;
+    int capacity_ = 0;
+    int begin_ = 0;
+    int end_ = 0;
+};
+
 #ifdef _WIN32
 #ifdef _FUNASR_API_EXPORT
 #define DLLAPI __declspec(dllexport)
@@ -49,6 +83,7 @@ class AudioFrame {
 #else
 #define DLLAPI 
 #endif
+class LinearResample;
 class DLLAPI Audio {
   private:
     float *speech_data=nullptr;
@@ -62,6 +97,9 @@ class DLLAPI Audio {
     queue<AudioFrame *> asr_online_queue;
     queue<AudioFrame *> asr_offline_queue;
     int dest_sample_rate;
+    // 2pass: keeps the filter state between chunks of one stream
+    std::unique_ptr<LinearResample> online_resampler;
+    std::unique_ptr<LinearResample> CreateResampler(int32_t sampling_rate);
   public:
     Audio(int data_type);
     Audio(int model_sample_rate,int data_type);
@@ -101,20 +139,22 @@ class DLLAPI Audio {
     char* GetSpeechChar(){return speech_char;}
     int GetSpeechLen(){return speech_len;}
 
-    // 2pass
-    vector<float> all_samples;
+    // 2pass, frames from Split() point into all_samples and stay valid
+    // until the next LoadPcmwavOnline()
+    SampleRing all_samples;
     int offset = 0;
     int speech_start=-1, speech_end=0;
     int speech_offline_start=-1;
 
     int seg_sample = MODEL_SAMPLE_RATE/1000;
-    bool LoadPcmwavOnline(const char* buf, int n_file_len, int32_t* sampling_rate);
+    // input_finished flushes the samples the resampler still holds back
+    bool LoadPcmwavOnline(const char* buf, int n_file_len, int32_t* sampling_rate, bool input_finished=false);
     void ResetIndex(){
       speech_start=-1;
       speech_end=0;
       speech_offline_start=-1;
       offset = 0;
-      all_samples.clear();
+      all_samples.Clear();
     }
 };
 
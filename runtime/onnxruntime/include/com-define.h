@@ -106,6 +106,21 @@ namespace funasr {
 #define VAD_LFR_N 1
 #endif
 
+// long input scored in windows on several threads, see FsmnVad::SetParallel
+#ifndef VAD_WINDOW_MS
+#define VAD_WINDOW_MS 60000
+#endif
+
+// audio before a window that warms up the fsmn memory, longer than its 4*19 frames
+#ifndef VAD_WINDOW_LEAD_MS
+#define VAD_WINDOW_LEAD_MS 1000
+#endif
+
+// decibel floor of the online vad energy gate, at or below it the gate is off
+#ifndef VAD_ENERGY_GATE_OFF
+#define VAD_ENERGY_GATE_OFF -100.0
+#endif
+
 // asr
 #ifndef PARA_LFR_M
 #define PARA_LFR_M 7
@@ -115,6 +130,12 @@ namespace funasr {
 #define PARA_LFR_N 6
 #endif
 
+// positions of the online position embedding table, 60 ms each; later
+// positions of longer streams are computed per chunk
+#ifndef PARA_POS_EMB_MAX_POS
+#define PARA_POS_EMB_MAX_POS 10000
+#endif
+
 #ifndef ONLINE_STEP
 #define ONLINE_STEP 9600
 #endif
@@ -132,6 +153,8 @@ namespace funasr {
 #define QUESTION_INDEX 4
 #define DUN_INDEX 5
 #define CACHE_POP_TRIGGER_LIMIT   200
+// online punc: cached tokens kept as context of the next call
+#define PUNC_CACHE_WINDOW   100
 
 #define JIEBA_DICT "jieba.c.dict"
 #define JIEBA_USERDICT "jieba_usr_dict"
@@ -2,6 +2,7 @@
 #include <map>
 #include <vector>
 #include <unordered_map>
+#include "hotword-embedding.h"
 #ifdef WIN32
 #ifdef _FUNASR_API_EXPORT
 #define  _FUNASRAPI __declspec(dllexport)
@@ -54,8 +55,43 @@ typedef enum {
 	PUNC_ONLINE=1,
 }PUNC_TYPE;
 
+typedef struct {
+	int queue_depth;		// segments waiting for a batch right now
+	long long batches;		// batched Forward calls issued so far
+	long long segments;		// segments decoded through the batcher
+	int max_batch;			// largest batch seen
+	float avg_batch;		// segments / batches
+	float avg_wait_ms;		// mean time a segment waited before its batch ran
+}FUNASR_BATCH_STATS;
+
+typedef struct {
+	long long hits;			// lookups served from the cache
+	long long misses;		// lookups that had to compile
+	long long evictions;	// entries dropped to stay under max_bytes
+	int entries;			// entries cached right now
+	long long bytes;		// memory held by the cached entries
+	long long max_bytes;	// memory limit, 0 disables the cache
+}FUNASR_CACHE_STATS;
+
+typedef struct {
+	int compute_threads;	// threads allowed to compute, 0 when every session has its own pool
+	int slots;				// model runs allowed at once, 0 is unbounded
+	int running;			// model runs in progress
+	int waiting;			// model runs waiting for a slot
+	long long runs;			// model runs so far
+	long long waits;		// runs that had to wait for a slot
+}FUNASR_COMPUTE_STATS;
+
 typedef void (* QM_CALLBACK)(int cur_step, int n_total); // n_total: total steps; cur_step: Current Step.
 
+// compute threads shared by all models, call before the first init. 0 keeps a pool of thread_num threads
+// per model session, -1 uses the number of cores. intra_threads is the size of the shared intra op pool
+_FUNASRAPI bool					FunSetComputeThreads(int compute_threads, int intra_threads=1);
+_FUNASRAPI FUNASR_COMPUTE_STATS	FunGetComputeStats();
+// model runs of the calling thread get a compute slot only when no other thread waits for one,
+// for threads whose work is not latency critical
+_FUNASRAPI void					FunSetComputeBackground(bool background);
+
 // ASR
 _FUNASRAPI FUNASR_HANDLE  	FunASRInit(std::map<std::string, std::string>& model_path, int thread_num, ASR_TYPE type=ASR_OFFLINE);
 _FUNASRAPI FUNASR_HANDLE  	FunASROnlineInit(FUNASR_HANDLE asr_handle, std::vector<int> chunk_size={5,10,5});
@@ -78,6 +114,13 @@ _FUNASRAPI const float	FunASRGetRetSnippetTime(FUNASR_RESULT result);
 // VAD
 _FUNASRAPI FUNASR_HANDLE  	FsmnVadInit(std::map<std::string, std::string>& model_path, int thread_num);
 _FUNASRAPI FUNASR_HANDLE  	FsmnVadOnlineInit(FUNASR_HANDLE fsmnvad_handle);
+// whole input longer than window_ms is split into windows whose fbank and model run on thread_num threads,
+// the segments are the same as those of one pass. 0 threads keeps the one pass
+_FUNASRAPI void				FsmnVadSetParallel(FUNASR_HANDLE handle, int thread_num, int window_ms=60000);
+// online chunks whose frames all stay below decibel_floor skip fbank and the model while no segment is open and
+// are taken as digital silence. decibels are 10*log10 of a 25ms frame's energy of [-1, 1] pcm, digital silence is
+// -60. call before the online streams start, <= -100 scores every chunk (default)
+_FUNASRAPI void				FsmnVadSetEnergyGate(FUNASR_HANDLE handle, float decibel_floor);
 // buffer
 _FUNASRAPI FUNASR_RESULT	FsmnVadInferBuffer(FUNASR_HANDLE handle, const char* sz_buf, int n_len, QM_CALLBACK fn_callback, bool input_finished=true, int sampling_rate=16000, std::string wav_format="pcm");
 // file, support wav & pcm
@@ -98,23 +141,45 @@ _FUNASRAPI void					CTTransformerUninit(FUNASR_HANDLE handle);
 //OfflineStream
 _FUNASRAPI FUNASR_HANDLE  	FunOfflineInit(std::map<std::string, std::string>& model_path, int thread_num, bool use_gpu=false, int batch_size=1);
 _FUNASRAPI void         	FunOfflineReset(FUNASR_HANDLE handle, FUNASR_DEC_HANDLE dec_handle=nullptr);
+// same as FsmnVadSetParallel for the vad of the offline stream
+_FUNASRAPI void				FunOfflineSetVadParallel(FUNASR_HANDLE handle, int thread_num, int window_ms=60000);
 // buffer
 _FUNASRAPI FUNASR_RESULT	FunOfflineInferBuffer(FUNASR_HANDLE handle, const char* sz_buf, int n_len, 
 												  FUNASR_MODE mode, QM_CALLBACK fn_callback, const std::vector<std::vector<float>> &hw_emb, 
 												  int sampling_rate=16000, std::string wav_format="pcm", bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr,
 												  std::string svs_lang="auto", bool svs_itn=true);
+_FUNASRAPI FUNASR_RESULT	FunOfflineInferBuffer(FUNASR_HANDLE handle, const char* sz_buf, int n_len, 
+												  FUNASR_MODE mode, QM_CALLBACK fn_callback, const funasr::HotwordEmbeddingPtr &hw_emb, 
+												  int sampling_rate=16000, std::string wav_format="pcm", bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr,
+												  std::string svs_lang="auto", bool svs_itn=true);
 // file, support wav & pcm
 _FUNASRAPI FUNASR_RESULT	FunOfflineInfer(FUNASR_HANDLE handle, const char* sz_filename, FUNASR_MODE mode, 
 											QM_CALLBACK fn_callback, const std::vector<std::vector<float>> &hw_emb, 
 											int sampling_rate=16000, bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr);
+_FUNASRAPI FUNASR_RESULT	FunOfflineInfer(FUNASR_HANDLE handle, const char* sz_filename, FUNASR_MODE mode, 
+											QM_CALLBACK fn_callback, const funasr::HotwordEmbeddingPtr &hw_emb, 
+											int sampling_rate=16000, bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr);
+// pcm that arrives in pieces: the vad and the recognition of closed segments run while the input is still coming,
+// the result is returned with input_finished and is nullptr before
+_FUNASRAPI FUNASR_HANDLE	FunOfflineIncrementalInit(FUNASR_HANDLE handle);
+_FUNASRAPI FUNASR_RESULT	FunOfflineIncrementalInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE incremental_handle, const char* sz_buf, int n_len,
+															 bool input_finished, int sampling_rate=16000, const funasr::HotwordEmbeddingPtr &hw_emb=nullptr,
+															 bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr, std::string svs_lang="auto", bool svs_itn=true);
 //#if !defined(__APPLE__)
 _FUNASRAPI const std::vector<std::vector<float>> CompileHotwordEmbedding(FUNASR_HANDLE handle, std::string &hotwords, ASR_TYPE mode=ASR_OFFLINE);
+// same embeddings as an immutable object to be shared by all the decodes that use them
+_FUNASRAPI funasr::HotwordEmbeddingPtr CompileSharedHotwordEmbedding(FUNASR_HANDLE handle, std::string &hotwords, ASR_TYPE mode=ASR_OFFLINE);
+// compiled hotword embeddings and wfst bias lms are cached per asr model, least recently used first out
+_FUNASRAPI void				FunSetHotwordCacheLimit(FUNASR_HANDLE handle, long long emb_bytes, long long bias_lm_bytes, ASR_TYPE mode=ASR_OFFLINE);
+_FUNASRAPI FUNASR_CACHE_STATS	FunGetHotwordCacheStats(FUNASR_HANDLE handle, bool bias_lm=false, ASR_TYPE mode=ASR_OFFLINE);
 //#endif
 
 _FUNASRAPI void				FunOfflineUninit(FUNASR_HANDLE handle);
+_FUNASRAPI void				FunOfflineIncrementalUninit(FUNASR_HANDLE incremental_handle);
 
 //2passStream
-_FUNASRAPI FUNASR_HANDLE  	FunTpassInit(std::map<std::string, std::string>& model_path, int thread_num);
+// batch_size > 1 enables batching of offline-pass segments and online chunks across streams, waiting at most batch_wait_ms
+_FUNASRAPI FUNASR_HANDLE  	FunTpassInit(std::map<std::string, std::string>& model_path, int thread_num, int batch_size=1, int batch_wait_ms=20);
 _FUNASRAPI FUNASR_HANDLE    FunTpassOnlineInit(FUNASR_HANDLE tpass_handle, std::vector<int> chunk_size={5,10,5});
 // buffer
 _FUNASRAPI FUNASR_RESULT	FunTpassInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE online_handle, const char* sz_buf, 
@@ -122,6 +187,28 @@ _FUNASRAPI FUNASR_RESULT	FunTpassInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE
 												int sampling_rate=16000, std::string wav_format="pcm", ASR_TYPE mode=ASR_TWO_PASS, 
 												const std::vector<std::vector<float>> &hw_emb={{0.0}}, bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr,
 												std::string svs_lang="auto", bool svs_itn=true);
+_FUNASRAPI FUNASR_RESULT	FunTpassInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE online_handle, const char* sz_buf, 
+												int n_len, std::vector<std::vector<std::string>> &punc_cache, bool input_finished, 
+												int sampling_rate, std::string wav_format, ASR_TYPE mode, 
+												const funasr::HotwordEmbeddingPtr &hw_emb, bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr,
+												std::string svs_lang="auto", bool svs_itn=true);
+// the two passes apart, e.g. on two thread pools: FunTpassOnlineInferBuffer runs the vad and the online asr and
+// queues the segments the vad closes in online_handle, FunTpassOfflineInfer decodes the oldest queued segment
+// and returns nullptr when none waits. Each is called in order for one stream, they may run at the same time
+_FUNASRAPI FUNASR_RESULT	FunTpassOnlineInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE online_handle, const char* sz_buf, 
+												int n_len, std::vector<std::vector<std::string>> &punc_cache, bool input_finished, 
+												int sampling_rate, std::string wav_format, ASR_TYPE mode, bool itn=true);
+_FUNASRAPI int				FunTpassOfflinePending(FUNASR_HANDLE online_handle);
+_FUNASRAPI FUNASR_RESULT	FunTpassOfflineInfer(FUNASR_HANDLE handle, FUNASR_HANDLE online_handle,
+												std::vector<std::vector<std::string>> &punc_cache,
+												const funasr::HotwordEmbeddingPtr &hw_emb, bool itn=true, FUNASR_DEC_HANDLE dec_handle=nullptr,
+												std::string svs_lang="auto", bool svs_itn=true);
+// mode: ASR_OFFLINE for the offline-pass batcher, ASR_ONLINE for the online chunk encoder
+_FUNASRAPI FUNASR_BATCH_STATS	FunTpassGetBatchStats(FUNASR_HANDLE handle, ASR_TYPE mode=ASR_OFFLINE);
+// the vad chunks of the online streams, batched with the same knobs
+_FUNASRAPI FUNASR_BATCH_STATS	FunTpassGetVadBatchStats(FUNASR_HANDLE handle);
+// same as FsmnVadSetEnergyGate for the vad of the 2pass streams
+_FUNASRAPI void				FunTpassSetVadEnergyGate(FUNASR_HANDLE handle, float decibel_floor);
 _FUNASRAPI void				FunTpassUninit(FUNASR_HANDLE handle);
 _FUNASRAPI void				FunTpassOnlineUninit(FUNASR_HANDLE handle);
 
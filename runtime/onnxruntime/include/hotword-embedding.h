@@ -0,0 +1,45 @@
+#ifndef HOTWORD_EMBEDDING_H
+#define HOTWORD_EMBEDDING_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+namespace funasr {
+class HotwordEmbedding {
+  /**
+   * Compiled hotword embeddings, one row per hotword. Built once per hotword
+   * list and never changed afterwards, so every decode of every stream that
+   * uses it shares the same object instead of a copy. The rows are packed
+   * back to back at construction, ready to be the [num, dim] hotword input.
+  */
+  public:
+    explicit HotwordEmbedding(const std::vector<std::vector<float>> &rows)
+    :num_(rows.size()), dim_(rows.empty() ? 0 : rows[0].size()){
+        packed_.reserve(num_ * dim_);
+        for (auto &row : rows) {
+            packed_.insert(packed_.end(), row.begin(), row.end());
+        }
+    }
+
+    int64_t Num() const {return num_;};
+    int64_t Dim() const {return dim_;};
+    bool Empty() const {return num_ == 0;};
+    const float* Data() const {return packed_.data();};
+    size_t Size() const {return packed_.size();};
+
+    bool operator==(const HotwordEmbedding &other) const {
+        return num_ == other.num_ && dim_ == other.dim_ && packed_ == other.packed_;
+    }
+    bool operator!=(const HotwordEmbedding &other) const {return !(*this == other);};
+
+  private:
+    int64_t num_ = 0;
+    int64_t dim_ = 0;
+    std::vector<float> packed_;
+};
+
+typedef std::shared_ptr<const HotwordEmbedding> HotwordEmbeddingPtr;
+
+} // namespace funasr
+#endif
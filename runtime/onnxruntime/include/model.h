@@ -10,6 +10,9 @@
 #include "fst/fstlib.h"
 #include "fst/symbol-table.h"
 namespace funasr {
+class FeatMatrix;
+class FbankPlan;
+class HotwordCache;
 class Model {
   public:
     virtual ~Model(){};
@@ -23,8 +26,11 @@ class Model {
       const std::string &am_config, const std::string &token_file, const std::string &online_token_file, int thread_num){};
     virtual void InitLm(const std::string &lm_file, const std::string &lm_config, const std::string &lex_file){};
     virtual void InitFstDecoder(){};
-    virtual std::string Forward(float *din, int len, bool input_finished, const std::vector<std::vector<float>> &hw_emb={{0.0}}, void* wfst_decoder=nullptr){return "";};
-    virtual std::vector<std::string> Forward(float** din, int* len, bool input_finished, const std::vector<std::vector<float>> &hw_emb={{0.0}}, void* wfst_decoder=nullptr, int batch_in=1)
+    virtual std::string Forward(float *din, int len, bool input_finished, const HotwordEmbeddingPtr &hw_emb=nullptr, void* wfst_decoder=nullptr){return "";};
+    virtual std::vector<std::string> Forward(float** din, int* len, bool input_finished, const HotwordEmbeddingPtr &hw_emb=nullptr, void* wfst_decoder=nullptr, int batch_in=1)
+      {return std::vector<string>();};
+    // same as the batched Forward, starting from fbank frames computed with GetFbankPlan()
+    virtual std::vector<std::string> ForwardFeats(const FeatMatrix* const* feats, int batch_in, bool input_finished=true, const HotwordEmbeddingPtr &hw_emb=nullptr, void* wfst_decoder=nullptr)
       {return std::vector<string>();};
     virtual std::vector<std::string> Forward(float** din, int* len, bool input_finished, std::string svs_lang="auto", bool svs_itn=false, int batch_in=1)
       {return std::vector<string>();};
@@ -39,6 +45,8 @@ class Model {
     virtual Vocab* GetVocab() {return nullptr;};
     virtual Vocab* GetLmVocab() {return nullptr;};
     virtual PhoneSet* GetPhoneSet() {return nullptr;};
+    virtual const FbankPlan* GetFbankPlan() {return nullptr;};
+    virtual HotwordCache* GetHotwordCache() {return nullptr;};
 };
 
 Model *CreateModel(std::map<std::string, std::string>& model_path, int thread_num=1, ASR_TYPE type=ASR_OFFLINE);
@@ -0,0 +1,58 @@
+#ifndef OFFLINE_INCREMENTAL_STREAM_H
+#define OFFLINE_INCREMENTAL_STREAM_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "audio.h"
+#include "hotword-embedding.h"
+#include "offline-stream.h"
+#include "vad-model.h"
+
+namespace funasr {
+class OfflineIncrementalStream {
+  /**
+   * Offline recognition of pcm that arrives in pieces, e.g. an upload that is
+   * still being received. The vad walks the audio in the same one second steps
+   * as Audio::CutSplit as soon as a step is there, and every segment it closes
+   * is recognized right away. When the input ends only the tail is left, the
+   * per segment results are joined the same way as in FunOfflineInferBuffer.
+  */
+  public:
+    OfflineIncrementalStream(OfflineStream* offline_stream);
+    ~OfflineIncrementalStream();
+
+    // int16 pcm, an odd trailing byte is kept for the next call
+    void AcceptPcm(const char* buf, int n_len, int sampling_rate, bool input_finished);
+    // runs the vad over the new samples and recognizes the closed segments,
+    // with input_finished the rest is flushed
+    void Decode(bool input_finished, const HotwordEmbeddingPtr &hw_emb, void* dec_handle,
+                std::string svs_lang, bool svs_itn);
+    float GetTimeLen() const {return (float)samples_.End() / dest_sample_rate_;};
+
+    // recognized segments in time order
+    std::vector<std::string> msgs;
+    std::vector<float> msg_stimes;
+
+  private:
+    void DecodeSegments(const HotwordEmbeddingPtr &hw_emb, void* dec_handle,
+                        std::string svs_lang, bool svs_itn);
+
+    OfflineStream* offline_stream_;
+    std::unique_ptr<VadModel> vad_online_handle_ = nullptr;
+    std::unique_ptr<LinearResample> resampler_ = nullptr;
+    int dest_sample_rate_;
+    int seg_sample_ = MODEL_SAMPLE_RATE/1000;
+
+    SampleRing samples_;      // from the end of the last recognized segment on
+    int vad_offset_ = 0;      // samples given to the vad
+    int speech_start_ = -1;   // ms, start of the open vad segment
+    int speech_end_ = -1;
+    std::vector<std::pair<int, int>> segments_;  // closed and not recognized, in samples
+    bool has_odd_byte_ = false;
+    uint8_t odd_byte_ = 0;
+};
+
+OfflineIncrementalStream* CreateOfflineIncrementalStream(void* offline_stream);
+} // namespace funasr
+#endif
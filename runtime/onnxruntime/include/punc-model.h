@@ -8,6 +8,13 @@
 #include "funasrruntime.h"
 
 namespace funasr {
+// what the online punc model keeps of one cache between calls
+typedef struct {
+    std::vector<std::string> words;  // the cache as the last call left it
+    std::vector<int> ids;            // token ids of words
+    std::vector<float> mask;         // mask buffer, reused by every call
+} PuncOnlineState;
+
 class PuncModel {
   public:
       virtual ~PuncModel(){};
@@ -15,6 +22,8 @@ class PuncModel {
 	  virtual void InitPunc(const std::string &punc_model, const std::string &punc_config, const std::string &token_file, int thread_num)=0;
 	  virtual std::string AddPunc(const char* sz_input, std::string language="zh-cn"){return "";};
 	  virtual std::string AddPunc(const char* sz_input, std::vector<std::string>& arr_cache, std::string language="zh-cn"){return "";};
+	  // incremental online punc: only sz_input is tokenized, the cache ids come from state
+	  virtual std::string AddPunc(const char* sz_input, std::vector<std::string>& arr_cache, PuncOnlineState& state, std::string language="zh-cn"){return AddPunc(sz_input, arr_cache, language);};
 };
 
 PuncModel *CreatePuncModel(std::map<std::string, std::string>& model_path, int thread_num, PUNC_TYPE type=PUNC_OFFLINE);
@@ -1,19 +1,49 @@
 #ifndef TPASS_ONLINE_STREAM_H
 #define TPASS_ONLINE_STREAM_H
 
+#include <deque>
 #include <memory>
+#include <mutex>
 #include "tpass-stream.h"
 #include "model.h"
 #include "vad-model.h"
+#include "punc-model.h"
 
 namespace funasr {
+// a speech segment closed by the vad, waiting for the offline pass
+typedef struct {
+    std::vector<float> samples;     // a copy, the stream's SampleRing moves on
+    FeatMatrix feats;               // the vad fbank frames, valid with has_feats
+    bool has_feats = false;
+    int global_start = 0;           // ms
+    bool input_finished = false;    // closed by the last buffer of the stream
+} TpassSegment;
+
 class TpassOnlineStream {
+  /**
+   * Per-connection state of a 2pass stream. The first pass (vad and online
+   * asr) queues the segments it closes here, and the offline pass takes
+   * them in order. The two may run on different threads, only the queue
+   * is shared between them.
+  */
   public:
     TpassOnlineStream(TpassStream* tpass_stream, std::vector<int> chunk_size);
     ~TpassOnlineStream(){};
 
+    void PushSegment(TpassSegment segment);
+    // the oldest waiting segment, false when none waits
+    bool PopSegment(TpassSegment &segment);
+    int PendingSegments();
+
     std::unique_ptr<VadModel> vad_online_handle = nullptr;
     std::unique_ptr<Model> asr_online_handle = nullptr;
+    // online punc state of punc_cache[0] (first pass) and punc_cache[1]
+    // (offline pass), each only used by the thread of its pass
+    PuncOnlineState punc_state[2];
+
+  private:
+    std::mutex segments_mtx_;
+    std::deque<TpassSegment> segments_;
 };
 TpassOnlineStream* CreateTpassOnlineStream(void* tpass_stream, std::vector<int> chunk_size);
 } // namespace funasr
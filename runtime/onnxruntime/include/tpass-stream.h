@@ -12,14 +12,17 @@
 #endif
 
 namespace funasr {
+class TpassBatcher;
 class TpassStream {
   public:
-    TpassStream(std::map<std::string, std::string>& model_path, int thread_num);
-    ~TpassStream(){};
+    TpassStream(std::map<std::string, std::string>& model_path, int thread_num, int batch_size=1, int batch_wait_ms=20);
+    ~TpassStream();
 
     std::unique_ptr<VadModel> vad_handle = nullptr;
     std::unique_ptr<Model> asr_handle = nullptr;
     std::unique_ptr<PuncModel> punc_online_handle = nullptr;
+    // shared by all TpassOnlineStreams, null when batch_size <= 1
+    std::unique_ptr<TpassBatcher> batcher_handle = nullptr;
 #if !defined(__APPLE__)
     std::unique_ptr<ITNModel> itn_handle = nullptr;
 #endif
@@ -35,6 +38,6 @@ class TpassStream {
     std::string model_type = MODEL_PARA;
 };
 
-TpassStream *CreateTpassStream(std::map<std::string, std::string>& model_path, int thread_num=1);
+TpassStream *CreateTpassStream(std::map<std::string, std::string>& model_path, int thread_num=1, int batch_size=1, int batch_wait_ms=20);
 } // namespace funasr
 #endif
@@ -13,6 +13,10 @@ class VadModel {
     virtual void InitVad(const std::string &vad_model, const std::string &vad_cmvn, const std::string &vad_config, int thread_num)=0;
     virtual std::vector<std::vector<int>> Infer(std::vector<float> &waves, bool input_finished=true)=0;
     virtual int GetVadSampleRate() = 0;
+    // input_finished input longer than window_ms is scored in windows on thread_num threads, 0 scores it in one pass
+    virtual void SetParallel(int thread_num, int window_ms){};
+    // online chunks whose frames all stay below decibel_floor skip fbank and the model, <= -100 scores every chunk
+    virtual void SetEnergyGate(float decibel_floor){};
 };
 
 VadModel *CreateVadModel(std::map<std::string, std::string>& model_path, int thread_num);
@@ -159,10 +159,10 @@ AudioFrame::AudioFrame(int start, int end, bool is_final):start(start),end(end),
     len = end - start;
 }
 AudioFrame::~AudioFrame(){
-    if(data != nullptr){
+    if(data != nullptr && own_data){
         free(data);
-        data = nullptr;
     }
+    data = nullptr;
 }
 int AudioFrame::SetStart(int val)
 {
@@ -193,6 +193,64 @@ int AudioFrame::Disp()
     return 0;
 }
 
+SampleRing::SampleRing(int capacity)
+{
+    if(capacity > 0){
+        Reserve(capacity);
+    }
+}
+
+void SampleRing::Reserve(int capacity)
+{
+    std::vector<float> buf(2 * (size_t)capacity);
+    for(int i = begin_; i < end_; i++){
+        float sample = buf_[i % capacity_];
+        buf[i % capacity] = sample;
+        buf[i % capacity + capacity] = sample;
+    }
+    buf_.swap(buf);
+    capacity_ = capacity;
+}
+
+void SampleRing::Append(const float* samples, int n)
+{
+    if(n <= 0){
+        return;
+    }
+    if(Size() + n > capacity_){
+        Reserve(std::max(std::max(Size() + n, 2 * capacity_), 4 * MODEL_SAMPLE_RATE));
+    }
+    // at most two pieces, each written to both copies
+    int done = 0;
+    while(done < n){
+        int pos = (end_ + done) % capacity_;
+        int piece = std::min(n - done, capacity_ - pos);
+        memcpy(buf_.data() + pos, samples + done, piece * sizeof(float));
+        memcpy(buf_.data() + pos + capacity_, samples + done, piece * sizeof(float));
+        done += piece;
+    }
+    end_ += n;
+}
+
+void SampleRing::Discard(int begin)
+{
+    begin_ = std::min(std::max(begin_, begin), end_);
+}
+
+void SampleRing::Clear()
+{
+    begin_ = 0;
+    end_ = 0;
+}
+
+float* SampleRing::Data(int index)
+{
+    if(capacity_ == 0){
+        return nullptr;
+    }
+    return buf_.data() + index % capacity_;
+}
+
 Audio::Audio(int data_type) : dest_sample_rate(MODEL_SAMPLE_RATE), data_type(data_type)
 {
     speech_buff = nullptr;
@@ -254,7 +312,7 @@ float Audio::GetTimeLen()
     return (float)speech_len / dest_sample_rate;
 }
 
-void Audio::WavResample(int32_t sampling_rate, const float *waveform, int32_t n)
+std::unique_ptr<LinearResample> Audio::CreateResampler(int32_t sampling_rate)
 {
     LOG(INFO) << "Creating a resampler: "
               << " in_sample_rate: "<< sampling_rate
@@ -262,8 +320,13 @@ void Audio::WavResample(int32_t sampling_rate, const float *waveform, int32_t n)
     float min_freq = std::min<int32_t>(sampling_rate, dest_sample_rate);
     float lowpass_cutoff = 0.99 * 0.5 * min_freq;
     int32_t lowpass_filter_width = 6;
-    auto resampler = std::make_unique<LinearResample>(
+    return std::make_unique<LinearResample>(
           sampling_rate, dest_sample_rate, lowpass_cutoff, lowpass_filter_width);
+}
+
+void Audio::WavResample(int32_t sampling_rate, const float *waveform, int32_t n)
+{
+    auto resampler = CreateResampler(sampling_rate);
     std::vector<float> samples;
     resampler->Resample(waveform, n, true, &samples);
     //reset speech_data
@@ -883,7 +946,7 @@ bool Audio::LoadPcmwav(const char* buf, int n_buf_len, int32_t* sampling_rate)
     }
 }
 
-bool Audio::LoadPcmwavOnline(const char* buf, int n_buf_len, int32_t* sampling_rate)
+bool Audio::LoadPcmwavOnline(const char* buf, int n_buf_len, int32_t* sampling_rate, bool input_finished)
 {
     if (speech_data != nullptr) {
         free(speech_data);
@@ -903,14 +966,21 @@ bool Audio::LoadPcmwavOnline(const char* buf, int n_buf_len, int32_t* sampling_r
             speech_data[i] = (float)val / scale;
         }
 
-        //resample
+        //resample, the filter runs across chunk boundaries and only the
+        //last chunk of the stream is flushed
         if(*sampling_rate != dest_sample_rate){
-            WavResample(*sampling_rate, speech_data, speech_len);
+            if(!online_resampler || online_resampler->GetInputSamplingRate() != *sampling_rate){
+                online_resampler = CreateResampler(*sampling_rate);
+            }
+            std::vector<float> samples;
+            online_resampler->Resample(speech_data, speech_len, input_finished, &samples);
+            speech_len = samples.size();
+            free(speech_data);
+            speech_data = (float*)malloc(sizeof(float) * std::max(speech_len, 1));
+            memcpy(speech_data, samples.data(), sizeof(float) * speech_len);
         }
 
-        for (int32_t i = 0; i != speech_len; ++i) {
-            all_samples.emplace_back(speech_data[i]);
-        }
+        all_samples.Append(speech_data, speech_len);
 
         AudioFrame* frame = new AudioFrame(speech_len);
         frame_queue.push(frame);
@@ -1124,10 +1194,7 @@ int Audio::FetchDynamic(float**& dout, int*& len, int*& flag, float*& start_time
     int max_sent = 60*1000*seg_sample; // 60s
     int bs_acc = 0;
     int max_len = 0;
-    int max_batch = 1;
-    #ifdef USE_GPU
-        max_batch = batch_size;
-    #endif
+    int max_batch = std::max(batch_size, 1);
     max_batch = std::min(max_batch, (int)frame_queue.size());
 
     for(int idx=0; idx < max_batch; idx++){
@@ -1238,7 +1305,6 @@ void Audio::Split(OfflineStream* offline_stream)
 
 void Audio::CutSplit(OfflineStream* offline_stream, std::vector<int> &index_vector)
 {
-    std::unique_ptr<VadModel> vad_online_handle = make_unique<FsmnVadOnline>((FsmnVad*)(offline_stream->vad_handle).get());
     AudioFrame *frame;
 
     frame = frame_queue.front();
@@ -1250,17 +1316,24 @@ void Audio::CutSplit(OfflineStream* offline_stream, std::vector<int> &index_vect
     int step = dest_sample_rate*1;
     bool is_final=false;
     vector<std::vector<int>> vad_segments;
-    for (int sample_offset = 0; sample_offset < speech_len; sample_offset += std::min(step, speech_len - sample_offset)) {
-        if (sample_offset + step >= speech_len - 1) {
-                step = speech_len - sample_offset;
-                is_final = true;
-            } else {
-                is_final = false;
+    FsmnVad* fsmn_vad = (FsmnVad*)(offline_stream->vad_handle).get();
+    if (fsmn_vad->UseWindows(speech_len)) {
+        // long audio, windows scored in parallel give whole segments
+        vad_segments = fsmn_vad->InferWindows(speech_data, speech_len);
+    } else {
+        std::unique_ptr<VadModel> vad_online_handle = make_unique<FsmnVadOnline>(fsmn_vad);
+        for (int sample_offset = 0; sample_offset < speech_len; sample_offset += std::min(step, speech_len - sample_offset)) {
+            if (sample_offset + step >= speech_len - 1) {
+                    step = speech_len - sample_offset;
+                    is_final = true;
+                } else {
+                    is_final = false;
+            }
+            std::vector<float> pcm_data(speech_data+sample_offset, speech_data+sample_offset+step);
+            vector<std::vector<int>> cut_segments = vad_online_handle->Infer(pcm_data, is_final);
+            vad_segments.insert(vad_segments.end(), cut_segments.begin(), cut_segments.end());
         }
-        std::vector<float> pcm_data(speech_data+sample_offset, speech_data+sample_offset+step);
-        vector<std::vector<int>> cut_segments = vad_online_handle->Infer(pcm_data, is_final);
-        vad_segments.insert(vad_segments.end(), cut_segments.begin(), cut_segments.end());
-    }    
+    }
 
     int speech_start_i = -1, speech_end_i =-1;
     std::vector<AudioFrame*> vad_frames;
@@ -1347,8 +1420,8 @@ void Audio::Split(VadModel* vad_obj, int chunk_len, bool input_finished, ASR_TYP
                     frame = new AudioFrame(step);
                     frame->global_start = speech_start;
                     frame->global_end = speech_start + step/seg_sample;
-                    frame->data = (float*)malloc(sizeof(float) * step);
-                    memcpy(frame->data, all_samples.data()+start-offset, step*sizeof(float));
+                    frame->data = all_samples.Data(start);
+                    frame->own_data = false;
                     asr_online_queue.push(frame);
                     frame = nullptr;
                     speech_start += step/seg_sample;
@@ -1375,8 +1448,8 @@ void Audio::Split(VadModel* vad_obj, int chunk_len, bool input_finished, ASR_TYP
                     frame->is_final = true;
                     frame->global_start = speech_start_i;
                     frame->global_end = speech_end_i;
-                    frame->data = (float*)malloc(sizeof(float) * (end-start));
-                    memcpy(frame->data, all_samples.data()+start-offset, (end-start)*sizeof(float));
+                    frame->data = all_samples.Data(start);
+                    frame->own_data = false;
                     asr_online_queue.push(frame);
                     frame = nullptr;
                 }
@@ -1386,8 +1459,8 @@ void Audio::Split(VadModel* vad_obj, int chunk_len, bool input_finished, ASR_TYP
                     frame->is_final = true;
                     frame->global_start = speech_start_i;
                     frame->global_end = speech_end_i;
-                    frame->data = (float*)malloc(sizeof(float) * (end-start));
-                    memcpy(frame->data, all_samples.data()+start-offset, (end-start)*sizeof(float));
+                    frame->data = all_samples.Data(start);
+                    frame->own_data = false;
                     asr_offline_queue.push(frame);
                     frame = nullptr;
                 }
@@ -1409,8 +1482,8 @@ void Audio::Split(VadModel* vad_obj, int chunk_len, bool input_finished, ASR_TYP
                         frame = new AudioFrame(step);
                         frame->global_start = speech_start;
                         frame->global_end = speech_start + step/seg_sample;
-                        frame->data = (float*)malloc(sizeof(float) * step);
-                        memcpy(frame->data, all_samples.data()+start-offset, step*sizeof(float));
+                        frame->data = all_samples.Data(start);
+                        frame->own_data = false;
                         asr_online_queue.push(frame);
                         frame = nullptr;
                         speech_start += step/seg_sample;
@@ -1434,8 +1507,8 @@ void Audio::Split(VadModel* vad_obj, int chunk_len, bool input_finished, ASR_TYP
                     frame->is_final = true;
                     frame->global_start = speech_offline_start;
                     frame->global_end = speech_end_i;
-                    frame->data = (float*)malloc(sizeof(float) * (end-offline_start));
-                    memcpy(frame->data, all_samples.data()+offline_start-offset, (end-offline_start)*sizeof(float));
+                    frame->data = all_samples.Data(offline_start);
+                    frame->own_data = false;
                     asr_offline_queue.push(frame);
                     frame = nullptr;
                 }
@@ -1452,8 +1525,8 @@ void Audio::Split(VadModel* vad_obj, int chunk_len, bool input_finished, ASR_TYP
                             frame->is_final = is_final;
                             frame->global_start = (int)((start+sample_offset)/seg_sample);
                             frame->global_end = frame->global_start + step/seg_sample;
-                            frame->data = (float*)malloc(sizeof(float) * step);
-                            memcpy(frame->data, all_samples.data()+start-offset+sample_offset, step*sizeof(float));
+                            frame->data = all_samples.Data(start+sample_offset);
+                            frame->own_data = false;
                             asr_online_queue.push(frame);
                             frame = nullptr;
                         }
@@ -1472,23 +1545,15 @@ void Audio::Split(VadModel* vad_obj, int chunk_len, bool input_finished, ASR_TYP
         }
     }
 
-    // erase all_samples
+    // drop the samples no later frame can start in
     int vector_cache = dest_sample_rate*2;
     if(speech_offline_start == -1){
-        if(all_samples.size() > vector_cache){
-            int erase_num = all_samples.size() - vector_cache;
-            all_samples.erase(all_samples.begin(), all_samples.begin()+erase_num);
-            offset += erase_num;
-        }
+        all_samples.Discard(all_samples.End() - vector_cache);
     }else{
         int offline_start = speech_offline_start*seg_sample;
-         if(offline_start-offset > vector_cache){
-            int erase_num = offline_start-offset - vector_cache;
-            all_samples.erase(all_samples.begin(), all_samples.begin()+erase_num);
-            offset += erase_num;
-        }       
+        all_samples.Discard(offline_start - vector_cache);
     }
-    
+    offset = all_samples.Begin();
 }
 
 } // namespace funasr
@@ -0,0 +1,163 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "funasrruntime.h"
+
+namespace funasr {
+
+    template <typename Task>
+    class BatchQueue {
+    /**
+     * Leader based batching of work items submitted by many caller threads.
+     * Submit() blocks the caller. The caller at the front of the queue becomes
+     * the leader: it waits up to max_wait_ms for the queue to fill (not at all
+     * when no other item is queued or running), takes up to max_batch items
+     * that can_join the batch started by its own item, runs them with run() on
+     * its own thread and wakes the other callers of the batch.
+     * Every caller waits on the condition variable of its own node, so only the
+     * callers whose results are ready, and the next leader, are woken.
+    */
+    public:
+        typedef std::function<bool(const std::vector<Task*> &batch, const Task &item)> JoinFn;
+        typedef std::function<void(std::vector<Task*> &batch)> RunFn;
+
+        BatchQueue(int max_batch, int max_wait_ms)
+        :max_batch_(std::max(max_batch, 1)),
+         max_wait_(std::max(max_wait_ms, 0)){
+        }
+
+        int GetMaxBatch() const {return max_batch_;};
+        int GetMaxWaitMs() const {return (int)max_wait_.count();};
+
+        void Submit(Task &task, const JoinFn &can_join, const RunFn &run)
+        {
+            std::shared_ptr<Node> node = std::make_shared<Node>();
+            node->task = &task;
+            node->enqueue_time = std::chrono::steady_clock::now();
+
+            std::unique_lock<std::mutex> lock(mtx_);
+            queue_.push_back(node);
+            if(queue_.front() != node && queue_.size() >= (size_t)max_batch_){
+                // the leader may stop waiting for more
+                queue_.front()->cv.notify_one();
+            }
+
+            while(!node->done){
+                if(queue_.empty() || queue_.front() != node){
+                    node->cv.wait(lock);
+                    continue;
+                }
+
+                // leader: give other callers max_wait_ to join this batch. With
+                // nothing else queued or running no one is about to join, so a
+                // lone caller runs right away
+                if(queue_.size() > 1 || in_flight_ > 0){
+                    node->cv.wait_until(lock, node->enqueue_time + max_wait_,
+                        [this]{ return queue_.size() >= (size_t)max_batch_; });
+                }
+
+                std::vector<std::shared_ptr<Node>> nodes;
+                std::vector<Task*> batch;
+                for(auto it = queue_.begin(); it != queue_.end() && batch.size() < (size_t)max_batch_;){
+                    if(!batch.empty() && !can_join(batch, *((*it)->task))){
+                        ++it;
+                        continue;
+                    }
+                    nodes.push_back(*it);
+                    batch.push_back((*it)->task);
+                    it = queue_.erase(it);
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                for(auto &item : nodes){
+                    wait_ms_sum_ += std::chrono::duration<double, std::milli>(now - item->enqueue_time).count();
+                }
+                batches_++;
+                items_ += batch.size();
+                max_batch_seen_ = std::max(max_batch_seen_, (int)batch.size());
+                // wake the next leader while this batch is running
+                if(!queue_.empty()){
+                    queue_.front()->cv.notify_one();
+                }
+
+                // the guard relocks and wakes the batch however run() returns,
+                // a throwing run() leaves the tasks it did not finish as failed
+                in_flight_ += batch.size();
+                lock.unlock();
+                RunGuard guard(this, lock, nodes, node);
+                run(batch);
+            }
+        }
+
+        FUNASR_BATCH_STATS GetStats()
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            FUNASR_BATCH_STATS stats;
+            stats.queue_depth = queue_.size();
+            stats.batches = batches_;
+            stats.segments = items_;
+            stats.max_batch = max_batch_seen_;
+            stats.avg_batch = batches_ > 0 ? (float)items_ / batches_ : 0.0f;
+            stats.avg_wait_ms = items_ > 0 ? (float)(wait_ms_sum_ / items_) : 0.0f;
+            return stats;
+        }
+
+    private:
+        struct Node {
+            Task* task = nullptr;
+            std::chrono::steady_clock::time_point enqueue_time;
+            bool done = false;
+            std::condition_variable cv;  // waited on by the caller of task only
+        };
+
+        // ends a running batch: relocks, takes it off in_flight_ and marks its
+        // nodes done, waking the callers other than the leader
+        class RunGuard {
+        public:
+            RunGuard(BatchQueue* queue, std::unique_lock<std::mutex> &lock,
+                     const std::vector<std::shared_ptr<Node>> &nodes, const std::shared_ptr<Node> &leader)
+            :queue_(queue), lock_(lock), nodes_(nodes), leader_(leader){
+            }
+            ~RunGuard(){
+                lock_.lock();
+                queue_->in_flight_ -= nodes_.size();
+                for(auto &item : nodes_){
+                    item->done = true;
+                    if(item != leader_){
+                        item->cv.notify_one();
+                    }
+                }
+            }
+        private:
+            BatchQueue* queue_;
+            std::unique_lock<std::mutex> &lock_;
+            const std::vector<std::shared_ptr<Node>> &nodes_;
+            const std::shared_ptr<Node> &leader_;
+        };
+
+        int max_batch_ = 1;
+        std::chrono::milliseconds max_wait_;
+
+        std::mutex mtx_;
+        std::deque<std::shared_ptr<Node>> queue_;
+        int in_flight_ = 0;  // items of the batches running right now
+
+        // statistics, guarded by mtx_
+        long long batches_ = 0;
+        long long items_ = 0;
+        int max_batch_seen_ = 0;
+        double wait_ms_sum_ = 0.0;
+    };
+
+} // namespace funasr
@@ -173,6 +173,16 @@ void BiasLm::VocabIdToPhnIdVector(int vocab_id, std::vector<int> &phn_ids) {
   if (is_oov) { phn_ids.clear(); }
 }
 
+size_t BiasLm::MemoryBytes() const {
+  size_t bytes = sizeof(BiasLm) + node_list_.size() * sizeof(Node);
+  if (graph_) {
+    for (fst::StateIterator<fst::StdVectorFst> siter(*graph_); !siter.Done(); siter.Next()) {
+      bytes += sizeof(fst::VectorState<Arc>) + graph_->NumArcs(siter.Value()) * sizeof(Arc);
+    }
+  }
+  return bytes;
+}
+
 std::string BiasLm::GetPhoneLabel(int phone_id) {
   if (phone_id < 0 || phone_id >= phn_set_.Size()) { return ""; }
   return phn_set_.Id2String(phone_id);
@@ -139,6 +139,8 @@ class BiasLm {
   void VocabIdToPhnIdVector(int vocab_id, std::vector<int> &phn_ids);
   void LoadCfgFromYaml(const char* filename, BiasLmOption &opt);
   std::string GetPhoneLabel(int phone_id);
+  // approximate memory held by the graph, for the hotword cache
+  size_t MemoryBytes() const;
  private:
   const PhoneSet& phn_set_;
   const Vocab& vocab_;
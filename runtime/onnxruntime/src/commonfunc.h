@@ -1,5 +1,6 @@
 #pragma once 
 #include <algorithm>
+#include "punc-model.h"
 #ifdef _WIN32
 #include <codecvt>
 #endif
@@ -24,6 +25,7 @@ typedef struct
 {
     string msg;
     vector<string> arr_cache;
+    PuncOnlineState punc_state;
 }FUNASR_PUNC_RESULT;
 
 #ifdef _WIN32
@@ -0,0 +1,148 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+#include "precomp.h"
+#include <algorithm>
+#include <thread>
+
+namespace funasr {
+
+ComputeScheduler& ComputeScheduler::Instance()
+{
+    static ComputeScheduler scheduler;
+    return scheduler;
+}
+
+bool ComputeScheduler::SetComputeThreads(int compute_threads, int intra_threads)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(env_){
+        LOG(ERROR) << "compute threads have to be set before the first model is loaded";
+        return false;
+    }
+    if(compute_threads < 0){
+        compute_threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    }
+    if(compute_threads == 0){
+        global_pools_ = false;
+        slots_ = 0;
+        compute_threads_ = 0;
+        return true;
+    }
+    intra_threads_ = std::min(std::max(intra_threads, 1), compute_threads);
+    // the caller of Run works in its own parallel sections, so the pool adds
+    // intra_threads-1 workers to the threads inside Run
+    compute_threads_ = compute_threads;
+    slots_ = compute_threads - intra_threads_ + 1;
+    global_pools_ = true;
+    LOG(INFO) << "compute threads: " << compute_threads << ", shared intra op threads: " << intra_threads_
+              << ", parallel model runs: " << slots_;
+    return true;
+}
+
+Ort::Env& ComputeScheduler::GetEnv()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(!env_){
+        // onnxruntime keeps one env per process, it has to be made with the
+        // global pools before any session exists. Never freed, sessions
+        // released at exit may still need it
+        if(global_pools_){
+            Ort::ThreadingOptions threading_options;
+            threading_options.SetGlobalIntraOpNumThreads(intra_threads_);
+            threading_options.SetGlobalInterOpNumThreads(1);
+            // spinning workers would take the cores of the other runs
+            threading_options.SetGlobalSpinControl(0);
+            env_ = new Ort::Env(threading_options, ORT_LOGGING_LEVEL_ERROR, "funasr");
+        }else{
+            env_ = new Ort::Env(ORT_LOGGING_LEVEL_ERROR, "funasr");
+        }
+    }
+    return *env_;
+}
+
+void ComputeScheduler::SetSessionThreads(Ort::SessionOptions &options, int thread_num)
+{
+    GetEnv();
+    if(global_pools_){
+        options.DisablePerSessionThreads();
+    }else{
+        options.SetIntraOpNumThreads(thread_num);
+    }
+}
+
+static thread_local bool background_thread = false;
+
+void ComputeScheduler::SetBackground(bool background)
+{
+    background_thread = background;
+}
+
+void ComputeScheduler::Acquire()
+{
+    if(slots_ == 0){
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    runs_++;
+    if(background_thread){
+        if(running_ >= slots_ || waiting_foreground_ > 0){
+            waits_++;
+            waiting_++;
+            cv_.wait(lock, [this]{ return running_ < slots_ && waiting_foreground_ == 0; });
+            waiting_--;
+        }
+    }else if(running_ >= slots_){
+        waits_++;
+        waiting_++;
+        waiting_foreground_++;
+        cv_.wait(lock, [this]{ return running_ < slots_; });
+        waiting_--;
+        waiting_foreground_--;
+    }
+    running_++;
+    // a background run may be let in by the last foreground waiter leaving
+    bool wake_others = running_ < slots_ && waiting_ > 0;
+    lock.unlock();
+    if(wake_others){
+        cv_.notify_all();
+    }
+}
+
+void ComputeScheduler::Release()
+{
+    if(slots_ == 0){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        running_--;
+    }
+    // all, a background waiter woken alone could not take the slot from a foreground one
+    cv_.notify_all();
+}
+
+FUNASR_COMPUTE_STATS ComputeScheduler::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    FUNASR_COMPUTE_STATS stats;
+    stats.compute_threads = compute_threads_;
+    stats.slots = slots_;
+    stats.running = running_;
+    stats.waiting = waiting_;
+    stats.runs = runs_;
+    stats.waits = waits_;
+    return stats;
+}
+
+std::vector<Ort::Value> RunSession(Ort::Session &session, const char* const* input_names,
+                                   const Ort::Value* input_values, size_t input_count,
+                                   const char* const* output_names, size_t output_count)
+{
+    ComputeSlot compute_slot;
+    return session.Run(Ort::RunOptions{nullptr}, input_names, input_values, input_count, output_names, output_count);
+}
+
+} // namespace funasr
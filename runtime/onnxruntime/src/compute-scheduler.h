@@ -0,0 +1,71 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "funasrruntime.h"
+
+namespace funasr {
+
+    class ComputeScheduler {
+    /**
+     * Compute resources of all onnx models in the process. Every session is
+     * created in the one Ort::Env made here. By default each session keeps
+     * its own intra op pool of thread_num threads. After SetComputeThreads
+     * the env owns global pools that replace the per session ones instead,
+     * and Session::Run is admitted through a fixed number of slots. The
+     * callers inside Run plus the shared pool workers then stay within
+     * compute_threads, however many decoder threads call into the models.
+    */
+    public:
+        static ComputeScheduler& Instance();
+
+        // only before the first model is loaded, see FunSetComputeThreads
+        bool SetComputeThreads(int compute_threads, int intra_threads);
+        Ort::Env& GetEnv();
+        void SetSessionThreads(Ort::SessionOptions &options, int thread_num);
+
+        // runs of a background thread only get a slot no other thread waits for
+        static void SetBackground(bool background);
+        void Acquire();
+        void Release();
+        FUNASR_COMPUTE_STATS GetStats();
+
+    private:
+        ComputeScheduler(){};
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        Ort::Env* env_ = nullptr;
+        bool global_pools_ = false;
+        int compute_threads_ = 0;
+        int intra_threads_ = 1;
+        std::atomic<int> slots_{0};  // 0 admits every Run, fixed once the env exists
+        int running_ = 0;
+        int waiting_ = 0;
+        int waiting_foreground_ = 0;
+        long long runs_ = 0;
+        long long waits_ = 0;
+    };
+
+    // holds a compute slot for the Run of one session
+    class ComputeSlot {
+    public:
+        ComputeSlot(){ ComputeScheduler::Instance().Acquire(); };
+        ~ComputeSlot(){ ComputeScheduler::Instance().Release(); };
+        ComputeSlot(const ComputeSlot &) = delete;
+        ComputeSlot &operator=(const ComputeSlot &) = delete;
+    };
+
+    // Session::Run inside a compute slot
+    std::vector<Ort::Value> RunSession(Ort::Session &session, const char* const* input_names,
+                                       const Ort::Value* input_values, size_t input_count,
+                                       const char* const* output_names, size_t output_count);
+
+} // namespace funasr
@@ -7,17 +7,17 @@
 
 namespace funasr {
 CTTransformerOnline::CTTransformerOnline()
-:env_(ORT_LOGGING_LEVEL_ERROR, ""),session_options{}
+:session_options{}
 {
 }
 
 void CTTransformerOnline::InitPunc(const std::string &punc_model, const std::string &punc_config, const std::string &token_file, int thread_num){
-    session_options.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(session_options, thread_num);
     session_options.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     session_options.DisableCpuMemArena();
 
     try{
-        m_session = std::make_unique<Ort::Session>(env_, ORTSTRING(punc_model).c_str(), session_options);
+        m_session = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(punc_model).c_str(), session_options);
         LOG(INFO) << "Successfully load model from " << punc_model;
     }
     catch (std::exception const &e) {
@@ -37,18 +37,35 @@ CTTransformerOnline::~CTTransformerOnline()
 
 string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_cache, std::string language)
 {
-    string strResult;
-    vector<string> strOut;
-    vector<int> InputData;
-    string strText; //full_text
-    strText = accumulate(arr_cache.begin(), arr_cache.end(), strText);
+    PuncOnlineState state;
+    return AddPunc(sz_input, arr_cache, state, language);
+}
 
-    // 如果上一句的结尾是英语字母，并且这一句的开始也是英语字母，应该添加空格
-    if ((strText.size() > 0 && !(strText[strText.size()-1] & 0x80)) && (strlen(sz_input) > 0 && !(sz_input[0] & 0x80)))
-        strText += " ";
+string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_cache, PuncOnlineState &state, std::string language)
+{
+    // the cache holds tokens of earlier calls, their ids are kept in state.
+    // A cache the caller changed (cleared, or passed without its state) is
+    // looked up again, only the new text goes through the tokenizer
+    if (state.words != arr_cache)
+    {
+        state.ids = m_tokenizer.String2Ids(arr_cache);
+    }
+    // cap the attention window, the dropped tokens were output already
+    if (arr_cache.size() > PUNC_CACHE_WINDOW)
+    {
+        int nDrop = arr_cache.size() - PUNC_CACHE_WINDOW;
+        arr_cache.erase(arr_cache.begin(), arr_cache.begin() + nDrop);
+        state.ids.erase(state.ids.begin(), state.ids.begin() + nDrop);
+    }
+    int nCacheSize = arr_cache.size();
 
-    strText += sz_input;  // full_text = precache + text  
-    m_tokenizer.Tokenize(strText.c_str(), strOut, InputData);
+    vector<string> strOut(arr_cache); // full_text = precache + text
+    vector<int> InputData(state.ids);
+    vector<string> NewStr;
+    vector<int> NewIDs;
+    m_tokenizer.Tokenize(sz_input, NewStr, NewIDs);
+    strOut.insert(strOut.end(), NewStr.begin(), NewStr.end());
+    InputData.insert(InputData.end(), NewIDs.begin(), NewIDs.end());
 
     int nTotalBatch = ceil((float)InputData.size() / TOKEN_LEN);
     int nCurBatch = -1;
@@ -58,6 +75,7 @@ string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_ca
     vector<int>     new_mini_sentence_punc; //          sentence_punc_list = []
     vector<string> sentenceOut; // sentenceOut
     vector<string> sentence_punc_list,sentence_words_list,sentence_punc_list_out; // sentence_words_list = []
+    vector<int> sentence_ids_list;
     
     int nSkipNum = 0;
     int nDiff = 0;
@@ -69,7 +87,7 @@ string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_ca
         InputIDs.insert(InputIDs.begin(), RemainIDs.begin(), RemainIDs.end()); // RemainIDs+InputIDs;
         InputStr.insert(InputStr.begin(), RemainStr.begin(), RemainStr.end()); // RemainStr+InputStr;
 
-        auto Punction = Infer(InputIDs, arr_cache.size());
+        auto Punction = Infer(InputIDs, nCacheSize, state.mask);
         nCurBatch = i / TOKEN_LEN;
         if (nCurBatch < nTotalBatch - 1) // not the last minisetence
         {
@@ -104,9 +122,24 @@ string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_ca
         }
 
         sentence_words_list.insert(sentence_words_list.end(), InputStr.begin(), InputStr.end());
+        sentence_ids_list.insert(sentence_ids_list.end(), InputIDs.begin(), InputIDs.begin() + InputStr.size());
 
         new_mini_sentence_punc.insert(new_mini_sentence_punc.end(), Punction.begin(), Punction.end());
     }    
+    nSentEnd = -1;
+    for (int i = sentence_punc_list.size() - 2; i > 0; i--)
+    {
+        if (new_mini_sentence_punc[i] == PERIOD_INDEX || new_mini_sentence_punc[i] == QUESTION_INDEX)
+        {
+            nSentEnd = i;
+            break;
+        }
+    }
+    // the new cache is taken before the words get their spaces for output
+    arr_cache.assign(sentence_words_list.begin() + (nSentEnd + 1), sentence_words_list.end());
+    state.ids.assign(sentence_ids_list.begin() + (nSentEnd + 1), sentence_ids_list.end());
+    state.words = arr_cache;
+
     vector<string> WordWithPunc;
     for (int i = 0; i < sentence_words_list.size(); i++) // for i in range(0, len(sentence_words_list)):
     {
@@ -114,12 +147,12 @@ string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_ca
         {
             sentence_words_list[i] = sentence_words_list[i] + " ";
         }
-        if (nSkipNum < arr_cache.size())  //    if skip_num < len(cache):
+        if (nSkipNum < nCacheSize)  //    if skip_num < len(cache):
             nSkipNum++;
         else
             WordWithPunc.push_back(sentence_words_list[i]);
 
-        if (nSkipNum >= arr_cache.size())
+        if (nSkipNum >= nCacheSize)
         {
             sentence_punc_list_out.push_back(sentence_punc_list[i]);
             if (sentence_punc_list[i] != NOTPUNC)
@@ -130,17 +163,6 @@ string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_ca
     }
 
     sentenceOut.insert(sentenceOut.end(), WordWithPunc.begin(), WordWithPunc.end()); //
-    nSentEnd = -1;
-    for (int i = sentence_punc_list.size() - 2; i > 0; i--)
-    {
-        if (new_mini_sentence_punc[i] == PERIOD_INDEX || new_mini_sentence_punc[i] == QUESTION_INDEX)
-        {
-            nSentEnd = i;
-            break;
-        }
-    }
-    arr_cache.assign(sentence_words_list.begin() + (nSentEnd + 1), sentence_words_list.end());
-
     if (sentenceOut.size() > 0 && m_tokenizer.IsPunc(sentenceOut[sentenceOut.size() - 1]))
     {
         sentenceOut.assign(sentenceOut.begin(), sentenceOut.end() - 1);
@@ -149,7 +171,7 @@ string CTTransformerOnline::AddPunc(const char* sz_input, vector<string> &arr_ca
     return accumulate(sentenceOut.begin(), sentenceOut.end(), string(""));
 }
 
-vector<int> CTTransformerOnline::Infer(vector<int32_t> input_data, int nCacheSize)
+vector<int> CTTransformerOnline::Infer(vector<int32_t> &input_data, int nCacheSize, vector<float> &arVadMask)
 {
     Ort::MemoryInfo m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
     vector<int> punction;
@@ -170,9 +192,7 @@ vector<int> CTTransformerOnline::Infer(vector<int32_t> input_data, int nCacheSiz
         text_lengths_dim.data(),
         text_lengths_dim.size()); //, ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32);
 
-    //vad_mask
-    // vector<float> arVadMask,arSubMask;
-    vector<float> arVadMask;
+    //vad_mask, the buffer is kept by the caller and only grows
     int nTextLength = input_data.size();
 
     VadMask(nTextLength, nCacheSize, arVadMask);
@@ -201,7 +221,7 @@ vector<int> CTTransformerOnline::Infer(vector<int32_t> input_data, int nCacheSiz
     input_onnx.emplace_back(std::move(onnx_sub_mask));
         
     try {
-        auto outputTensor = m_session->Run(Ort::RunOptions{nullptr}, m_szInputNames.data(), input_onnx.data(), m_szInputNames.size(), m_szOutputNames.data(), m_szOutputNames.size());
+        auto outputTensor = RunSession(*m_session, m_szInputNames.data(), input_onnx.data(), m_szInputNames.size(), m_szOutputNames.data(), m_szOutputNames.size());
         std::vector<int64_t> outputShape = outputTensor[0].GetTensorTypeAndShapeInfo().GetShape();
 
         int64_t outputCount = std::accumulate(outputShape.begin(), outputShape.end(), 1, std::multiplies<int64_t>());
@@ -222,7 +242,6 @@ vector<int> CTTransformerOnline::Infer(vector<int32_t> input_data, int nCacheSiz
 
 void CTTransformerOnline::VadMask(int nSize, int vad_pos, vector<float>& Result)
 {
-    Result.resize(0);
     Result.assign(nSize * nSize, 1);
     if (vad_pos <= 0 || vad_pos >= nSize)
     {
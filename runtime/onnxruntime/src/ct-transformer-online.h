@@ -21,15 +21,15 @@ private:
 	vector<const char*> m_szOutputNames;
 
 	std::shared_ptr<Ort::Session> m_session;
-    Ort::Env env_;
     Ort::SessionOptions session_options;
 public:
 
 	CTTransformerOnline();
 	void InitPunc(const std::string &punc_model, const std::string &punc_config, const std::string &token_file, int thread_num);
 	~CTTransformerOnline();
-	vector<int>  Infer(vector<int32_t> input_data, int nCacheSize);
+	vector<int>  Infer(vector<int32_t> &input_data, int nCacheSize, vector<float> &arVadMask);
 	string AddPunc(const char* sz_input, vector<string> &arr_cache, std::string language="zh-cn");
+	string AddPunc(const char* sz_input, vector<string> &arr_cache, PuncOnlineState &state, std::string language="zh-cn");
 	void Transport(vector<float>& In, int nRows, int nCols);
 	void VadMask(int size, int vad_pos,vector<float>& Result);
 	void Triangle(int text_length, vector<float>& Result);
@@ -7,17 +7,17 @@
 
 namespace funasr {
 CTTransformer::CTTransformer()
-:env_(ORT_LOGGING_LEVEL_ERROR, ""),session_options{}
+:session_options{}
 {
 }
 
 void CTTransformer::InitPunc(const std::string &punc_model, const std::string &punc_config, const std::string &token_file, int thread_num){
-    session_options.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(session_options, thread_num);
     session_options.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     session_options.DisableCpuMemArena();
 
     try{
-        m_session = std::make_unique<Ort::Session>(env_, ORTSTRING(punc_model).c_str(), session_options);
+        m_session = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(punc_model).c_str(), session_options);
         LOG(INFO) << "Successfully load model from " << punc_model;
     }
     catch (std::exception const &e) {
@@ -179,7 +179,7 @@ vector<int> CTTransformer::Infer(vector<int32_t> input_data)
     input_onnx.emplace_back(std::move(onnx_text_lengths));
         
     try {
-        auto outputTensor = m_session->Run(Ort::RunOptions{nullptr}, m_szInputNames.data(), input_onnx.data(), m_szInputNames.size(), m_szOutputNames.data(), m_szOutputNames.size());
+        auto outputTensor = RunSession(*m_session, m_szInputNames.data(), input_onnx.data(), m_szInputNames.size(), m_szOutputNames.data(), m_szOutputNames.size());
         std::vector<int64_t> outputShape = outputTensor[0].GetTensorTypeAndShapeInfo().GetShape();
 
         int64_t outputCount = std::accumulate(outputShape.begin(), outputShape.end(), 1, std::multiplies<int64_t>());
@@ -21,7 +21,6 @@ private:
 	vector<const char*> m_szOutputNames;
 
 	std::shared_ptr<Ort::Session> m_session;
-    Ort::Env env_;
     Ort::SessionOptions session_options;
 public:
 
@@ -15,6 +15,7 @@
 #include <iostream>
 #include <numeric>
 #include <cassert>
+#include <cstdint>
 
 namespace funasr {
 enum class VadStateMachine {
@@ -299,17 +300,21 @@ public:
         this->ResetDetection();
     }
 
+    // a segment is open, its frames have to be scored by the model
+    bool InSpeech() const {
+        return vad_state_machine == VadStateMachine::kVadInStateInSpeechSegment;
+    }
+
     std::vector<std::vector<int>>
     operator()(const std::vector<std::vector<float>> &score, const std::vector<float> &waveform, bool is_final = false,
                bool online = false, int max_end_sil = 800, int max_single_segment_time = 15000,
                float speech_noise_thres = 0.8, int sample_rate = 16000) {
         max_end_sil_frame_cnt_thresh = max_end_sil - vad_opts.speech_to_sil_time_thres;
-        this->waveform = waveform;
         this->vad_opts.max_single_segment_time = max_single_segment_time;
         this->speech_noise_thres = speech_noise_thres;
         this->vad_opts.sample_rate = sample_rate;
 
-        ComputeDecibel();
+        ComputeDecibel(waveform);
         ComputeScores(score);
         if (!is_final) {
             DetectCommonFrames();
@@ -356,6 +361,8 @@ public:
 
         if (is_final) {
             AllResetDetection();
+        } else {
+            CompactHistory();
         }
         return segment_batch;
     }
@@ -383,13 +390,15 @@ private:
     std::vector<E2EVadFrameProb> frame_probs;
     int max_end_sil_frame_cnt_thresh;
     float speech_noise_thres;
-    std::vector<std::vector<float>> scores;
+    // scores of the chunk being detected, only valid during operator()
+    const std::vector<std::vector<float>> *scores = nullptr;
     int idx_pre_chunk = 0;
     bool max_time_out;
+    // decibels of the frames not detected yet, decibel[0] is frame decibel_offset
     std::vector<float> decibel;
+    int decibel_offset = 0;
     int data_buf_size = 0;
-    int data_buf_all_size = 0;
-    std::vector<float> waveform;
+    int64_t data_buf_all_size = 0;
 
     void AllResetDetection() {
         is_final = false;
@@ -412,13 +421,13 @@ private:
         frame_probs.clear();
         max_end_sil_frame_cnt_thresh = vad_opts.max_end_silence_time - vad_opts.speech_to_sil_time_thres;
         speech_noise_thres = vad_opts.speech_noise_thres;
-        scores.clear();
+        scores = nullptr;
         idx_pre_chunk = 0;
         max_time_out = false;
         decibel.clear();
-        int data_buf_size = 0;
-        int data_buf_all_size = 0;
-        waveform.clear();
+        decibel_offset = 0;
+        data_buf_size = 0;
+        data_buf_all_size = 0;
         ResetDetection();
     }
 
@@ -434,7 +443,36 @@ private:
         frame_probs.clear();
     }
 
-    void ComputeDecibel() {
+    /**
+     * A stream that is never finalized would otherwise keep every decibel,
+     * frame prob and emitted segment of the call. Frames before frm_cnt are
+     * never looked at again, segments before output_data_buf_offset are sent
+     * and frames before data_buf_start_frame are popped, so only what is
+     * still pending is kept and memory stays flat however long the call is.
+    */
+    void CompactHistory() {
+        int drop = std::min((int)decibel.size(), frm_cnt - decibel_offset);
+        if (drop > 0) {
+            decibel.erase(decibel.begin(), decibel.begin() + drop);
+            decibel_offset += drop;
+        }
+        // the last segment stays, PopDataToOutputBuf extends it
+        int sent = std::min(output_data_buf_offset, (int)output_data_buf.size() - 1);
+        if (sent > 0) {
+            output_data_buf.erase(output_data_buf.begin(), output_data_buf.begin() + sent);
+            output_data_buf_offset -= sent;
+        }
+        size_t popped = 0;
+        while (popped < frame_probs.size() && frame_probs[popped].frame_id < data_buf_start_frame) {
+            popped++;
+        }
+        if (popped > 0) {
+            frame_probs.erase(frame_probs.begin(), frame_probs.begin() + popped);
+        }
+        scores = nullptr;
+    }
+
+    void ComputeDecibel(const std::vector<float> &waveform) {
         int frame_sample_length = int(vad_opts.frame_length_ms * vad_opts.sample_rate / 1000);
         int frame_shift_length = int(vad_opts.frame_in_ms * vad_opts.sample_rate / 1000);
         if (data_buf_all_size == 0) {
@@ -455,7 +493,7 @@ private:
     void ComputeScores(const std::vector<std::vector<float>> &scores) {
         vad_opts.nn_eval_block_size = scores.size();
         frm_cnt += scores.size();
-        this->scores = scores;
+        this->scores = &scores;
     }
 
     void PopDataBufTillFrame(int frame_idx) {
@@ -463,7 +501,7 @@ private:
       while (data_buf_start_frame < frame_idx) {
         if (data_buf_size >= frame_sample_length) {
           data_buf_start_frame += 1;
-          data_buf_size = data_buf_all_size - data_buf_start_frame * frame_sample_length;
+          data_buf_size = int(data_buf_all_size - (int64_t)data_buf_start_frame * frame_sample_length);
         }
       }
     }
@@ -590,7 +628,9 @@ private:
 
     FrameState GetFrameState(int t) {
         FrameState frame_state = FrameState::kFrameStateInvalid;
-        float cur_decibel = decibel[t];
+        int decibel_idx = t - decibel_offset;
+        float cur_decibel = (decibel_idx >= 0 && decibel_idx < (int)decibel.size()) ?
+                            decibel[decibel_idx] : vad_opts.decibel_thres - 1;
         float cur_snr = cur_decibel - noise_average_decibel;
         if (cur_decibel < vad_opts.decibel_thres) {
             frame_state = FrameState::kFrameStateSil;
@@ -603,7 +643,7 @@ private:
         if (sil_pdf_ids.size() > 0) {
             std::vector<float> sil_pdf_scores;
             for (auto sil_pdf_id: sil_pdf_ids) {
-                sil_pdf_scores.push_back(scores[t - idx_pre_chunk][sil_pdf_id]);
+                sil_pdf_scores.push_back((*scores)[t - idx_pre_chunk][sil_pdf_id]);
             }
             sum_score = accumulate(sil_pdf_scores.begin(), sil_pdf_scores.end(), 0.0);
             noise_prob = log(sum_score) * vad_opts.speech_2_noise_ratio;
@@ -647,7 +687,7 @@ private:
             frame_state = GetFrameState(frm_cnt - 1 - i);
             DetectOneFrame(frame_state, frm_cnt - 1 - i, false);
         }
-        idx_pre_chunk += scores.size();
+        idx_pre_chunk += scores->size();
         return 0;
     }
 
@@ -0,0 +1,128 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+#include "precomp.h"
+
+namespace funasr {
+
+FbankPlan::FbankPlan(const knf::FbankOptions &opts)
+:opts_(opts),
+ computer_(opts),
+ window_function_(opts.frame_opts){
+    dim_ = computer_.Dim();
+    // the fft fills its twiddle tables on the first call, do it here so
+    // that concurrent Compute() calls only read them
+    std::vector<float> window(opts_.frame_opts.PaddedWindowSize(), 0.0f);
+    std::vector<float> feat(dim_);
+    computer_.Compute(0.0f, 1.0f, &window, feat.data());
+}
+
+std::shared_ptr<FbankPlan> FbankPlan::Get(const knf::FbankOptions &opts)
+{
+    static std::mutex mtx;
+    static std::map<std::string, std::shared_ptr<FbankPlan>> plans;
+
+    // this kaldi-native-fbank build never applies dither, so plans that
+    // only differ in it give the same frames
+    knf::FbankOptions key_opts = opts;
+    key_opts.frame_opts.dither = 0;
+    std::string key = key_opts.ToString();
+    std::lock_guard<std::mutex> lock(mtx);
+    auto iter = plans.find(key);
+    if (iter != plans.end()) {
+        return iter->second;
+    }
+    std::shared_ptr<FbankPlan> plan = std::make_shared<FbankPlan>(key_opts);
+    plans[key] = plan;
+    return plan;
+}
+
+int FbankPlan::NumFrames(int len) const
+{
+    // same as knf::OnlineFbank before InputFinished()
+    return knf::NumFrames(len, opts_.frame_opts, false);
+}
+
+void FbankPlan::ComputeFrame(const std::vector<float> &buf, int frame, std::vector<float> &window, float* feat) const
+{
+    // the fft works in place, so the padded tail has to be cleared for every frame
+    std::fill(window.begin(), window.end(), 0);
+    float raw_log_energy = 0.0;
+    knf::ExtractWindow(0, buf, frame, opts_.frame_opts, window_function_, &window,
+                       computer_.NeedRawLogEnergy() ? &raw_log_energy : nullptr);
+    computer_.Compute(raw_log_energy, 1.0f, &window, feat);
+}
+
+void FbankPlan::Compute(const float* waves, int len, FeatMatrix &feats) const
+{
+    int frames = len > 0 ? NumFrames(len) : 0;
+    feats.Resize(frames, dim_);
+    if (frames == 0) {
+        return;
+    }
+    std::vector<float> buf(len);
+    for (int32_t i = 0; i != len; ++i) {
+        buf[i] = waves[i] * 32768;
+    }
+    std::vector<float> window;
+    for (int32_t i = 0; i != frames; ++i) {
+        ComputeFrame(buf, i, window, feats.Row(i));
+    }
+}
+
+void FbankPlan::Compute(const float* waves, int len, std::vector<std::vector<float>> &feats) const
+{
+    int frames = len > 0 ? NumFrames(len) : 0;
+    if (frames == 0) {
+        return;
+    }
+    std::vector<float> buf(len);
+    for (int32_t i = 0; i != len; ++i) {
+        buf[i] = waves[i] * 32768;
+    }
+    std::vector<float> window;
+    for (int32_t i = 0; i != frames; ++i) {
+        std::vector<float> feat(dim_);
+        ComputeFrame(buf, i, window, feat.data());
+        feats.emplace_back(std::move(feat));
+    }
+}
+
+void FbankFrameCache::Append(const std::vector<std::vector<float>> &feats)
+{
+    frames_.insert(frames_.end(), feats.begin(), feats.end());
+}
+
+bool FbankFrameCache::Slice(int start, int num, FeatMatrix &out) const
+{
+    if (num <= 0 || frames_.empty() || start < first_frame_ || start + num > EndFrame()) {
+        return false;
+    }
+    int dim = frames_.front().size();
+    out.Resize(num, dim);
+    for (int i = 0; i < num; i++) {
+        const std::vector<float> &frame = frames_[start - first_frame_ + i];
+        std::copy(frame.begin(), frame.end(), out.Row(i));
+    }
+    return true;
+}
+
+void FbankFrameCache::Skip(int num)
+{
+    first_frame_ = EndFrame() + num;
+    frames_.clear();
+}
+
+void FbankFrameCache::Trim(int first_frame)
+{
+    int drop = std::min(first_frame - first_frame_, (int)frames_.size());
+    if (drop <= 0) {
+        return;
+    }
+    frames_.erase(frames_.begin(), frames_.begin() + drop);
+    first_frame_ += drop;
+}
+
+} // namespace funasr
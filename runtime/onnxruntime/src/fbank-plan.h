@@ -0,0 +1,71 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "kaldi-native-fbank/csrc/feature-fbank.h"
+#include "kaldi-native-fbank/csrc/feature-window.h"
+#include "feat-matrix.h"
+
+namespace funasr {
+
+    class FbankPlan {
+    /**
+     * Immutable fbank setup (mel banks, window function, fft tables) for one
+     * set of FbankOptions. It is built once and shared by every model, stream
+     * and thread using the same options; a call only allocates its own window
+     * scratch. Gives the same frames as a fresh knf::OnlineFbank fed the whole
+     * waveform at once.
+    */
+    public:
+        explicit FbankPlan(const knf::FbankOptions &opts);
+
+        // shared plan for opts, created on first use
+        static std::shared_ptr<FbankPlan> Get(const knf::FbankOptions &opts);
+
+        int Dim() const {return dim_;};
+        int NumFrames(int len) const;
+        // waves are float pcm in [-1, 1], scaled to int16 range like kaldi
+        void Compute(const float* waves, int len, FeatMatrix &feats) const;
+        void Compute(const float* waves, int len, std::vector<std::vector<float>> &feats) const;
+
+    private:
+        void ComputeFrame(const std::vector<float> &buf, int frame, std::vector<float> &window, float* feat) const;
+
+        knf::FbankOptions opts_;
+        // only read after construction: the mel banks for vtln 1.0 and the fft
+        // tables are set up in the constructor
+        mutable knf::FbankComputer computer_;
+        knf::FeatureWindowFunction window_function_;
+        int dim_ = 0;
+    };
+
+    class FbankFrameCache {
+    /**
+     * Fbank frames of one stream, indexed from the first frame of the stream.
+     * The 2pass VAD frontend fills it, so the offline pass can slice the
+     * frames of a segment instead of computing them again.
+    */
+    public:
+        void Reset() {frames_.clear(); first_frame_ = 0;};
+        void Append(const std::vector<std::vector<float>> &feats);
+        // index of the next frame to be appended
+        int EndFrame() const {return first_frame_ + (int)frames_.size();};
+        // copies frames [start, start+num) to out, false if some are dropped or not computed yet
+        bool Slice(int start, int num, FeatMatrix &out) const;
+        // drops the frames before first_frame
+        void Trim(int first_frame);
+        // num frames that were not computed follow, the frames before them are dropped too
+        void Skip(int num);
+
+    private:
+        std::deque<std::vector<float>> frames_;
+        int first_frame_ = 0;
+    };
+
+} // namespace funasr
@@ -0,0 +1,216 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+#include "precomp.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FUNASR_CMVN_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define FUNASR_CMVN_NEON
+#include <arm_neon.h>
+#endif
+
+namespace funasr {
+
+namespace {
+
+// dst = (src + mean) * var. Add and multiply stay separate in every path
+// (no fma), so all of them are bit-exact with the scalar loop.
+typedef void (*CmvnCopyFn)(const float* src, const float* mean, const float* var, float* dst, int n);
+
+void CmvnCopyScalar(const float* src, const float* mean, const float* var, float* dst, int n)
+{
+    for (int k = 0; k < n; k++) {
+        dst[k] = (src[k] + mean[k]) * var[k];
+    }
+}
+
+#if defined(FUNASR_CMVN_X86)
+__attribute__((target("avx2")))
+void CmvnCopyAvx2(const float* src, const float* mean, const float* var, float* dst, int n)
+{
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(src + k), _mm256_loadu_ps(mean + k));
+        _mm256_storeu_ps(dst + k, _mm256_mul_ps(x, _mm256_loadu_ps(var + k)));
+    }
+    CmvnCopyScalar(src + k, mean + k, var + k, dst + k, n - k);
+}
+
+__attribute__((target("avx512f")))
+void CmvnCopyAvx512(const float* src, const float* mean, const float* var, float* dst, int n)
+{
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m512 x = _mm512_add_ps(_mm512_loadu_ps(src + k), _mm512_loadu_ps(mean + k));
+        _mm512_storeu_ps(dst + k, _mm512_mul_ps(x, _mm512_loadu_ps(var + k)));
+    }
+    CmvnCopyScalar(src + k, mean + k, var + k, dst + k, n - k);
+}
+#elif defined(FUNASR_CMVN_NEON)
+void CmvnCopyNeon(const float* src, const float* mean, const float* var, float* dst, int n)
+{
+    int k = 0;
+    for (; k + 4 <= n; k += 4) {
+        float32x4_t x = vaddq_f32(vld1q_f32(src + k), vld1q_f32(mean + k));
+        vst1q_f32(dst + k, vmulq_f32(x, vld1q_f32(var + k)));
+    }
+    CmvnCopyScalar(src + k, mean + k, var + k, dst + k, n - k);
+}
+#endif
+
+CmvnCopyFn CmvnCopyOf(CmvnKernel kernel)
+{
+    switch (kernel) {
+#if defined(FUNASR_CMVN_X86)
+    case CMVN_KERNEL_AVX2:
+        return CmvnCopyAvx2;
+    case CMVN_KERNEL_AVX512:
+        return CmvnCopyAvx512;
+#elif defined(FUNASR_CMVN_NEON)
+    case CMVN_KERNEL_NEON:
+        return CmvnCopyNeon;
+#endif
+    default:
+        return CmvnCopyScalar;
+    }
+}
+
+CmvnKernel SelectCmvnKernel()
+{
+    CmvnKernel kernel = CMVN_KERNEL_SCALAR;
+    for (CmvnKernel k : {CMVN_KERNEL_AVX512, CMVN_KERNEL_AVX2, CMVN_KERNEL_NEON}) {
+        if (CmvnKernelSupported(k)) {
+            kernel = k;
+            break;
+        }
+    }
+    LOG(INFO) << "lfr/cmvn kernel: " << CmvnKernelName(kernel);
+    return kernel;
+}
+
+CmvnCopyFn GetCmvnCopy(CmvnKernel kernel)
+{
+    if (kernel == CMVN_KERNEL_AUTO) {
+        static const CmvnCopyFn cmvn_copy = CmvnCopyOf(SelectCmvnKernel());
+        return cmvn_copy;
+    }
+    return CmvnCopyOf(kernel);
+}
+
+} // namespace
+
+bool CmvnKernelSupported(CmvnKernel kernel)
+{
+    switch (kernel) {
+    case CMVN_KERNEL_AUTO:
+    case CMVN_KERNEL_SCALAR:
+        return true;
+#if defined(FUNASR_CMVN_X86)
+    case CMVN_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case CMVN_KERNEL_AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#elif defined(FUNASR_CMVN_NEON)
+    case CMVN_KERNEL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* CmvnKernelName(CmvnKernel kernel)
+{
+    switch (kernel) {
+    case CMVN_KERNEL_AUTO:
+        return "auto";
+    case CMVN_KERNEL_SCALAR:
+        return "scalar";
+    case CMVN_KERNEL_AVX2:
+        return "avx2";
+    case CMVN_KERNEL_AVX512:
+        return "avx512";
+    case CMVN_KERNEL_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+void StackCmvnRow(const float* const* rows, int lfr_m, int in_dim,
+                  const std::vector<float> &means, const std::vector<float> &vars, float* out,
+                  CmvnKernel kernel)
+{
+    CmvnCopyFn cmvn_copy = GetCmvnCopy(kernel);
+    int cmvn_dim = std::min(means.size(), vars.size());
+    for (int j = 0; j < lfr_m; j++) {
+        int offset = j * in_dim;
+        int n_cmvn = std::min(std::max(cmvn_dim - offset, 0), in_dim);
+        if (n_cmvn > 0) {
+            cmvn_copy(rows[j], means.data() + offset, vars.data() + offset, out + offset, n_cmvn);
+        }
+        if (n_cmvn < in_dim) {
+            std::memcpy(out + offset + n_cmvn, rows[j] + n_cmvn, (in_dim - n_cmvn) * sizeof(float));
+        }
+    }
+}
+
+void ApplyLfrCmvn(const FeatMatrix &feats, int lfr_m, int lfr_n,
+                  const std::vector<float> &means, const std::vector<float> &vars, float* out,
+                  CmvnKernel kernel)
+{
+    int T = feats.NumRows();
+    int in_dim = feats.NumCols();
+    int out_dim = lfr_m * in_dim;
+    int T_lfr = LfrFrameNum(T, lfr_n);
+    int left_padding = (lfr_m - 1) / 2;
+
+    std::vector<const float*> rows(lfr_m);
+    for (int i = 0; i < T_lfr; i++) {
+        // frames before the start repeat the first frame, frames past the end repeat the last one
+        for (int j = 0; j < lfr_m; j++) {
+            int idx = std::min(std::max(i * lfr_n + j - left_padding, 0), T - 1);
+            rows[j] = feats.Row(idx);
+        }
+        StackCmvnRow(rows.data(), lfr_m, in_dim, means, vars, out + (size_t)i * out_dim, kernel);
+    }
+}
+
+int OnlineLfrCmvn(std::vector<std::vector<float>> &feats, int lfr_m, int lfr_n,
+                  const std::vector<float> &means, const std::vector<float> &vars,
+                  bool input_finished, std::vector<std::vector<float>> &splice_cache,
+                  CmvnKernel kernel)
+{
+    std::vector<std::vector<float>> out_feats;
+    int T = feats.size();
+    int T_lrf = ceil((T - (lfr_m - 1) / 2) / (float)lfr_n);
+    int lfr_splice_frame_idxs = T_lrf;
+    int in_dim = T > 0 ? feats[0].size() : 0;
+    std::vector<const float*> rows(lfr_m);
+    for (int i = 0; i < T_lrf; i++) {
+        if (lfr_m > T - i * lfr_n && !input_finished) {
+            lfr_splice_frame_idxs = i;
+            break;
+        }
+        // Fill to lfr_m frames at last window if less than lfr_m frames (copy last frame)
+        for (int j = 0; j < lfr_m; j++) {
+            rows[j] = feats[std::min(i * lfr_n + j, T - 1)].data();
+        }
+        std::vector<float> p(lfr_m * in_dim);
+        StackCmvnRow(rows.data(), lfr_m, in_dim, means, vars, p.data(), kernel);
+        out_feats.emplace_back(std::move(p));
+    }
+    lfr_splice_frame_idxs = std::min(T - 1, lfr_splice_frame_idxs * lfr_n);
+    splice_cache.assign(feats.begin() + lfr_splice_frame_idxs, feats.end());
+
+    feats.swap(out_feats);
+    return lfr_splice_frame_idxs;
+}
+
+} // namespace funasr
@@ -0,0 +1,85 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include <vector>
+
+namespace funasr {
+
+    class FeatMatrix {
+    /**
+     * Row-major [num_rows, num_cols] feature buffer. One allocation holds a
+     * whole segment, so rows can be handed to ONNX Runtime without flattening.
+    */
+    public:
+        FeatMatrix(){};
+        FeatMatrix(int num_rows, int num_cols) {Resize(num_rows, num_cols);};
+
+        void Resize(int num_rows, int num_cols) {
+            num_rows_ = num_rows;
+            num_cols_ = num_cols;
+            data_.resize((size_t)num_rows * num_cols);
+        };
+        void Clear() {num_rows_ = 0; data_.clear();};
+        void AppendRow(const float* row) {
+            data_.insert(data_.end(), row, row + num_cols_);
+            num_rows_++;
+        };
+
+        int NumRows() const {return num_rows_;};
+        int NumCols() const {return num_cols_;};
+        bool Empty() const {return num_rows_ == 0;};
+        size_t Size() const {return data_.size();};
+        float* Data() {return data_.data();};
+        const float* Data() const {return data_.data();};
+        float* Row(int r) {return data_.data() + (size_t)r * num_cols_;};
+        const float* Row(int r) const {return data_.data() + (size_t)r * num_cols_;};
+
+    private:
+        int num_rows_ = 0;
+        int num_cols_ = 0;
+        std::vector<float> data_;
+    };
+
+    // number of frames left after low frame rate stacking with stride lfr_n
+    inline int LfrFrameNum(int num_frames, int lfr_n) {
+        return (num_frames + lfr_n - 1) / lfr_n;
+    }
+
+    // cmvn kernels; AUTO is the fastest one the cpu supports, the others are
+    // for funasr-onnx-lfr-check and funasr-onnx-lfr-bench
+    enum CmvnKernel {
+        CMVN_KERNEL_AUTO = 0,
+        CMVN_KERNEL_SCALAR,
+        CMVN_KERNEL_AVX2,
+        CMVN_KERNEL_AVX512,
+        CMVN_KERNEL_NEON,
+    };
+    bool CmvnKernelSupported(CmvnKernel kernel);
+    const char* CmvnKernelName(CmvnKernel kernel);
+
+    // Writes the lfr_m rows side by side into one lfr_m*in_dim row of out and
+    // applies cmvn in the same pass. Uses AVX-512/AVX2/NEON when available.
+    void StackCmvnRow(const float* const* rows, int lfr_m, int in_dim,
+                      const std::vector<float> &means, const std::vector<float> &vars, float* out,
+                      CmvnKernel kernel = CMVN_KERNEL_AUTO);
+
+    // Stacks lfr_m fbank frames every lfr_n frames, padding with copies of the
+    // first/last frame, then applies cmvn. Writes LfrFrameNum() rows of
+    // lfr_m*feats.NumCols() floats to out, which may be an ONNX input tensor.
+    void ApplyLfrCmvn(const FeatMatrix &feats, int lfr_m, int lfr_n,
+                      const std::vector<float> &means, const std::vector<float> &vars, float* out,
+                      CmvnKernel kernel = CMVN_KERNEL_AUTO);
+
+    // Lfr and cmvn of the frames of a streaming chunk, padding the last window
+    // with copies of the last frame. Unless input_finished it stops at the first
+    // window that runs past the chunk, and the frames from there on are kept in
+    // splice_cache for the next chunk. Returns the index of that first frame.
+    int OnlineLfrCmvn(std::vector<std::vector<float>> &feats, int lfr_m, int lfr_n,
+                      const std::vector<float> &means, const std::vector<float> &vars,
+                      bool input_finished, std::vector<std::vector<float>> &splice_cache,
+                      CmvnKernel kernel = CMVN_KERNEL_AUTO);
+
+} // namespace funasr
@@ -9,7 +9,6 @@
 namespace funasr {
 
 void FsmnVadOnline::FbankKaldi(float sample_rate, std::vector<std::vector<float>> &vad_feats, std::vector<float> &waves) {
-    knf::OnlineFbank fbank(fbank_opts_);
     // cache merge
     waves.insert(waves.begin(), input_cache_.begin(), input_cache_.end());
     int frame_number = ComputeFrameNum(waves.size(), frame_sample_length_, frame_shift_sample_length_);
@@ -22,17 +21,35 @@ void FsmnVadOnline::FbankKaldi(float sample_rate, std::vector<std::vector<float>
     // Delete audio that haven't undergone fbank processing
     waves.erase(waves.begin() + (frame_number - 1) * frame_shift_sample_length_ + frame_sample_length_, waves.end());
 
-    std::vector<float> buf(waves.size());
-    for (int32_t i = 0; i != waves.size(); ++i) {
-        buf[i] = waves[i] * 32768;
+    if (gated_) {
+        // the frames are not used, only the lfr bookkeeping needs them
+        vad_feats.assign(frame_number, fsmnvad_handle_->SilenceFbank());
+        if (use_fbank_cache_) {
+            fbank_cache_.Skip(frame_number);
+        }
+        return;
     }
-    fbank.AcceptWaveform(sample_rate, buf.data(), buf.size());
-    // fbank.AcceptWaveform(sample_rate, &waves[0], waves.size());
-    int32_t frames = fbank.NumFramesReady();
-    for (int32_t i = 0; i != frames; ++i) {
-        const float *frame = fbank.GetFrame(i);
-        vector<float> frame_vector(frame, frame + fbank_opts_.mel_opts.num_bins);
-        vad_feats.emplace_back(frame_vector);
+    fbank_plan_->Compute(waves.data(), waves.size(), vad_feats);
+    if (use_fbank_cache_) {
+        fbank_cache_.Append(vad_feats);
+    }
+}
+
+void FsmnVadOnline::EnableFbankCache(const FbankPlan* asr_plan) {
+    use_fbank_cache_ = (asr_plan != nullptr && asr_plan == fbank_plan_.get());
+    fbank_cache_.Reset();
+}
+
+bool FsmnVadOnline::GetFbankFrames(int start_sample, int len, FeatMatrix &feats) {
+    if (!use_fbank_cache_ || len <= 0 || start_sample % frame_shift_sample_length_ != 0) {
+        return false;
+    }
+    return fbank_cache_.Slice(start_sample / frame_shift_sample_length_, fbank_plan_->NumFrames(len), feats);
+}
+
+void FsmnVadOnline::TrimFbankCache(int start_sample) {
+    if (use_fbank_cache_) {
+        fbank_cache_.Trim(start_sample / frame_shift_sample_length_);
     }
 }
 
@@ -87,47 +104,78 @@ void FsmnVadOnline::ExtractFeats(float sample_rate, vector<std::vector<float>> &
 }
 
 int FsmnVadOnline::OnlineLfrCmvn(vector<vector<float>> &vad_feats, bool input_finished) {
-    vector<vector<float>> out_feats;
-    int T = vad_feats.size();
-    int T_lrf = ceil((T - (lfr_m - 1) / 2) / (float)lfr_n);
-    int lfr_splice_frame_idxs = T_lrf;
-    vector<float> p;
-    for (int i = 0; i < T_lrf; i++) {
-        if (lfr_m <= T - i * lfr_n) {
-            for (int j = 0; j < lfr_m; j++) {
-                p.insert(p.end(), vad_feats[i * lfr_n + j].begin(), vad_feats[i * lfr_n + j].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        } else {
-            if (input_finished) {
-                int num_padding = lfr_m - (T - i * lfr_n);
-                for (int j = 0; j < (vad_feats.size() - i * lfr_n); j++) {
-                    p.insert(p.end(), vad_feats[i * lfr_n + j].begin(), vad_feats[i * lfr_n + j].end());
-                }
-                for (int j = 0; j < num_padding; j++) {
-                    p.insert(p.end(), vad_feats[vad_feats.size() - 1].begin(), vad_feats[vad_feats.size() - 1].end());
-                }
-                out_feats.emplace_back(p);
-                p.clear();
-            } else {
-                lfr_splice_frame_idxs = i;
-                break;
-            }
+    return funasr::OnlineLfrCmvn(vad_feats, lfr_m, lfr_n, means_list_, vars_list_, input_finished, lfr_splice_cache_);
+}
+
+bool FsmnVadOnline::BelowEnergyGate(const std::vector<float> &waves) {
+    /**
+     * Every frame whose probs this chunk gives lies in the reserved, cached
+     * and new samples, which follow each other in the stream. A chunk is
+     * gated when all of those frames are below the floor, with the same
+     * decibels as E2EVadModel, and no segment is open, so the frames of
+     * speech are always scored by the model.
+    */
+    if (!fsmnvad_handle_->UseEnergyGate() || vad_scorer.InSpeech()) {
+        return false;
+    }
+    int reserve_len = reserve_waveforms_.size();
+    int cache_len = input_cache_.size();
+    int total = reserve_len + cache_len + waves.size();
+    auto sample = [&](int i) {
+        if (i < reserve_len) {
+            return reserve_waveforms_[i];
+        }
+        if (i < reserve_len + cache_len) {
+            return input_cache_[i - reserve_len];
+        }
+        return waves[i - reserve_len - cache_len];
+    };
+    int frame_number = ComputeFrameNum(total, frame_sample_length_, frame_shift_sample_length_);
+    if (frame_number == 0) {
+        return false;
+    }
+    float floor = fsmnvad_handle_->GetGateDecibel();
+    for (int f = 0; f < frame_number; f++) {
+        float sum = 0.0;
+        int offset = f * frame_shift_sample_length_;
+        for (int i = 0; i < frame_sample_length_; i++) {
+            float x = sample(offset + i);
+            sum += x * x;
+        }
+        if (10 * log10(sum + 0.000001) >= floor) {
+            return false;
         }
     }
-    lfr_splice_frame_idxs = std::min(T - 1, lfr_splice_frame_idxs * lfr_n);
-    lfr_splice_cache_.clear();
-    lfr_splice_cache_.insert(lfr_splice_cache_.begin(), vad_feats.begin() + lfr_splice_frame_idxs, vad_feats.end());
+    return true;
+}
 
-    // Apply cmvn
-    for (auto &out_feat: out_feats) {
-        for (int j = 0; j < means_list_.size(); j++) {
-            out_feat[j] = (out_feat[j] + means_list_[j]) * vars_list_[j];
+void FsmnVadOnline::ForwardPooled(const std::vector<std::vector<float>> &vad_feats, bool input_finished,
+                                  std::vector<std::vector<float>> &vad_probs) {
+    std::vector<std::vector<float>> cache(VadCachePool::kLayers);
+    for (int l = 0; l < VadCachePool::kLayers; l++) {
+        float* layer = pooled_cache_ + l * VadCachePool::kLayerSize;
+        cache[l].assign(layer, layer + VadCachePool::kLayerSize);
+    }
+    vad_probs.clear();
+    fsmnvad_handle_->Forward(vad_feats, &vad_probs, &cache, input_finished);
+    if (!input_finished && !vad_probs.empty()) {
+        for (int l = 0; l < VadCachePool::kLayers; l++) {
+            memcpy(pooled_cache_ + l * VadCachePool::kLayerSize, cache[l].data(),
+                   sizeof(float) * VadCachePool::kLayerSize);
         }
     }
-    vad_feats = out_feats;
-    return lfr_splice_frame_idxs;
+}
+
+void FsmnVadOnline::SetSilenceCache() {
+    const std::vector<std::vector<float>> &silence_cache = fsmnvad_handle_->SilenceCache();
+    if (scheduler_) {
+        for (int l = 0; l < VadCachePool::kLayers; l++) {
+            memcpy(pooled_cache_ + l * VadCachePool::kLayerSize, silence_cache[l].data(),
+                   sizeof(float) * VadCachePool::kLayerSize);
+        }
+    } else {
+        in_cache_ = silence_cache;
+    }
 }
 
 std::vector<std::vector<int>>
@@ -135,11 +183,23 @@ FsmnVadOnline::Infer(std::vector<float> &waves, bool input_finished) {
     std::vector<std::vector<int>> vad_segments;
     std::vector<std::vector<float>> vad_feats;
     std::vector<std::vector<float>> vad_probs;
+    gated_ = !input_finished && BelowEnergyGate(waves);
     ExtractFeats(vad_sample_rate_, vad_feats, waves, input_finished);
     if(vad_feats.size() == 0){
       return vad_segments;
     }
-    fsmnvad_handle_->Forward(vad_feats, &vad_probs, &in_cache_, input_finished);
+    if (gated_) {
+        // scored as the model scores silence, and left in the state it is in after silence
+        vad_probs.assign(vad_feats.size(), fsmnvad_handle_->SilenceProbs());
+        SetSilenceCache();
+    } else if (scheduler_) {
+        if (!scheduler_->Forward(vad_feats, pooled_cache_, input_finished, vad_probs)) {
+            // the batch failed as a whole, this chunk is run on its own
+            ForwardPooled(vad_feats, input_finished, vad_probs);
+        }
+    } else {
+        fsmnvad_handle_->Forward(vad_feats, &vad_probs, &in_cache_, input_finished);
+    }
     if(vad_probs.size() == 0){
       return vad_segments;
     }
@@ -150,6 +210,10 @@ FsmnVadOnline::Infer(std::vector<float> &waves, bool input_finished) {
 }
 
 void FsmnVadOnline::InitCache(){
+  if (scheduler_) {
+    memset(pooled_cache_, 0, sizeof(float) * VadCachePool::kSlotSize);
+    return;
+  }
   std::vector<float> cache_feats(128 * 19 * 1, 0);
   for (int i=0;i<4;i++){
     in_cache_.emplace_back(cache_feats);
@@ -165,7 +229,6 @@ void FsmnVadOnline::Test() {
 }
 
 void FsmnVadOnline::InitOnline(std::shared_ptr<Ort::Session> &vad_session,
-                               Ort::Env &env,
                                std::vector<const char *> &vad_in_names,
                                std::vector<const char *> &vad_out_names,
                                knf::FbankOptions &fbank_opts,
@@ -179,6 +242,7 @@ void FsmnVadOnline::InitOnline(std::shared_ptr<Ort::Session> &vad_session,
     vad_in_names_ = vad_in_names;
     vad_out_names_ = vad_out_names;
     fbank_opts_ = fbank_opts;
+    fbank_plan_ = FbankPlan::Get(fbank_opts_);
     means_list_ = means_list;
     vars_list_ = vars_list;
     vad_sample_rate_ = vad_sample_rate;
@@ -194,12 +258,18 @@ void FsmnVadOnline::InitOnline(std::shared_ptr<Ort::Session> &vad_session,
 }
 
 FsmnVadOnline::~FsmnVadOnline() {
+    if (scheduler_) {
+        scheduler_->GetCachePool().Release(pooled_cache_);
+    }
 }
 
 FsmnVadOnline::FsmnVadOnline(FsmnVad* fsmnvad_handle):fsmnvad_handle_(std::move(fsmnvad_handle)),session_options_{}{
+   if (fsmnvad_handle_->online_scheduler_) {
+       scheduler_ = fsmnvad_handle_->online_scheduler_.get();
+       pooled_cache_ = scheduler_->GetCachePool().Acquire();
+   }
    InitCache();
    InitOnline(fsmnvad_handle_->vad_session_,
-              fsmnvad_handle_->env_,
               fsmnvad_handle_->vad_in_names_,
               fsmnvad_handle_->vad_out_names_,
               fsmnvad_handle_->fbank_opts_,
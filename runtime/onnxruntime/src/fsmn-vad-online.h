@@ -25,6 +25,15 @@ public:
 
     // 2pass
     std::unique_ptr<Audio> audio_handle = nullptr;
+    // keeps the fbank frames of the stream for GetFbankFrames(), only
+    // worth it when the asr frontend uses the same plan
+    void EnableFbankCache(const FbankPlan* asr_plan);
+    // fbank frames of the samples [start_sample, start_sample+len) of the
+    // stream, false if they are not all in the cache
+    bool GetFbankFrames(int start_sample, int len, FeatMatrix &feats);
+    // frames before start_sample will not be asked for again
+    void TrimFbankCache(int start_sample);
+    void ResetFbankCache() { fbank_cache_.Reset(); };
 
 private:
     E2EVadModel vad_scorer = E2EVadModel();
@@ -34,10 +43,14 @@ private:
     void FbankKaldi(float sample_rate, std::vector<std::vector<float>> &vad_feats,
                     std::vector<float> &waves);
     int OnlineLfrCmvn(vector<vector<float>> &vad_feats, bool input_finished);
+    bool BelowEnergyGate(const std::vector<float> &waves);
+    void SetSilenceCache();
+    // the chunk through FsmnVad::Forward with the pooled cache, when its batch failed
+    void ForwardPooled(const std::vector<std::vector<float>> &vad_feats, bool input_finished,
+                       std::vector<std::vector<float>> &vad_probs);
     void InitVad(const std::string &vad_model, const std::string &vad_cmvn, const std::string &vad_config, int thread_num){}
     void InitCache();
     void InitOnline(std::shared_ptr<Ort::Session> &vad_session,
-                    Ort::Env &env,
                     std::vector<const char *> &vad_in_names,
                     std::vector<const char *> &vad_out_names,
                     knf::FbankOptions &fbank_opts,
@@ -63,15 +76,22 @@ private:
 
     // from fsmnvad_handle_
     std::shared_ptr<Ort::Session> vad_session_ = nullptr;
-    Ort::Env env_;
     Ort::SessionOptions session_options_;
     std::vector<const char *> vad_in_names_;
     std::vector<const char *> vad_out_names_;
     knf::FbankOptions fbank_opts_;
+    std::shared_ptr<FbankPlan> fbank_plan_ = nullptr;
+    bool use_fbank_cache_ = false;
+    FbankFrameCache fbank_cache_;
     std::vector<float> means_list_;
     std::vector<float> vars_list_;
 
     std::vector<std::vector<float>> in_cache_;
+    // the fsmn caches in a slot of the scheduler's pool when chunks are batched
+    FsmnVadScheduler* scheduler_ = nullptr;
+    float* pooled_cache_ = nullptr;
+    // the chunk being extracted is below the energy gate
+    bool gated_ = false;
     // The reserved waveforms by fbank
     std::vector<float> reserve_waveforms_;
     // waveforms reserved after last shift position
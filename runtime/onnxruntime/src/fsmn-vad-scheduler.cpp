@@ -0,0 +1,137 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+#include "precomp.h"
+
+namespace funasr {
+
+float* VadCachePool::Acquire()
+{
+    float* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (free_slots_.empty()) {
+            blocks_.emplace_back(new float[(size_t)kSlotsPerBlock * kSlotSize]);
+            float* block = blocks_.back().get();
+            for (int i = kSlotsPerBlock - 1; i >= 0; i--) {
+                free_slots_.push_back(block + (size_t)i * kSlotSize);
+            }
+        }
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    memset(slot, 0, sizeof(float) * kSlotSize);
+    return slot;
+}
+
+void VadCachePool::Release(float* slot)
+{
+    if (slot == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    free_slots_.push_back(slot);
+}
+
+FsmnVadScheduler::FsmnVadScheduler(std::shared_ptr<Ort::Session> vad_session,
+                                   const std::vector<const char*> &vad_in_names,
+                                   const std::vector<const char*> &vad_out_names,
+                                   int max_batch, int max_wait_ms)
+:vad_session_(vad_session),
+ vad_in_names_(vad_in_names),
+ vad_out_names_(vad_out_names),
+ queue_(max_batch, max_wait_ms){
+    LOG(INFO) << "online vad batching enabled, max batch: " << queue_.GetMaxBatch() << ", max wait: " << queue_.GetMaxWaitMs() << " ms";
+}
+
+void FsmnVadScheduler::RunForward(std::vector<ForwardTask*> &batch)
+{
+    try{
+        int batch_in = batch.size();
+        int num_frames = batch[0]->feats->size();
+        int feat_dim = (*(batch[0]->feats))[0].size();
+        Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+
+        std::vector<float> vad_feats((size_t)batch_in * num_frames * feat_dim);
+        float* feat_ptr = vad_feats.data();
+        for (auto task : batch) {
+            for (const auto &row : *(task->feats)) {
+                memcpy(feat_ptr, row.data(), sizeof(float) * feat_dim);
+                feat_ptr += feat_dim;
+            }
+        }
+        std::vector<Ort::Value> vad_inputs;
+        const int64_t vad_feats_shape[3] = {batch_in, num_frames, feat_dim};
+        vad_inputs.emplace_back(Ort::Value::CreateTensor<float>(
+            memory_info, vad_feats.data(), vad_feats.size(), vad_feats_shape, 3));
+
+        // cache node {batch,128,19,1} per layer, gathered from the slots
+        const int layer_size = VadCachePool::kLayerSize;
+        std::vector<float> cache_input((size_t)VadCachePool::kLayers * batch_in * layer_size);
+        const int64_t cache_shape[4] = {batch_in, 128, 19, 1};
+        for (int l = 0; l < VadCachePool::kLayers; l++) {
+            float* layer_ptr = cache_input.data() + (size_t)l * batch_in * layer_size;
+            for (int index = 0; index < batch_in; index++) {
+                memcpy(layer_ptr + (size_t)index * layer_size, batch[index]->cache + l * layer_size,
+                       sizeof(float) * layer_size);
+            }
+            vad_inputs.emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info, layer_ptr, (size_t)batch_in * layer_size, cache_shape, 4));
+        }
+
+        auto vad_ort_outputs = RunSession(*vad_session_, vad_in_names_.data(), vad_inputs.data(), vad_inputs.size(),
+                                          vad_out_names_.data(), vad_out_names_.size());
+
+        std::vector<int64_t> prob_shape = vad_ort_outputs[0].GetTensorTypeAndShapeInfo().GetShape();
+        float* logp_data = vad_ort_outputs[0].GetTensorMutableData<float>();
+        int num_outputs = prob_shape[1];
+        int output_dim = prob_shape[2];
+        for (int index = 0; index < batch_in; index++) {
+            std::vector<std::vector<float>> &probs = batch[index]->probs;
+            probs.resize(num_outputs);
+            for (int i = 0; i < num_outputs; i++) {
+                float* row = logp_data + ((size_t)index * num_outputs + i) * output_dim;
+                probs[i].assign(row, row + output_dim);
+            }
+        }
+        // a final chunk's caches are never used again
+        for (int l = 0; l < VadCachePool::kLayers; l++) {
+            float* cache_data = vad_ort_outputs[l + 1].GetTensorMutableData<float>();
+            for (int index = 0; index < batch_in; index++) {
+                if (!batch[index]->is_final) {
+                    memcpy(batch[index]->cache + l * layer_size, cache_data + (size_t)index * layer_size,
+                           sizeof(float) * layer_size);
+                }
+            }
+        }
+        for (auto task : batch) {
+            task->ok = true;
+        }
+    }catch (std::exception const &e)
+    {
+        LOG(ERROR) << "Error when run vad onnx forword: " << e.what();
+    }
+}
+
+bool FsmnVadScheduler::Forward(const std::vector<std::vector<float>> &feats, float* cache, bool is_final,
+                               std::vector<std::vector<float>> &probs)
+{
+    ForwardTask task;
+    task.feats = &feats;
+    task.cache = cache;
+    task.is_final = is_final;
+    queue_.Submit(task,
+        [](const std::vector<ForwardTask*> &batch, const ForwardTask &item){
+            return item.feats->size() == batch[0]->feats->size()
+                && (*(item.feats))[0].size() == (*(batch[0]->feats))[0].size();
+        },
+        [this](std::vector<ForwardTask*> &batch){ RunForward(batch); });
+    if (task.ok) {
+        probs.swap(task.probs);
+    }
+    return task.ok;
+}
+
+} // namespace funasr
@@ -0,0 +1,82 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "batch-queue.h"
+
+namespace funasr {
+
+    class VadCachePool {
+    /**
+     * FSMN caches of the online VAD streams. The 4 layer caches of a stream
+     * sit back to back in one slot, and slots are carved from large blocks,
+     * so gathering a batch is one memcpy per layer and stream with no
+     * allocation. Slots are recycled when a stream ends.
+    */
+    public:
+        static const int kLayers = 4;
+        static const int kLayerSize = 128 * 19;
+        static const int kSlotSize = kLayers * kLayerSize;
+
+        // a zeroed slot of kSlotSize floats
+        float* Acquire();
+        void Release(float* slot);
+
+    private:
+        static const int kSlotsPerBlock = 64;
+
+        std::mutex mtx_;
+        std::vector<std::unique_ptr<float[]>> blocks_;
+        std::vector<float*> free_slots_;
+    };
+
+    class FsmnVadScheduler {
+    /**
+     * Cross-stream batching of online FSMN-VAD chunks.
+     * Every FsmnVadOnline stream sharing one FsmnVad submits its chunk here;
+     * chunks of concurrent streams are stacked along the batch axis, run by
+     * one model call, and the probs and caches are scattered back. The model
+     * is causal and its caches are taken from the last frames of the input,
+     * so padding would corrupt the caches of shorter chunks: only chunks with
+     * the same number of frames are grouped. Only used with a model exported
+     * with a dynamic batch axis, see FsmnVad::InitOnlineScheduler.
+    */
+    public:
+        FsmnVadScheduler(std::shared_ptr<Ort::Session> vad_session,
+                         const std::vector<const char*> &vad_in_names,
+                         const std::vector<const char*> &vad_out_names,
+                         int max_batch, int max_wait_ms);
+        ~FsmnVadScheduler(){};
+
+        // feats: num_frames rows of lfr feats; cache: a slot of cache_pool_, updated in place unless is_final.
+        // false when the batch failed, probs and cache are then untouched
+        bool Forward(const std::vector<std::vector<float>> &feats, float* cache, bool is_final,
+                     std::vector<std::vector<float>> &probs);
+
+        VadCachePool &GetCachePool() {return cache_pool_;};
+        FUNASR_BATCH_STATS GetStats() {return queue_.GetStats();};
+
+    private:
+        struct ForwardTask {
+            const std::vector<std::vector<float>>* feats = nullptr;
+            float* cache = nullptr;
+            bool is_final = false;
+            std::vector<std::vector<float>> probs;
+            bool ok = false;
+        };
+        void RunForward(std::vector<ForwardTask*> &batch);
+
+        std::shared_ptr<Ort::Session> vad_session_ = nullptr;
+        std::vector<const char*> vad_in_names_;
+        std::vector<const char*> vad_out_names_;
+
+        VadCachePool cache_pool_;
+        BatchQueue<ForwardTask> queue_;
+    };
+
+} // namespace funasr
@@ -4,11 +4,13 @@
 */
 
 #include <fstream>
+#include <condition_variable>
+#include <thread>
 #include "precomp.h"
 
 namespace funasr {
 void FsmnVad::InitVad(const std::string &vad_model, const std::string &vad_cmvn, const std::string &vad_config, int thread_num) {
-    session_options_.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(session_options_, thread_num);
     session_options_.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     session_options_.DisableCpuMemArena();
 
@@ -45,6 +47,7 @@ void FsmnVad::LoadConfigFromYaml(const char* filename){
         fbank_opts_.frame_opts.frame_length_ms = frontend_conf["frame_length"].as<float>();
         fbank_opts_.energy_floor = 0;
         fbank_opts_.mel_opts.debug_mel = false;
+        fbank_plan_ = FbankPlan::Get(fbank_opts_);
     }catch(exception const &e){
         LOG(ERROR) << "Error when load argument from vad config YAML.";
         exit(-1);
@@ -54,7 +57,7 @@ void FsmnVad::LoadConfigFromYaml(const char* filename){
 void FsmnVad::ReadModel(const char* vad_model) {
     try {
         vad_session_ = std::make_shared<Ort::Session>(
-                env_, ORTCHAR(vad_model), session_options_);
+                ComputeScheduler::Instance().GetEnv(), ORTCHAR(vad_model), session_options_);
         LOG(INFO) << "Successfully load model from " << vad_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load vad onnx model: " << e.what();
@@ -69,21 +72,29 @@ void FsmnVad::Forward(
         std::vector<std::vector<float>> *out_prob,
         std::vector<std::vector<float>> *in_cache,
         bool is_final) {
+    FeatMatrix vad_feats(0, chunk_feats[0].size());
+    for (const auto &chunk_feat: chunk_feats) {
+        vad_feats.AppendRow(chunk_feat.data());
+    }
+    Forward(vad_feats, out_prob, in_cache, is_final);
+}
+
+void FsmnVad::Forward(
+        FeatMatrix &vad_feats,
+        std::vector<std::vector<float>> *out_prob,
+        std::vector<std::vector<float>> *in_cache,
+        bool is_final) {
     Ort::MemoryInfo memory_info =
             Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
 
-    int num_frames = chunk_feats.size();
-    const int feature_dim = chunk_feats[0].size();
+    int num_frames = vad_feats.NumRows();
+    const int feature_dim = vad_feats.NumCols();
 
     //  2. Generate input nodes tensor
     // vad node { batch,frame number,feature dim }
     const int64_t vad_feats_shape[3] = {1, num_frames, feature_dim};
-    std::vector<float> vad_feats;
-    for (const auto &chunk_feat: chunk_feats) {
-        vad_feats.insert(vad_feats.end(), chunk_feat.begin(), chunk_feat.end());
-    }
     Ort::Value vad_feats_ort = Ort::Value::CreateTensor<float>(
-            memory_info, vad_feats.data(), vad_feats.size(), vad_feats_shape, 3);
+            memory_info, vad_feats.Data(), vad_feats.Size(), vad_feats_shape, 3);
     
     // 3. Put nodes into onnx input vector
     std::vector<Ort::Value> vad_inputs;
@@ -99,7 +110,7 @@ void FsmnVad::Forward(
     // 4. Onnx infer
     std::vector<Ort::Value> vad_ort_outputs;
     try {
-        vad_ort_outputs = vad_session_->Run(Ort::RunOptions{nullptr}, 
+        vad_ort_outputs = RunSession(*vad_session_, 
             vad_in_names_.data(), vad_inputs.data(), vad_inputs.size(), 
             vad_out_names_.data(), vad_out_names_.size());
     } catch (std::exception const &e) {
@@ -128,21 +139,9 @@ void FsmnVad::Forward(
     }
 }
 
-void FsmnVad::FbankKaldi(float sample_rate, std::vector<std::vector<float>> &vad_feats,
+void FsmnVad::FbankKaldi(float sample_rate, FeatMatrix &vad_feats,
                          std::vector<float> &waves) {
-    knf::OnlineFbank fbank(fbank_opts_);
-
-    std::vector<float> buf(waves.size());
-    for (int32_t i = 0; i != waves.size(); ++i) {
-        buf[i] = waves[i] * 32768;
-    }
-    fbank.AcceptWaveform(sample_rate, buf.data(), buf.size());
-    int32_t frames = fbank.NumFramesReady();
-    for (int32_t i = 0; i != frames; ++i) {
-        const float *frame = fbank.GetFrame(i);
-        std::vector<float> frame_vector(frame, frame + fbank_opts_.mel_opts.num_bins);
-        vad_feats.emplace_back(frame_vector);
-    }
+    fbank_plan_->Compute(waves.data(), waves.size(), vad_feats);
 }
 
 void FsmnVad::LoadCmvn(const char *filename)
@@ -189,63 +188,203 @@ void FsmnVad::LoadCmvn(const char *filename)
     }
 }
 
-void FsmnVad::LfrCmvn(std::vector<std::vector<float>> &vad_feats) {
+std::vector<std::vector<int>>
+FsmnVad::Infer(std::vector<float> &waves, bool input_finished) {
+    if (input_finished && UseWindows(waves.size())) {
+        return InferWindows(waves.data(), waves.size());
+    }
+    FeatMatrix fbank_feats;
+    std::vector<std::vector<float>> vad_probs;
+    std::vector<std::vector<int>> vad_segments;
+    FbankKaldi(vad_sample_rate_, fbank_feats, waves);
+    if(fbank_feats.Empty()){
+      return vad_segments;
+    }
+    FeatMatrix vad_feats(LfrFrameNum(fbank_feats.NumRows(), lfr_n), lfr_m * fbank_feats.NumCols());
+    ApplyLfrCmvn(fbank_feats, lfr_m, lfr_n, means_list_, vars_list_, vad_feats.Data());
+    Forward(vad_feats, &vad_probs, &in_cache_, input_finished);
+
+    E2EVadModel vad_scorer = E2EVadModel();
+    vad_segments = vad_scorer(vad_probs, waves, true, false, vad_silence_duration_, vad_max_len_,
+                              vad_speech_noise_thres_, vad_sample_rate_);
+    return vad_segments;
+}
 
-    std::vector<std::vector<float>> out_feats;
-    int T = vad_feats.size();
-    int T_lrf = ceil(1.0 * T / lfr_n);
+void FsmnVad::SetParallel(int thread_num, int window_ms) {
+    vad_threads_ = std::max(thread_num, 0);
+    vad_window_ms_ = std::max(window_ms, VAD_WINDOW_LEAD_MS);
+}
 
-    // Pad frames at start(copy first frame)
-    for (int i = 0; i < (lfr_m - 1) / 2; i++) {
-        vad_feats.insert(vad_feats.begin(), vad_feats[0]);
+void FsmnVad::InitOnlineScheduler(int max_batch, int max_wait_ms) {
+    if (max_batch <= 1 || vad_session_ == nullptr) {
+        return;
     }
-    // Merge lfr_m frames as one,lfr_n frames per window
-    T = T + (lfr_m - 1) / 2;
-    std::vector<float> p;
-    for (int i = 0; i < T_lrf; i++) {
-        if (lfr_m <= T - i * lfr_n) {
-            for (int j = 0; j < lfr_m; j++) {
-                p.insert(p.end(), vad_feats[i * lfr_n + j].begin(), vad_feats[i * lfr_n + j].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        } else {
-            // Fill to lfr_m frames at last window if less than lfr_m frames  (copy last frame)
-            int num_padding = lfr_m - (T - i * lfr_n);
-            for (int j = 0; j < (vad_feats.size() - i * lfr_n); j++) {
-                p.insert(p.end(), vad_feats[i * lfr_n + j].begin(), vad_feats[i * lfr_n + j].end());
-            }
-            for (int j = 0; j < num_padding; j++) {
-                p.insert(p.end(), vad_feats[vad_feats.size() - 1].begin(), vad_feats[vad_feats.size() - 1].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
+    // the funasr export fixes the batch axis to 1, only a model exported
+    // with a dynamic batch axis takes chunks of several streams in one run
+    try {
+        std::vector<int64_t> feats_shape = vad_session_->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        if (feats_shape.empty() || feats_shape[0] != -1) {
+            LOG(INFO) << "vad model has a fixed batch axis, online vad batching disabled";
+            return;
         }
+    } catch (std::exception const &e) {
+        LOG(ERROR) << "Error when read vad model input shape: " << e.what();
+        return;
     }
-    // Apply cmvn
-    for (auto &out_feat: out_feats) {
-        for (int j = 0; j < means_list_.size(); j++) {
-            out_feat[j] = (out_feat[j] + means_list_[j]) * vars_list_[j];
-        }
+    online_scheduler_ = make_unique<FsmnVadScheduler>(vad_session_, vad_in_names_, vad_out_names_,
+                                                      max_batch, max_wait_ms);
+}
+
+void FsmnVad::SetEnergyGate(float decibel_floor) {
+    /**
+     * Only before the online streams start. The gate replaces the fbank,
+     * probs and caches of a silent chunk by those of digital silence, so
+     * they are computed once here by running the model over a few seconds
+     * of zeros, far longer than the 4*19 frames the fsmn remembers.
+    */
+    gate_decibel_ = VAD_ENERGY_GATE_OFF;
+    if (decibel_floor <= VAD_ENERGY_GATE_OFF) {
+        return;
+    }
+    std::vector<float> zeros(fbank_opts_.frame_opts.WindowSize() +
+                             (300 - 1) * fbank_opts_.frame_opts.WindowShift(), 0);
+    FeatMatrix fbank_feats;
+    fbank_plan_->Compute(zeros.data(), zeros.size(), fbank_feats);
+    if (fbank_feats.Empty()) {
+        return;
+    }
+    FeatMatrix vad_feats(LfrFrameNum(fbank_feats.NumRows(), lfr_n), lfr_m * fbank_feats.NumCols());
+    ApplyLfrCmvn(fbank_feats, lfr_m, lfr_n, means_list_, vars_list_, vad_feats.Data());
+    std::vector<std::vector<float>> cache(4, std::vector<float>(128 * 19 * 1, 0));
+    std::vector<std::vector<float>> probs;
+    Forward(vad_feats, &probs, &cache, false);
+    if (probs.empty()) {
+        LOG(ERROR) << "Vad energy gate is off, the model failed on silence";
+        return;
+    }
+    silence_fbank_.assign(fbank_feats.Row(0), fbank_feats.Row(0) + fbank_feats.NumCols());
+    silence_probs_ = probs.back();
+    silence_cache_ = cache;
+    gate_decibel_ = decibel_floor;
+    LOG(INFO) << "Vad energy gate on, chunks below " << gate_decibel_ << " dB skip the model";
+}
+
+bool FsmnVad::ScoreWindow(const float* waves, int len, int frame_begin, int frame_end,
+                          std::vector<std::vector<float>> &probs) {
+    // the model is causal, so scores only differ from a whole file pass in
+    // the first frames after a fresh cache: start the window lead frames
+    // early and drop those, and give the lfr splice its right context
+    int shift = fbank_opts_.frame_opts.WindowShift();
+    int lead = std::min(frame_begin, VAD_WINDOW_LEAD_MS / (int)fbank_opts_.frame_opts.frame_shift_ms);
+    int first = frame_begin - lead;
+    int last = std::min(frame_end + (lfr_m - 1) / 2, fbank_plan_->NumFrames(len));
+    int sample_end = std::min(len, (last - 1) * shift + fbank_opts_.frame_opts.WindowSize());
+
+    FeatMatrix fbank_feats;
+    fbank_plan_->Compute(waves + first * shift, sample_end - first * shift, fbank_feats);
+    if (fbank_feats.NumRows() < frame_end - first) {
+        LOG(ERROR) << "Vad window has " << fbank_feats.NumRows() << " frames, expected " << frame_end - first;
+        return false;
+    }
+    FeatMatrix vad_feats(LfrFrameNum(fbank_feats.NumRows(), lfr_n), lfr_m * fbank_feats.NumCols());
+    ApplyLfrCmvn(fbank_feats, lfr_m, lfr_n, means_list_, vars_list_, vad_feats.Data());
+
+    std::vector<std::vector<float>> in_cache(4, std::vector<float>(128 * 19 * 1, 0));
+    std::vector<std::vector<float>> window_probs;
+    Forward(vad_feats, &window_probs, &in_cache, true);
+    if (window_probs.size() < (size_t)(frame_end - first)) {
+        return false;
     }
-    vad_feats = out_feats;
+    probs.assign(std::make_move_iterator(window_probs.begin() + lead),
+                 std::make_move_iterator(window_probs.begin() + lead + frame_end - frame_begin));
+    return true;
 }
 
 std::vector<std::vector<int>>
-FsmnVad::Infer(std::vector<float> &waves, bool input_finished) {
-    std::vector<std::vector<float>> vad_feats;
-    std::vector<std::vector<float>> vad_probs;
+FsmnVad::InferWindows(const float* waves, int len) {
+    /**
+     * Fbank and the model run for windows of vad_window_ms_ on up to
+     * vad_threads_ threads, while this thread feeds the scores window after
+     * window to one E2EVadModel. The segment decisions are thus made in
+     * order over the whole file and are the same as those of Infer, however
+     * the windows are scheduled. At most two windows per thread are scored
+     * ahead of the one being fed, which bounds the feature memory.
+    */
     std::vector<std::vector<int>> vad_segments;
-    FbankKaldi(vad_sample_rate_, vad_feats, waves);
-    if(vad_feats.size() == 0){
-      return vad_segments;
+    int num_frames = fbank_plan_->NumFrames(len);
+    if (num_frames <= 0) {
+        return vad_segments;
+    }
+    int shift = fbank_opts_.frame_opts.WindowShift();
+    int window_frames = std::max(vad_window_ms_ / (int)fbank_opts_.frame_opts.frame_shift_ms, 1);
+    int num_windows = (num_frames + window_frames - 1) / window_frames;
+    int num_threads = std::max(std::min(vad_threads_, num_windows), 1);
+    int max_ahead = 2 * num_threads;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<std::vector<std::vector<float>>> window_probs(num_windows);
+    std::vector<int> window_state(num_windows, 0);  // 0 queued, 1 scored, -1 failed
+    int next_window = 0;
+    int fed_window = 0;
+    bool stop = false;
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cv.wait(lock, [&]{ return stop || next_window >= num_windows || next_window < fed_window + max_ahead; });
+            if (stop || next_window >= num_windows) {
+                return;
+            }
+            int w = next_window++;
+            lock.unlock();
+            std::vector<std::vector<float>> probs;
+            int frame_begin = w * window_frames;
+            bool ok = ScoreWindow(waves, len, frame_begin, std::min(frame_begin + window_frames, num_frames), probs);
+            lock.lock();
+            window_probs[w] = std::move(probs);
+            window_state[w] = ok ? 1 : -1;
+            cv.notify_all();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_threads; i++) {
+        workers.emplace_back(worker);
     }
-    LfrCmvn(vad_feats);
-    Forward(vad_feats, &vad_probs, &in_cache_, input_finished);
 
     E2EVadModel vad_scorer = E2EVadModel();
-    vad_segments = vad_scorer(vad_probs, waves, true, false, vad_silence_duration_, vad_max_len_,
-                              vad_speech_noise_thres_, vad_sample_rate_);
+    bool failed = false;
+    for (int w = 0; w < num_windows; w++) {
+        std::vector<std::vector<float>> probs;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&]{ return window_state[w] != 0; });
+            failed = window_state[w] < 0;
+            probs = std::move(window_probs[w]);
+            fed_window = w + 1;
+            stop = failed;
+            cv.notify_all();
+        }
+        if (failed) {
+            break;
+        }
+        // the decibels of a window's frames, a frame reaches past its shift
+        bool is_final = (w == num_windows - 1);
+        int sample_begin = w * window_frames * shift;
+        int sample_end = is_final ? len : (w + 1) * window_frames * shift +
+                                          fbank_opts_.frame_opts.WindowSize() - shift;
+        std::vector<float> window_waves(waves + sample_begin, waves + sample_end);
+        std::vector<std::vector<int>> segments = vad_scorer(probs, window_waves, is_final, false, vad_silence_duration_,
+                                                            vad_max_len_, vad_speech_noise_thres_, vad_sample_rate_);
+        vad_segments.insert(vad_segments.end(), segments.begin(), segments.end());
+    }
+    for (auto &t : workers) {
+        t.join();
+    }
+    if (failed) {
+        LOG(ERROR) << "Error when scoring vad windows";
+        vad_segments.clear();
+    }
     return vad_segments;
 }
 
@@ -267,7 +406,7 @@ void FsmnVad::Test() {
 FsmnVad::~FsmnVad() {
 }
 
-FsmnVad::FsmnVad():env_(ORT_LOGGING_LEVEL_ERROR, ""),session_options_{} {
+FsmnVad::FsmnVad():session_options_{} {
 }
 
 } // namespace funasr
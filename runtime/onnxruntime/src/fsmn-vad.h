@@ -22,24 +22,50 @@ public:
     void Test();
     void InitVad(const std::string &vad_model, const std::string &vad_cmvn, const std::string &vad_config, int thread_num);
     std::vector<std::vector<int>> Infer(std::vector<float> &waves, bool input_finished=true);
+    void SetParallel(int thread_num, int window_ms);
+    // batches the Forward of concurrent FsmnVadOnline streams, max_batch <= 1 keeps one run per chunk
+    void InitOnlineScheduler(int max_batch, int max_wait_ms);
+    void SetEnergyGate(float decibel_floor);
+    bool UseEnergyGate() const {return gate_decibel_ > VAD_ENERGY_GATE_OFF;};
+    float GetGateDecibel() const {return gate_decibel_;};
+    // what fbank and the model give for digital silence: one fbank frame, the
+    // probs of a frame and the caches after a long silence
+    const std::vector<float> &SilenceFbank() const {return silence_fbank_;};
+    const std::vector<float> &SilenceProbs() const {return silence_probs_;};
+    const std::vector<std::vector<float>> &SilenceCache() const {return silence_cache_;};
+    // segments of the whole of waves, scored in windows on the parallel threads
+    std::vector<std::vector<int>> InferWindows(const float* waves, int len);
+    bool UseWindows(int len) const {
+        return vad_threads_ > 0 && (long long)len * 1000 > (long long)vad_window_ms_ * vad_sample_rate_;
+    };
     void Forward(
         const std::vector<std::vector<float>> &chunk_feats,
         std::vector<std::vector<float>> *out_prob,
         std::vector<std::vector<float>> *in_cache,
         bool is_final);
+    void Forward(
+        FeatMatrix &vad_feats,
+        std::vector<std::vector<float>> *out_prob,
+        std::vector<std::vector<float>> *in_cache,
+        bool is_final);
     void Reset();
 
     int GetVadSampleRate() { return vad_sample_rate_; };
     
-    Ort::Env env_;
     Ort::SessionOptions session_options_;
     std::shared_ptr<Ort::Session> vad_session_ = nullptr;
     vector<string> m_strInputNames, m_strOutputNames;
     std::vector<const char *> vad_in_names_;
     std::vector<const char *> vad_out_names_;
     std::vector<std::vector<float>> in_cache_;
+    std::unique_ptr<FsmnVadScheduler> online_scheduler_ = nullptr;
+    float gate_decibel_ = VAD_ENERGY_GATE_OFF;
+    std::vector<float> silence_fbank_;
+    std::vector<float> silence_probs_;
+    std::vector<std::vector<float>> silence_cache_;
     
     knf::FbankOptions fbank_opts_;
+    std::shared_ptr<FbankPlan> fbank_plan_ = nullptr;
     std::vector<float> means_list_;
     std::vector<float> vars_list_;
 
@@ -49,16 +75,19 @@ public:
     double vad_speech_noise_thres_ = VAD_SPEECH_NOISE_THRES;
     int lfr_m = VAD_LFR_M;
     int lfr_n = VAD_LFR_N;
+    int vad_threads_ = 0;
+    int vad_window_ms_ = VAD_WINDOW_MS;
 
 private:
 
     void ReadModel(const char* vad_model);
     void LoadConfigFromYaml(const char* filename);
 
-    void FbankKaldi(float sample_rate, std::vector<std::vector<float>> &vad_feats,
+    void FbankKaldi(float sample_rate, FeatMatrix &vad_feats,
                     std::vector<float> &waves);
 
-    void LfrCmvn(std::vector<std::vector<float>> &vad_feats);
+    bool ScoreWindow(const float* waves, int len, int frame_begin, int frame_end,
+                     std::vector<std::vector<float>> &probs);
     void LoadCmvn(const char *filename);
     void InitCache();
 
@@ -3,6 +3,21 @@
 
 
 	// APIs for Init
+	_FUNASRAPI bool FunSetComputeThreads(int compute_threads, int intra_threads)
+	{
+		return funasr::ComputeScheduler::Instance().SetComputeThreads(compute_threads, intra_threads);
+	}
+
+	_FUNASRAPI FUNASR_COMPUTE_STATS FunGetComputeStats()
+	{
+		return funasr::ComputeScheduler::Instance().GetStats();
+	}
+
+	_FUNASRAPI void FunSetComputeBackground(bool background)
+	{
+		funasr::ComputeScheduler::SetBackground(background);
+	}
+
 	_FUNASRAPI FUNASR_HANDLE  FunASRInit(std::map<std::string, std::string>& model_path, int thread_num, ASR_TYPE type)
 	{
 		funasr::Model* mm = funasr::CreateModel(model_path, thread_num, type);
@@ -27,6 +42,20 @@
 		return mm;
 	}
 
+	_FUNASRAPI void FsmnVadSetParallel(FUNASR_HANDLE handle, int thread_num, int window_ms)
+	{
+		funasr::VadModel* vad_obj = (funasr::VadModel*)handle;
+		if (vad_obj)
+			vad_obj->SetParallel(thread_num, window_ms);
+	}
+
+	_FUNASRAPI void FsmnVadSetEnergyGate(FUNASR_HANDLE handle, float decibel_floor)
+	{
+		funasr::VadModel* vad_obj = (funasr::VadModel*)handle;
+		if (vad_obj)
+			vad_obj->SetEnergyGate(decibel_floor);
+	}
+
 	_FUNASRAPI FUNASR_HANDLE  CTTransformerInit(std::map<std::string, std::string>& model_path, int thread_num, PUNC_TYPE type)
 	{
 		funasr::PuncModel* mm = funasr::CreatePuncModel(model_path, thread_num, type);
@@ -39,9 +68,16 @@
 		return mm;
 	}
 
-	_FUNASRAPI FUNASR_HANDLE  FunTpassInit(std::map<std::string, std::string>& model_path, int thread_num)
+	_FUNASRAPI void FunOfflineSetVadParallel(FUNASR_HANDLE handle, int thread_num, int window_ms)
+	{
+		funasr::OfflineStream* offline_stream = (funasr::OfflineStream*)handle;
+		if (offline_stream && offline_stream->UseVad())
+			offline_stream->vad_handle->SetParallel(thread_num, window_ms);
+	}
+
+	_FUNASRAPI FUNASR_HANDLE  FunTpassInit(std::map<std::string, std::string>& model_path, int thread_num, int batch_size, int batch_wait_ms)
 	{
-		funasr::TpassStream* mm = funasr::CreateTpassStream(model_path, thread_num);
+		funasr::TpassStream* mm = funasr::CreateTpassStream(model_path, thread_num, batch_size, batch_wait_ms);
 		return mm;
 	}
 
@@ -50,6 +86,14 @@
 		return funasr::CreateTpassOnlineStream(tpass_handle, chunk_size);
 	}
 
+	_FUNASRAPI FUNASR_HANDLE FunOfflineIncrementalInit(FUNASR_HANDLE handle)
+	{
+		funasr::OfflineStream* offline_stream = (funasr::OfflineStream*)handle;
+		if (!offline_stream)
+			return nullptr;
+		return funasr::CreateOfflineIncrementalStream(offline_stream);
+	}
+
 	// APIs for ASR Infer
 	_FUNASRAPI FUNASR_RESULT FunASRInferBuffer(FUNASR_HANDLE handle, const char* sz_buf, int n_len, FUNASR_MODE mode, QM_CALLBACK fn_callback, bool input_finished, int sampling_rate, std::string wav_format)
 	{
@@ -195,7 +239,8 @@
 				p_result = (FUNASR_RESULT)new funasr::FUNASR_PUNC_RESULT;
 			else
 				p_result = pre_result;
-			((funasr::FUNASR_PUNC_RESULT*)p_result)->msg = punc_obj->AddPunc(sz_sentence, ((funasr::FUNASR_PUNC_RESULT*)p_result)->arr_cache);
+			((funasr::FUNASR_PUNC_RESULT*)p_result)->msg = punc_obj->AddPunc(sz_sentence, ((funasr::FUNASR_PUNC_RESULT*)p_result)->arr_cache,
+															  ((funasr::FUNASR_PUNC_RESULT*)p_result)->punc_state);
 		}else{
 			LOG(ERROR) << "Wrong PUNC_TYPE";
 			exit(-1);
@@ -205,10 +250,70 @@
 	}
 
 	// APIs for Offline-stream Infer
+	// joins the per segment results of an offline stream, adds punctuation and itn
+	static void JoinOfflineResult(funasr::OfflineStream* offline_stream, const std::vector<string> &msgs,
+								  const std::vector<float> &msg_stimes, bool itn, funasr::FUNASR_RECOG_RESULT* p_result)
+	{
+		std::string cur_stamp = "[";
+		std::string lang = (offline_stream->asr_handle)->GetLang();
+		for(int idx=0; idx<msgs.size(); idx++){
+			string msg = msgs[idx];
+			std::vector<std::string> msg_vec = funasr::SplitStr(msg, " | ");
+			if(msg_vec.size()==0){
+				continue;
+			}
+			if(lang == "en-bpe" && p_result->msg != ""){
+				p_result->msg += " ";
+			}
+			p_result->msg += msg_vec[0];
+			//timestamp
+			if(msg_vec.size() > 1){
+				std::vector<std::string> msg_stamp = funasr::split(msg_vec[1], ',');
+				for(int i=0; i<msg_stamp.size()-1; i+=2){
+					float begin = std::stof(msg_stamp[i])+msg_stimes[idx];
+					float end = std::stof(msg_stamp[i+1])+msg_stimes[idx];
+					cur_stamp += "["+std::to_string((int)(1000*begin))+","+std::to_string((int)(1000*end))+"],";
+				}
+			}
+		}
+		if(cur_stamp != "["){
+			cur_stamp.erase(cur_stamp.length() - 1);
+			p_result->stamp += cur_stamp + "]";
+		}
+		if(offline_stream->UsePunc()){
+			string punc_res = (offline_stream->punc_handle)->AddPunc((p_result->msg).c_str(), lang);
+			p_result->msg = punc_res;
+		}
+#if !defined(__APPLE__)
+		if(offline_stream->UseITN() && itn){
+			string msg_itn = offline_stream->itn_handle->Normalize(p_result->msg);
+			if(!(p_result->stamp).empty()){
+				std::string new_stamp = funasr::TimestampSmooth(p_result->msg, msg_itn, p_result->stamp);
+				if(!new_stamp.empty()){
+					p_result->stamp = new_stamp;
+				}
+			}
+			p_result->msg = msg_itn;
+		}
+#endif
+		if (!(p_result->stamp).empty()){
+			p_result->stamp_sents = funasr::TimestampSentence(p_result->msg, p_result->stamp);
+		}
+	}
+
 	_FUNASRAPI FUNASR_RESULT FunOfflineInferBuffer(FUNASR_HANDLE handle, const char* sz_buf, int n_len, 
 												   FUNASR_MODE mode, QM_CALLBACK fn_callback, const std::vector<std::vector<float>> &hw_emb, 
 												   int sampling_rate, std::string wav_format, bool itn, FUNASR_DEC_HANDLE dec_handle,
 												   std::string svs_lang, bool svs_itn)
+	{
+		return FunOfflineInferBuffer(handle, sz_buf, n_len, mode, fn_callback, std::make_shared<const funasr::HotwordEmbedding>(hw_emb),
+									 sampling_rate, wav_format, itn, dec_handle, svs_lang, svs_itn);
+	}
+
+	_FUNASRAPI FUNASR_RESULT FunOfflineInferBuffer(FUNASR_HANDLE handle, const char* sz_buf, int n_len, 
+												   FUNASR_MODE mode, QM_CALLBACK fn_callback, const funasr::HotwordEmbeddingPtr &hw_emb, 
+												   int sampling_rate, std::string wav_format, bool itn, FUNASR_DEC_HANDLE dec_handle,
+												   std::string svs_lang, bool svs_itn)
 	{
 		funasr::OfflineStream* offline_stream = (funasr::OfflineStream*)handle;
 		if (!offline_stream)
@@ -249,8 +354,6 @@
 		int batch_size = offline_stream->asr_handle->GetBatchSize();
 		int batch_in = 0;
 
-		std::string cur_stamp = "[";
-		std::string lang = (offline_stream->asr_handle)->GetLang();
 		while (audio.FetchDynamic(buff, len, flag, start_time, batch_size, batch_in) > 0) {
 			// dec reset
 			funasr::WfstDecoder* wfst_decoder = (funasr::WfstDecoder*)dec_handle;
@@ -284,54 +387,19 @@
 			delete[] start_time;
 			start_time = nullptr;
 		}
-		for(int idx=0; idx<msgs.size(); idx++){
-			string msg = msgs[idx];
-			std::vector<std::string> msg_vec = funasr::SplitStr(msg, " | ");
-			if(msg_vec.size()==0){
-				continue;
-			}
-			if(lang == "en-bpe" && p_result->msg != ""){
-				p_result->msg += " ";
-			}
-			p_result->msg += msg_vec[0];
-			//timestamp
-			if(msg_vec.size() > 1){
-				std::vector<std::string> msg_stamp = funasr::split(msg_vec[1], ',');
-				for(int i=0; i<msg_stamp.size()-1; i+=2){
-					float begin = std::stof(msg_stamp[i])+msg_stimes[idx];
-					float end = std::stof(msg_stamp[i+1])+msg_stimes[idx];
-					cur_stamp += "["+std::to_string((int)(1000*begin))+","+std::to_string((int)(1000*end))+"],";
-				}
-			}
-		}
-		if(cur_stamp != "["){
-			cur_stamp.erase(cur_stamp.length() - 1);
-			p_result->stamp += cur_stamp + "]";
-		}
-		if(offline_stream->UsePunc()){
-			string punc_res = (offline_stream->punc_handle)->AddPunc((p_result->msg).c_str(), lang);
-			p_result->msg = punc_res;
-		}
-#if !defined(__APPLE__)
-		if(offline_stream->UseITN() && itn){
-			string msg_itn = offline_stream->itn_handle->Normalize(p_result->msg);
-			if(!(p_result->stamp).empty()){
-				std::string new_stamp = funasr::TimestampSmooth(p_result->msg, msg_itn, p_result->stamp);
-				if(!new_stamp.empty()){
-					p_result->stamp = new_stamp;
-				}
-			}			
-			p_result->msg = msg_itn;
-		}
-#endif
-		if (!(p_result->stamp).empty()){
-			p_result->stamp_sents = funasr::TimestampSentence(p_result->msg, p_result->stamp);
-		}
+		JoinOfflineResult(offline_stream, msgs, msg_stimes, itn, p_result);
 		return p_result;
 	}
 
 	_FUNASRAPI FUNASR_RESULT FunOfflineInfer(FUNASR_HANDLE handle, const char* sz_filename, FUNASR_MODE mode, QM_CALLBACK fn_callback, 
 											 const std::vector<std::vector<float>> &hw_emb, int sampling_rate, bool itn, FUNASR_DEC_HANDLE dec_handle)
+	{
+		return FunOfflineInfer(handle, sz_filename, mode, fn_callback, std::make_shared<const funasr::HotwordEmbedding>(hw_emb),
+							   sampling_rate, itn, dec_handle);
+	}
+
+	_FUNASRAPI FUNASR_RESULT FunOfflineInfer(FUNASR_HANDLE handle, const char* sz_filename, FUNASR_MODE mode, QM_CALLBACK fn_callback, 
+											 const funasr::HotwordEmbeddingPtr &hw_emb, int sampling_rate, bool itn, FUNASR_DEC_HANDLE dec_handle)
 	{
 		funasr::OfflineStream* offline_stream = (funasr::OfflineStream*)handle;
 		if (!offline_stream)
@@ -376,8 +444,6 @@
 		int batch_size = offline_stream->asr_handle->GetBatchSize();
 		int batch_in = 0;
 
-		std::string cur_stamp = "[";
-		std::string lang = (offline_stream->asr_handle)->GetLang();
 		while (audio.FetchDynamic(buff, len, flag, start_time, batch_size, batch_in) > 0) {
 			// dec reset
 			funasr::WfstDecoder* wfst_decoder = (funasr::WfstDecoder*)dec_handle;
@@ -406,53 +472,40 @@
 			delete[] start_time;
 			start_time = nullptr;
 		}
-		for(int idx=0; idx<msgs.size(); idx++){
-			string msg = msgs[idx];
-			std::vector<std::string> msg_vec = funasr::SplitStr(msg, " | ");
-			if(msg_vec.size()==0){
-				continue;
-			}
-			if(lang == "en-bpe" && p_result->msg != ""){
-				p_result->msg += " ";
-			}
-			p_result->msg += msg_vec[0];
-			//timestamp
-			if(msg_vec.size() > 1){
-				std::vector<std::string> msg_stamp = funasr::split(msg_vec[1], ',');
-				for(int i=0; i<msg_stamp.size()-1; i+=2){
-					float begin = std::stof(msg_stamp[i])+msg_stimes[idx];
-					float end = std::stof(msg_stamp[i+1])+msg_stimes[idx];
-					cur_stamp += "["+std::to_string((int)(1000*begin))+","+std::to_string((int)(1000*end))+"],";
-				}
-			}
-		}
-		if(cur_stamp != "["){
-			cur_stamp.erase(cur_stamp.length() - 1);
-			p_result->stamp += cur_stamp + "]";
-		}
-		if(offline_stream->UsePunc()){
-			string punc_res = (offline_stream->punc_handle)->AddPunc((p_result->msg).c_str(), lang);
-			p_result->msg = punc_res;
-		}
-#if !defined(__APPLE__)
-		if(offline_stream->UseITN() && itn){
-			string msg_itn = offline_stream->itn_handle->Normalize(p_result->msg);
-			if(!(p_result->stamp).empty()){
-				std::string new_stamp = funasr::TimestampSmooth(p_result->msg, msg_itn, p_result->stamp);
-				if(!new_stamp.empty()){
-					p_result->stamp = new_stamp;
-				}
-			}
-			p_result->msg = msg_itn;
+		JoinOfflineResult(offline_stream, msgs, msg_stimes, itn, p_result);
+		return p_result;
+	}
+
+//#if !defined(__APPLE__)
+	_FUNASRAPI FUNASR_RESULT FunOfflineIncrementalInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE incremental_handle, const char* sz_buf, int n_len,
+															  bool input_finished, int sampling_rate, const funasr::HotwordEmbeddingPtr &hw_emb,
+															  bool itn, FUNASR_DEC_HANDLE dec_handle, std::string svs_lang, bool svs_itn)
+	{
+		funasr::OfflineStream* offline_stream = (funasr::OfflineStream*)handle;
+		funasr::OfflineIncrementalStream* incremental_stream = (funasr::OfflineIncrementalStream*)incremental_handle;
+		if (!offline_stream || !incremental_stream)
+			return nullptr;
+
+		try{
+			incremental_stream->AcceptPcm(sz_buf, n_len, sampling_rate, input_finished);
+			incremental_stream->Decode(input_finished, hw_emb, dec_handle, svs_lang, svs_itn);
+		}catch (std::exception const &e)
+		{
+			LOG(ERROR)<<e.what();
+			return nullptr;
 		}
-#endif
-		if (!(p_result->stamp).empty()){
-			p_result->stamp_sents = funasr::TimestampSentence(p_result->msg, p_result->stamp);
+		if (!input_finished)
+			return nullptr;
+
+		funasr::FUNASR_RECOG_RESULT* p_result = new funasr::FUNASR_RECOG_RESULT;
+		p_result->snippet_time = incremental_stream->GetTimeLen();
+		if(p_result->snippet_time == 0){
+			return p_result;
 		}
+		JoinOfflineResult(offline_stream, incremental_stream->msgs, incremental_stream->msg_stimes, itn, p_result);
 		return p_result;
 	}
 
-//#if !defined(__APPLE__)
 	_FUNASRAPI const std::vector<std::vector<float>> CompileHotwordEmbedding(FUNASR_HANDLE handle, std::string &hotwords, ASR_TYPE mode)
 	{
 		std::vector<std::vector<float>> emb;
@@ -471,6 +524,50 @@
 		}
 		return emb;		
 	}
+
+	static funasr::Model* GetHotwordModel(FUNASR_HANDLE handle, ASR_TYPE mode)
+	{
+		if (mode == ASR_OFFLINE){
+			funasr::OfflineStream* offline_stream = (funasr::OfflineStream*)handle;
+			if (offline_stream)
+				return (offline_stream->asr_handle).get();
+		}
+		else if (mode == ASR_TWO_PASS){
+			funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
+			if (tpass_stream)
+				return (tpass_stream->asr_handle).get();
+		}
+		return nullptr;
+	}
+
+	_FUNASRAPI funasr::HotwordEmbeddingPtr CompileSharedHotwordEmbedding(FUNASR_HANDLE handle, std::string &hotwords, ASR_TYPE mode)
+	{
+		funasr::Model* asr_handle = GetHotwordModel(handle, mode);
+		funasr::HotwordCache* hw_cache = asr_handle ? asr_handle->GetHotwordCache() : nullptr;
+		if (!hw_cache)
+			return std::make_shared<const funasr::HotwordEmbedding>(CompileHotwordEmbedding(handle, hotwords, mode));
+		return hw_cache->GetEmbedding(hotwords, [asr_handle](std::string &normalized){
+			return asr_handle->CompileHotwordEmbedding(normalized);
+		});
+	}
+
+	_FUNASRAPI void FunSetHotwordCacheLimit(FUNASR_HANDLE handle, long long emb_bytes, long long bias_lm_bytes, ASR_TYPE mode)
+	{
+		funasr::Model* asr_handle = GetHotwordModel(handle, mode);
+		if (asr_handle && asr_handle->GetHotwordCache())
+			asr_handle->GetHotwordCache()->SetLimit(emb_bytes, bias_lm_bytes);
+	}
+
+	_FUNASRAPI FUNASR_CACHE_STATS FunGetHotwordCacheStats(FUNASR_HANDLE handle, bool bias_lm, ASR_TYPE mode)
+	{
+		FUNASR_CACHE_STATS stats = {0, 0, 0, 0, 0, 0};
+		funasr::Model* asr_handle = GetHotwordModel(handle, mode);
+		if (!asr_handle || !asr_handle->GetHotwordCache())
+			return stats;
+		if (bias_lm)
+			return asr_handle->GetHotwordCache()->GetBiasLmStats();
+		return asr_handle->GetHotwordCache()->GetEmbeddingStats();
+	}
 //#endif
 
 	// APIs for 2pass-stream Infer
@@ -480,8 +577,16 @@
 												 const std::vector<std::vector<float>> &hw_emb, bool itn, FUNASR_DEC_HANDLE dec_handle,
 												 std::string svs_lang, bool svs_itn)
 	{
-		funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
-		funasr::TpassOnlineStream* tpass_online_stream = (funasr::TpassOnlineStream*)online_handle;
+		return FunTpassInferBuffer(handle, online_handle, sz_buf, n_len, punc_cache, input_finished, sampling_rate, wav_format, mode,
+								   std::make_shared<const funasr::HotwordEmbedding>(hw_emb), itn, dec_handle, svs_lang, svs_itn);
+	}
+
+	// first pass of a 2pass stream: the vad and the online asr. The segments
+	// the vad closes are queued in the online stream for TpassOfflineSegment
+	static funasr::FUNASR_RECOG_RESULT* TpassFirstPass(funasr::TpassStream* tpass_stream, funasr::TpassOnlineStream* tpass_online_stream,
+												 const char* sz_buf, int n_len, std::vector<std::vector<std::string>> &punc_cache,
+												 bool input_finished, int sampling_rate, std::string wav_format, ASR_TYPE mode, bool itn)
+	{
 		if (!tpass_stream || !tpass_online_stream)
 			return nullptr;
 		
@@ -502,9 +607,10 @@
 		if (!punc_online_handle)
 			return nullptr;
 
-		funasr::Audio* audio = ((funasr::FsmnVadOnline*)vad_online_handle)->audio_handle.get();
+		funasr::FsmnVadOnline* vad_online = (funasr::FsmnVadOnline*)vad_online_handle;
+		funasr::Audio* audio = vad_online->audio_handle.get();
 		if(wav_format == "pcm" || wav_format == "PCM"){
-			if (!audio->LoadPcmwavOnline(sz_buf, n_len, &sampling_rate))
+			if (!audio->LoadPcmwavOnline(sz_buf, n_len, &sampling_rate, input_finished))
 				return nullptr;
 		}else{
 			// if (!audio->FfmpegLoad(sz_buf, n_len))
@@ -525,7 +631,7 @@
 				((funasr::ParaformerOnline*)asr_online_handle)->online_res += msg;
 				if(frame->is_final){
 					string online_msg = ((funasr::ParaformerOnline*)asr_online_handle)->online_res;
-					string msg_punc = punc_online_handle->AddPunc(online_msg.c_str(), punc_cache[0]);
+					string msg_punc = punc_online_handle->AddPunc(online_msg.c_str(), punc_cache[0], tpass_online_stream->punc_state[0]);
 					p_result->tpass_msg = msg_punc;
 #if !defined(__APPLE__)
 					// ITN
@@ -548,86 +654,199 @@
 			}
 		}
 
-		// timestamp
-		std::string cur_stamp = "[";		
+		// the frames point into the sample history, which moves on with the
+		// next buffer, so the segments keep copies
 		while(audio->FetchTpass(frame) > 0){
-			// dec reset
-			funasr::WfstDecoder* wfst_decoder = (funasr::WfstDecoder*)dec_handle;
-			if (wfst_decoder){
-				wfst_decoder->StartUtterance();
-			}
-			float** buff;
-			int* len;
-			buff = new float*[1];
-        	len = new int[1];
-			buff[0] = frame->data;
-			len[0] = frame->len;
-			vector<string> msgs;
-			if(tpass_stream->GetModelType() == MODEL_SVS){
-				msgs = (tpass_stream->asr_handle)->Forward(buff, len, true, svs_lang, svs_itn, 1);
-			}else{
-				msgs = (tpass_stream->asr_handle)->Forward(buff, len, true, hw_emb, dec_handle, 1);
-			}
-			string msg = msgs.size()>0?msgs[0]:"";
-			std::vector<std::string> msg_vec = funasr::SplitStr(msg, " | ");  // split with timestamp
-			if(msg_vec.size()==0){
-				continue;
-			}
-			msg = msg_vec[0];
-			//timestamp
-			if(msg_vec.size() > 1){
-				std::vector<std::string> msg_stamp = funasr::split(msg_vec[1], ',');
-				for(int i=0; i<msg_stamp.size()-1; i+=2){
-					float begin = std::stof(msg_stamp[i]) + float(frame->global_start)/1000.0;
-					float end = std::stof(msg_stamp[i+1]) + float(frame->global_start)/1000.0;
-					cur_stamp += "["+std::to_string((int)(1000*begin))+","+std::to_string((int)(1000*end))+"],";
-				}
-			}
+			funasr::TpassSegment segment;
+			segment.samples.assign(frame->data, frame->data + frame->len);
+			// the vad already computed the fbank frames of this segment
+			segment.has_feats = vad_online->GetFbankFrames(frame->global_start*audio->seg_sample, frame->len, segment.feats);
+			segment.global_start = frame->global_start;
+			segment.input_finished = input_finished;
+			tpass_online_stream->PushSegment(std::move(segment));
+			delete frame;
+			frame = nullptr;
+		}
+
+		if(input_finished){
+			audio->ResetIndex();
+			vad_online->ResetFbankCache();
+		}else{
+			// same window as the samples Audio keeps for later segments
+			vad_online->TrimFbankCache(audio->offset);
+		}
 
-			if(cur_stamp != "["){
-				cur_stamp.erase(cur_stamp.length() - 1);
-				p_result->stamp += cur_stamp + "]";
+		return p_result;
+	}
+
+	// offline pass of the oldest segment waiting in the online stream, the
+	// result goes to the tpass fields of p_result. false when none waits
+	static bool TpassOfflineSegment(funasr::TpassStream* tpass_stream, funasr::TpassOnlineStream* tpass_online_stream,
+									std::vector<std::vector<std::string>> &punc_cache, const funasr::HotwordEmbeddingPtr &hw_emb,
+									bool itn, FUNASR_DEC_HANDLE dec_handle, std::string svs_lang, bool svs_itn,
+									funasr::FUNASR_RECOG_RESULT* p_result)
+	{
+		funasr::PuncModel* punc_online_handle = (tpass_stream->punc_online_handle).get();
+		funasr::TpassSegment segment;
+		if (!punc_online_handle || !tpass_online_stream->PopSegment(segment))
+			return false;
+
+		// dec reset
+		funasr::WfstDecoder* wfst_decoder = (funasr::WfstDecoder*)dec_handle;
+		if (wfst_decoder){
+			wfst_decoder->StartUtterance();
+		}
+		float* buff[1] = {segment.samples.data()};
+		int len[1] = {(int)segment.samples.size()};
+		const funasr::FeatMatrix* feats[1] = {segment.has_feats ? &segment.feats : nullptr};
+		vector<string> msgs;
+		if(tpass_stream->GetModelType() == MODEL_SVS){
+			msgs = (tpass_stream->asr_handle)->Forward(buff, len, true, svs_lang, svs_itn, 1);
+		}else if(tpass_stream->batcher_handle && wfst_decoder == nullptr){
+			// wfst decoders keep per-stream state, only greedy search is batched across streams
+			msgs.push_back(tpass_stream->batcher_handle->Infer(buff[0], len[0], hw_emb, feats[0]));
+		}else if(feats[0]){
+			msgs = (tpass_stream->asr_handle)->ForwardFeats(feats, 1, true, hw_emb, dec_handle);
+		}else{
+			msgs = (tpass_stream->asr_handle)->Forward(buff, len, true, hw_emb, dec_handle, 1);
+		}
+		string msg = msgs.size()>0?msgs[0]:"";
+		std::vector<std::string> msg_vec = funasr::SplitStr(msg, " | ");  // split with timestamp
+		if(msg_vec.size()==0){
+			return true;
+		}
+		msg = msg_vec[0];
+		//timestamp
+		std::string cur_stamp = "[";
+		if(msg_vec.size() > 1){
+			std::vector<std::string> msg_stamp = funasr::split(msg_vec[1], ',');
+			for(int i=0; i<msg_stamp.size()-1; i+=2){
+				float begin = std::stof(msg_stamp[i]) + float(segment.global_start)/1000.0;
+				float end = std::stof(msg_stamp[i+1]) + float(segment.global_start)/1000.0;
+				cur_stamp += "["+std::to_string((int)(1000*begin))+","+std::to_string((int)(1000*end))+"],";
 			}
+		}
 
-			if (tpass_stream->GetModelType() == MODEL_PARA){
-				string msg_punc = punc_online_handle->AddPunc(msg.c_str(), punc_cache[1]);
-				if(input_finished){
-					msg_punc += "。";
-				}
-				p_result->tpass_msg = msg_punc;
+		if(cur_stamp != "["){
+			cur_stamp.erase(cur_stamp.length() - 1);
+			p_result->stamp += cur_stamp + "]";
+		}
+
+		if (tpass_stream->GetModelType() == MODEL_PARA){
+			string msg_punc = punc_online_handle->AddPunc(msg.c_str(), punc_cache[1], tpass_online_stream->punc_state[1]);
+			if(segment.input_finished){
+				msg_punc += "。";
+			}
+			p_result->tpass_msg = msg_punc;
 
 #if !defined(__APPLE__)
-				if(tpass_stream->UseITN() && itn){
-					string msg_itn = tpass_stream->itn_handle->Normalize(msg_punc);
-					// TimestampSmooth
-					if(!(p_result->stamp).empty()){
-						std::string new_stamp = funasr::TimestampSmooth(p_result->tpass_msg, msg_itn, p_result->stamp);
-						if(!new_stamp.empty()){
-							p_result->stamp = new_stamp;
-						}
+			if(tpass_stream->UseITN() && itn){
+				string msg_itn = tpass_stream->itn_handle->Normalize(msg_punc);
+				// TimestampSmooth
+				if(!(p_result->stamp).empty()){
+					std::string new_stamp = funasr::TimestampSmooth(p_result->tpass_msg, msg_itn, p_result->stamp);
+					if(!new_stamp.empty()){
+						p_result->stamp = new_stamp;
 					}
-					p_result->tpass_msg = msg_itn;
 				}
-#endif
-			}else{
-				p_result->tpass_msg = msg;
-			}
-			if (!(p_result->stamp).empty()){
-				p_result->stamp_sents = funasr::TimestampSentence(p_result->tpass_msg, p_result->stamp);
-			}
-			if(frame != nullptr){
-				delete frame;
-				frame = nullptr;
+				p_result->tpass_msg = msg_itn;
 			}
+#endif
+		}else{
+			p_result->tpass_msg = msg;
+		}
+		if (!(p_result->stamp).empty()){
+			p_result->stamp_sents = funasr::TimestampSentence(p_result->tpass_msg, p_result->stamp);
 		}
+		return true;
+	}
 
-		if(input_finished){
-			audio->ResetIndex();
+	_FUNASRAPI FUNASR_RESULT FunTpassInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE online_handle, const char* sz_buf, 
+												 int n_len, std::vector<std::vector<std::string>> &punc_cache, bool input_finished, 
+												 int sampling_rate, std::string wav_format, ASR_TYPE mode, 
+												 const funasr::HotwordEmbeddingPtr &hw_emb, bool itn, FUNASR_DEC_HANDLE dec_handle,
+												 std::string svs_lang, bool svs_itn)
+	{
+		funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
+		funasr::TpassOnlineStream* tpass_online_stream = (funasr::TpassOnlineStream*)online_handle;
+		funasr::FUNASR_RECOG_RESULT* p_result = TpassFirstPass(tpass_stream, tpass_online_stream, sz_buf, n_len, punc_cache,
+															   input_finished, sampling_rate, wav_format, mode, itn);
+		if (!p_result)
+			return nullptr;
+		while (TpassOfflineSegment(tpass_stream, tpass_online_stream, punc_cache, hw_emb, itn, dec_handle, svs_lang, svs_itn, p_result)){
 		}
+		return p_result;
+	}
+
+	_FUNASRAPI FUNASR_RESULT FunTpassOnlineInferBuffer(FUNASR_HANDLE handle, FUNASR_HANDLE online_handle, const char* sz_buf, 
+												 int n_len, std::vector<std::vector<std::string>> &punc_cache, bool input_finished, 
+												 int sampling_rate, std::string wav_format, ASR_TYPE mode, bool itn)
+	{
+		return TpassFirstPass((funasr::TpassStream*)handle, (funasr::TpassOnlineStream*)online_handle, sz_buf, n_len,
+							  punc_cache, input_finished, sampling_rate, wav_format, mode, itn);
+	}
+
+	_FUNASRAPI int FunTpassOfflinePending(FUNASR_HANDLE online_handle)
+	{
+		funasr::TpassOnlineStream* tpass_online_stream = (funasr::TpassOnlineStream*)online_handle;
+		if (!tpass_online_stream)
+			return 0;
+		return tpass_online_stream->PendingSegments();
+	}
+
+	_FUNASRAPI FUNASR_RESULT FunTpassOfflineInfer(FUNASR_HANDLE handle, FUNASR_HANDLE online_handle,
+												 std::vector<std::vector<std::string>> &punc_cache,
+												 const funasr::HotwordEmbeddingPtr &hw_emb, bool itn, FUNASR_DEC_HANDLE dec_handle,
+												 std::string svs_lang, bool svs_itn)
+	{
+		funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
+		funasr::TpassOnlineStream* tpass_online_stream = (funasr::TpassOnlineStream*)online_handle;
+		if (!tpass_stream || !tpass_online_stream || tpass_online_stream->PendingSegments() == 0)
+			return nullptr;
 
+		funasr::FUNASR_RECOG_RESULT* p_result = new funasr::FUNASR_RECOG_RESULT;
+		p_result->snippet_time = 0;
+		if (!TpassOfflineSegment(tpass_stream, tpass_online_stream, punc_cache, hw_emb, itn, dec_handle, svs_lang, svs_itn, p_result)){
+			delete p_result;
+			return nullptr;
+		}
 		return p_result;
 	}
 
+	_FUNASRAPI FUNASR_BATCH_STATS FunTpassGetBatchStats(FUNASR_HANDLE handle, ASR_TYPE mode)
+	{
+		FUNASR_BATCH_STATS stats = {0, 0, 0, 0, 0.0f, 0.0f};
+		funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
+		if (!tpass_stream || !tpass_stream->batcher_handle)
+			return stats;
+		if (mode == ASR_ONLINE) {
+			funasr::Paraformer* para_handle = (funasr::Paraformer*)(tpass_stream->asr_handle).get();
+			if (!para_handle->online_scheduler_)
+				return stats;
+			return para_handle->online_scheduler_->GetEncoderStats();
+		}
+		return tpass_stream->batcher_handle->GetStats();
+	}
+
+	_FUNASRAPI FUNASR_BATCH_STATS FunTpassGetVadBatchStats(FUNASR_HANDLE handle)
+	{
+		FUNASR_BATCH_STATS stats = {0, 0, 0, 0, 0.0f, 0.0f};
+		funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
+		if (!tpass_stream || !tpass_stream->UseVad())
+			return stats;
+		funasr::FsmnVad* vad_handle = (funasr::FsmnVad*)(tpass_stream->vad_handle).get();
+		if (!vad_handle->online_scheduler_)
+			return stats;
+		return vad_handle->online_scheduler_->GetStats();
+	}
+
+	_FUNASRAPI void FunTpassSetVadEnergyGate(FUNASR_HANDLE handle, float decibel_floor)
+	{
+		funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
+		if (tpass_stream && tpass_stream->UseVad())
+			tpass_stream->vad_handle->SetEnergyGate(decibel_floor);
+	}
+
 	_FUNASRAPI const int FunASRGetRetNumber(FUNASR_RESULT result)
 	{
 		if (!result)
@@ -796,6 +1015,16 @@
 		delete offline_stream;
 	}
 
+	_FUNASRAPI void FunOfflineIncrementalUninit(FUNASR_HANDLE incremental_handle)
+	{
+		funasr::OfflineIncrementalStream* incremental_stream = (funasr::OfflineIncrementalStream*)incremental_handle;
+
+		if (!incremental_stream)
+			return;
+
+		delete incremental_stream;
+	}
+
 	_FUNASRAPI void FunTpassUninit(FUNASR_HANDLE handle)
 	{
 		funasr::TpassStream* tpass_stream = (funasr::TpassStream*)handle;
@@ -825,7 +1054,8 @@
 			if(paraformer !=nullptr){
 				if (paraformer->lm_){
 					mm = new funasr::WfstDecoder(paraformer->lm_.get(),
-						paraformer->GetPhoneSet(), paraformer->GetLmVocab(), glob_beam, lat_beam, am_scale);
+						paraformer->GetPhoneSet(), paraformer->GetLmVocab(), glob_beam, lat_beam, am_scale,
+						paraformer->GetHotwordCache());
 				}
 				return mm;
 			}
@@ -834,7 +1064,8 @@
 			if(paraformer_torch !=nullptr){
 				if (paraformer_torch->lm_){
 					mm = new funasr::WfstDecoder(paraformer_torch->lm_.get(),
-						paraformer_torch->GetPhoneSet(), paraformer_torch->GetLmVocab(), glob_beam, lat_beam, am_scale);
+						paraformer_torch->GetPhoneSet(), paraformer_torch->GetLmVocab(), glob_beam, lat_beam, am_scale,
+						paraformer_torch->GetHotwordCache());
 				}
 				return mm;
 			}
@@ -846,7 +1077,8 @@
 			if(paraformer !=nullptr){
 				if (paraformer->lm_){
 					mm = new funasr::WfstDecoder(paraformer->lm_.get(),
-						paraformer->GetPhoneSet(), paraformer->GetLmVocab(), glob_beam, lat_beam, am_scale);
+						paraformer->GetPhoneSet(), paraformer->GetLmVocab(), glob_beam, lat_beam, am_scale,
+						paraformer->GetHotwordCache());
 				}
 				return mm;
 			}
@@ -855,7 +1087,8 @@
 			if(paraformer_torch !=nullptr){
 				if (paraformer_torch->lm_){
 					mm = new funasr::WfstDecoder(paraformer_torch->lm_.get(),
-						paraformer_torch->GetPhoneSet(), paraformer_torch->GetLmVocab(), glob_beam, lat_beam, am_scale);
+						paraformer_torch->GetPhoneSet(), paraformer_torch->GetLmVocab(), glob_beam, lat_beam, am_scale,
+						paraformer_torch->GetHotwordCache());
 				}
 				return mm;
 			}
@@ -0,0 +1,78 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+#include "precomp.h"
+#include <algorithm>
+
+namespace funasr {
+
+HotwordCache::HotwordCache(long long emb_bytes, long long bias_lm_bytes)
+:emb_cache_(emb_bytes),
+ bias_lm_cache_(bias_lm_bytes){
+}
+
+void HotwordCache::SetLimit(long long emb_bytes, long long bias_lm_bytes)
+{
+    emb_cache_.SetMaxBytes(emb_bytes);
+    bias_lm_cache_.SetMaxBytes(bias_lm_bytes);
+    LOG(INFO) << "hotword cache limit, embedding: " << emb_bytes << " bytes, bias lm: " << bias_lm_bytes << " bytes";
+}
+
+std::string HotwordCache::NormalizeHotwords(const std::string &hotwords)
+{
+    std::vector<std::string> words;
+    std::istringstream iss(hotwords);
+    std::string word;
+    while(iss >> word){
+        words.push_back(word);
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    std::string normalized;
+    for(auto &item : words){
+        if(!normalized.empty()){
+            normalized += " ";
+        }
+        normalized += item;
+    }
+    return normalized;
+}
+
+HotwordEmbeddingPtr HotwordCache::GetEmbedding(const std::string &hotwords, const CompileFn &compile)
+{
+    std::string key = NormalizeHotwords(hotwords);
+    HotwordEmbeddingPtr built = nullptr;
+    HotwordEmbeddingPtr emb = emb_cache_.GetOrBuild(key,
+        [&key, &compile, &built](size_t &bytes){
+            std::string normalized = key;
+            built = std::make_shared<const HotwordEmbedding>(compile(normalized));
+            bytes = built->Size() * sizeof(float);
+            // a failed compile gives no rows, it is handed out but not kept
+            return built->Empty() ? nullptr : built;
+        });
+    return emb ? emb : built;
+}
+
+std::shared_ptr<BiasLm> HotwordCache::GetBiasLm(const std::unordered_map<std::string, int> &hws_map, int inc_bias,
+                                                const BuildBiasLmFn &build)
+{
+    std::vector<std::pair<std::string, int>> items(hws_map.begin(), hws_map.end());
+    std::sort(items.begin(), items.end());
+    std::string key = std::to_string(inc_bias);
+    for(auto &item : items){
+        key += "\n" + item.first + "\t" + std::to_string(item.second);
+    }
+    return bias_lm_cache_.GetOrBuild(key,
+        [&build](size_t &bytes){
+            std::shared_ptr<BiasLm> bias_lm = build();
+            if(bias_lm){
+                bytes = bias_lm->MemoryBytes();
+            }
+            return bias_lm;
+        });
+}
+
+} // namespace funasr
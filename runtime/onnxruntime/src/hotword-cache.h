@@ -0,0 +1,157 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "funasrruntime.h"
+
+namespace funasr {
+
+    class BiasLm;
+
+    template <typename Value>
+    class LruCache {
+    /**
+     * Map from a key string to a shared value, bounded by the bytes of the
+     * cached values and dropping the least recently used first. Values are
+     * built outside the lock, when two callers miss the same key at once the
+     * first insert wins and both get that value.
+    */
+    public:
+        // build sets bytes to the memory held by the value it returns
+        typedef std::function<std::shared_ptr<Value>(size_t &bytes)> BuildFn;
+
+        explicit LruCache(long long max_bytes)
+        :max_bytes_(max_bytes){
+        }
+
+        std::shared_ptr<Value> GetOrBuild(const std::string &key, const BuildFn &build)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                std::shared_ptr<Value> value = FindLocked(key);
+                if(value){
+                    hits_++;
+                    return value;
+                }
+                misses_++;
+            }
+
+            size_t bytes = 0;
+            std::shared_ptr<Value> value = build(bytes);
+            if(!value){
+                return value;
+            }
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            std::shared_ptr<Value> cached = FindLocked(key);
+            if(cached){
+                return cached;
+            }
+            if((long long)bytes > max_bytes_){
+                return value;
+            }
+            entries_.push_front(Entry{key, value, bytes});
+            index_[key] = entries_.begin();
+            bytes_ += bytes;
+            ShrinkLocked();
+            return value;
+        }
+
+        void SetMaxBytes(long long max_bytes)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            max_bytes_ = max_bytes;
+            ShrinkLocked();
+        }
+
+        FUNASR_CACHE_STATS GetStats()
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            FUNASR_CACHE_STATS stats;
+            stats.hits = hits_;
+            stats.misses = misses_;
+            stats.evictions = evictions_;
+            stats.entries = (int)entries_.size();
+            stats.bytes = bytes_;
+            stats.max_bytes = max_bytes_;
+            return stats;
+        }
+
+    private:
+        struct Entry {
+            std::string key;
+            std::shared_ptr<Value> value;
+            size_t bytes;
+        };
+
+        std::shared_ptr<Value> FindLocked(const std::string &key)
+        {
+            auto it = index_.find(key);
+            if(it == index_.end()){
+                return nullptr;
+            }
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->value;
+        }
+
+        void ShrinkLocked()
+        {
+            while(bytes_ > max_bytes_ && !entries_.empty()){
+                Entry &entry = entries_.back();
+                bytes_ -= entry.bytes;
+                index_.erase(entry.key);
+                entries_.pop_back();
+                evictions_++;
+            }
+        }
+
+        std::mutex mtx_;
+        std::list<Entry> entries_;  // most recently used first
+        std::unordered_map<std::string, typename std::list<Entry>::iterator> index_;
+        long long max_bytes_ = 0;
+        long long bytes_ = 0;
+        long long hits_ = 0;
+        long long misses_ = 0;
+        long long evictions_ = 0;
+    };
+
+    class HotwordCache {
+    /**
+     * Compiled hotword resources of one asr model, shared by every connection
+     * decoding with it: the nn embeddings of CompileHotwordEmbedding and the
+     * wfst BiasLm graphs. Both are keyed by the normalized hotword set, so
+     * connections sending the same hotwords in any order or with the global
+     * hotword file merged in the same way reuse one compiled copy.
+    */
+    public:
+        typedef std::function<std::vector<std::vector<float>>(std::string &hotwords)> CompileFn;
+        typedef std::function<std::shared_ptr<BiasLm>()> BuildBiasLmFn;
+
+        HotwordCache(long long emb_bytes=64LL<<20, long long bias_lm_bytes=256LL<<20);
+
+        void SetLimit(long long emb_bytes, long long bias_lm_bytes);
+        // compile is called with the normalized hotwords on a miss
+        HotwordEmbeddingPtr GetEmbedding(const std::string &hotwords, const CompileFn &compile);
+        std::shared_ptr<BiasLm> GetBiasLm(const std::unordered_map<std::string, int> &hws_map, int inc_bias,
+                                          const BuildBiasLmFn &build);
+        FUNASR_CACHE_STATS GetEmbeddingStats() {return emb_cache_.GetStats();};
+        FUNASR_CACHE_STATS GetBiasLmStats() {return bias_lm_cache_.GetStats();};
+
+        // space separated hotwords, sorted and without duplicates
+        static std::string NormalizeHotwords(const std::string &hotwords);
+
+    private:
+        LruCache<const HotwordEmbedding> emb_cache_;
+        LruCache<BiasLm> bias_lm_cache_;
+    };
+
+} // namespace funasr
@@ -0,0 +1,150 @@
+#include "precomp.h"
+
+namespace funasr {
+OfflineIncrementalStream::OfflineIncrementalStream(OfflineStream* offline_stream)
+:offline_stream_(offline_stream){
+    dest_sample_rate_ = (offline_stream->asr_handle)->GetAsrSampleRate();
+    if(offline_stream->UseVad()){
+        vad_online_handle_ = make_unique<FsmnVadOnline>((FsmnVad*)(offline_stream->vad_handle).get());
+    }
+}
+
+OfflineIncrementalStream::~OfflineIncrementalStream(){
+}
+
+void OfflineIncrementalStream::AcceptPcm(const char* buf, int n_len, int sampling_rate, bool input_finished)
+{
+    const uint8_t* byte_buf = reinterpret_cast<const uint8_t*>(buf);
+    std::vector<float> pcm;
+    pcm.reserve(n_len / 2 + 1);
+    int i = 0;
+    if(has_odd_byte_ && n_len > 0){
+        int16_t val = (int16_t)((byte_buf[0] << 8) | odd_byte_);
+        pcm.push_back((float)val / 32768.0f);
+        has_odd_byte_ = false;
+        i = 1;
+    }
+    for(; i + 1 < n_len; i += 2){
+        int16_t val = (int16_t)((byte_buf[i + 1] << 8) | byte_buf[i]);
+        pcm.push_back((float)val / 32768.0f);
+    }
+    if(i < n_len){
+        odd_byte_ = byte_buf[i];
+        has_odd_byte_ = true;
+    }
+
+    //resample, the filter runs across the pieces and is flushed at the end
+    if(sampling_rate != dest_sample_rate_){
+        if(!resampler_ || resampler_->GetInputSamplingRate() != sampling_rate){
+            float min_freq = std::min<int32_t>(sampling_rate, dest_sample_rate_);
+            float lowpass_cutoff = 0.99 * 0.5 * min_freq;
+            int32_t lowpass_filter_width = 6;
+            resampler_ = std::make_unique<LinearResample>(
+                sampling_rate, dest_sample_rate_, lowpass_cutoff, lowpass_filter_width);
+        }
+        std::vector<float> samples;
+        resampler_->Resample(pcm.data(), pcm.size(), input_finished, &samples);
+        pcm.swap(samples);
+    }
+    samples_.Append(pcm.data(), pcm.size());
+}
+
+void OfflineIncrementalStream::Decode(bool input_finished, const HotwordEmbeddingPtr &hw_emb, void* dec_handle,
+                                      std::string svs_lang, bool svs_itn)
+{
+    if(!vad_online_handle_){
+        // without vad the whole input is one segment
+        if(input_finished && samples_.End() > 0){
+            segments_.emplace_back(0, samples_.End());
+            DecodeSegments(hw_emb, dec_handle, svs_lang, svs_itn);
+        }
+        return;
+    }
+
+    // the steps of Audio::CutSplit: one second while more than a second and a
+    // sample are left, the rest as the final step
+    int step = dest_sample_rate_;
+    while(true){
+        int remaining = samples_.End() - vad_offset_;
+        if(remaining <= 0 || (!input_finished && remaining <= step + 1)){
+            break;
+        }
+        int cur_step = step;
+        bool is_final = false;
+        if(vad_offset_ + step >= samples_.End() - 1){
+            cur_step = remaining;
+            is_final = true;
+        }
+        const float* pcm_begin = samples_.Data(vad_offset_);
+        std::vector<float> pcm_data(pcm_begin, pcm_begin + cur_step);
+        vad_offset_ += cur_step;
+
+        vector<std::vector<int>> vad_segments = vad_online_handle_->Infer(pcm_data, is_final);
+        for(vector<int> &vad_segment : vad_segments){
+            if(vad_segment.size() != 2){
+                LOG(ERROR) << "Size of vad_segment is not 2.";
+                break;
+            }
+            if(vad_segment[0] != -1){
+                speech_start_ = vad_segment[0];
+            }
+            if(vad_segment[1] != -1){
+                speech_end_ = vad_segment[1];
+            }
+            if(speech_start_ != -1 && speech_end_ != -1){
+                int start = std::max(speech_start_ * seg_sample_, samples_.Begin());
+                int end = std::min(speech_end_ * seg_sample_, samples_.End());
+                if(end > start){
+                    segments_.emplace_back(start, end);
+                }
+                speech_start_ = -1;
+                speech_end_ = -1;
+            }
+        }
+    }
+    DecodeSegments(hw_emb, dec_handle, svs_lang, svs_itn);
+}
+
+void OfflineIncrementalStream::DecodeSegments(const HotwordEmbeddingPtr &hw_emb, void* dec_handle,
+                                              std::string svs_lang, bool svs_itn)
+{
+    int batch_size = std::max((offline_stream_->asr_handle)->GetBatchSize(), 1);
+    size_t next = 0;
+    while(next < segments_.size()){
+        int batch_in = std::min(batch_size, (int)(segments_.size() - next));
+        std::vector<float*> buff(batch_in);
+        std::vector<int> len(batch_in);
+        for(int idx=0; idx<batch_in; idx++){
+            buff[idx] = samples_.Data(segments_[next + idx].first);
+            len[idx] = segments_[next + idx].second - segments_[next + idx].first;
+        }
+        // dec reset
+        WfstDecoder* wfst_decoder = (WfstDecoder*)dec_handle;
+        if (wfst_decoder){
+            wfst_decoder->StartUtterance();
+        }
+        vector<string> msg_batch;
+        if(offline_stream_->GetModelType() == MODEL_SVS){
+            msg_batch = (offline_stream_->asr_handle)->Forward(buff.data(), len.data(), true, svs_lang, svs_itn, batch_in);
+        }else{
+            msg_batch = (offline_stream_->asr_handle)->Forward(buff.data(), len.data(), true, hw_emb, dec_handle, batch_in);
+        }
+        for(int idx=0; idx<batch_in; idx++){
+            msgs.push_back(idx < msg_batch.size() ? msg_batch[idx] : "");
+            msg_stimes.push_back((float)segments_[next + idx].first / dest_sample_rate_);
+        }
+        next += batch_in;
+    }
+    if(!segments_.empty()){
+        // later segments start after the last one ends
+        samples_.Discard(segments_.back().second);
+        segments_.clear();
+    }
+}
+
+OfflineIncrementalStream* CreateOfflineIncrementalStream(void* offline_stream)
+{
+    return new OfflineIncrementalStream((OfflineStream*)offline_stream);
+}
+
+} // namespace funasr
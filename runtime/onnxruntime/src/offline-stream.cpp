@@ -44,6 +44,7 @@ OfflineStream::OfflineStream(std::map<std::string, std::string>& model_path, int
             #else
             LOG(ERROR) <<"GPU is not supported! CPU will be used! If you want to use GPU, please add -DGPU=ON when cmake";
             asr_handle = make_unique<Paraformer>();
+            asr_handle->SetBatchSize(batch_size);
             use_gpu = false;
             #endif
         }else{
@@ -53,6 +54,7 @@ OfflineStream::OfflineStream(std::map<std::string, std::string>& model_path, int
                 model_type = MODEL_SVS;
             }else{
                 asr_handle = make_unique<Paraformer>();
+                asr_handle->SetBatchSize(batch_size);
             }
         }
 
@@ -0,0 +1,275 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+#include "precomp.h"
+
+namespace funasr {
+
+ParaformerOnlineScheduler::ParaformerOnlineScheduler(std::shared_ptr<Ort::Session> encoder_session,
+                                                     std::shared_ptr<Ort::Session> decoder_session,
+                                                     const vector<const char*> &en_szInputNames,
+                                                     const vector<const char*> &en_szOutputNames,
+                                                     const vector<const char*> &de_szInputNames,
+                                                     const vector<const char*> &de_szOutputNames,
+                                                     int fsmn_layers, int fsmn_dims, int max_batch, int max_wait_ms)
+:encoder_session_(encoder_session),
+ decoder_session_(decoder_session),
+ en_szInputNames_(en_szInputNames),
+ en_szOutputNames_(en_szOutputNames),
+ de_szInputNames_(de_szInputNames),
+ de_szOutputNames_(de_szOutputNames),
+ fsmn_layers_(fsmn_layers),
+ fsmn_dims_(fsmn_dims),
+ encoder_queue_(max_batch, max_wait_ms),
+ decoder_queue_(max_batch, max_wait_ms){
+    LOG(INFO) << "online chunk batching enabled, max batch: " << encoder_queue_.GetMaxBatch() << ", max wait: " << encoder_queue_.GetMaxWaitMs() << " ms";
+}
+
+void ParaformerOnlineScheduler::RunEncode(std::vector<EncodeTask*> &batch)
+{
+    try{
+        int batch_in = batch.size();
+        int num_frames = batch[0]->num_frames;
+        int feat_dim = batch[0]->feat_dim;
+    #ifdef _WIN_X86
+        Ort::MemoryInfo m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    #else
+        Ort::MemoryInfo m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    #endif
+        std::vector<float> wav_feats;
+        wav_feats.reserve(batch_in * num_frames * feat_dim);
+        std::vector<int32_t> paraformer_length(batch_in, num_frames);
+        for (auto task : batch) {
+            wav_feats.insert(wav_feats.end(), task->feats->begin(), task->feats->end());
+        }
+        const int64_t input_shape_[3] = {batch_in, num_frames, feat_dim};
+        Ort::Value onnx_feats = Ort::Value::CreateTensor<float>(
+            m_memoryInfo, wav_feats.data(), wav_feats.size(), input_shape_, 3);
+        const int64_t paraformer_length_shape[1] = {batch_in};
+        Ort::Value onnx_feats_len = Ort::Value::CreateTensor<int32_t>(
+            m_memoryInfo, paraformer_length.data(), paraformer_length.size(), paraformer_length_shape, 1);
+
+        std::vector<Ort::Value> input_onnx;
+        input_onnx.emplace_back(std::move(onnx_feats));
+        input_onnx.emplace_back(std::move(onnx_feats_len));
+
+        auto encoder_tensor = RunSession(*encoder_session_, en_szInputNames_.data(), input_onnx.data(), input_onnx.size(), en_szOutputNames_.data(), en_szOutputNames_.size());
+
+        std::vector<int64_t> enc_shape = encoder_tensor[0].GetTensorTypeAndShapeInfo().GetShape();
+        float* enc_data = encoder_tensor[0].GetTensorMutableData<float>();
+        int enc_stride = enc_shape[1] * enc_shape[2];
+
+        ONNXTensorElementDataType len_type = encoder_tensor[1].GetTensorTypeAndShapeInfo().GetElementType();
+        enc_len_type_ = len_type;
+
+        std::vector<int64_t> alpha_shape = encoder_tensor[2].GetTensorTypeAndShapeInfo().GetShape();
+        float* alpha_data = encoder_tensor[2].GetTensorMutableData<float>();
+
+        for (int index = 0; index < batch_in; index++) {
+            EncodeTask* task = batch[index];
+            task->enc.assign(enc_data + index * enc_stride, enc_data + (index + 1) * enc_stride);
+            task->enc_frames = enc_shape[1];
+            if (len_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64) {
+                task->enc_len = encoder_tensor[1].GetTensorMutableData<int64_t>()[index];
+            } else {
+                task->enc_len = encoder_tensor[1].GetTensorMutableData<int32_t>()[index];
+            }
+            task->alphas.assign(alpha_data + index * alpha_shape[1], alpha_data + (index + 1) * alpha_shape[1]);
+            task->ok = true;
+        }
+    }catch (std::exception const &e)
+    {
+        LOG(ERROR)<<e.what();
+    }
+}
+
+void ParaformerOnlineScheduler::RunDecode(std::vector<DecodeTask*> &batch)
+{
+    try{
+        int batch_in = batch.size();
+        int enc_frames = batch[0]->enc_frames;
+        int emb_len = 0;
+        for (auto task : batch) {
+            emb_len = std::max(emb_len, task->emb_len);
+        }
+        int enc_dim = batch[0]->enc->size() / enc_frames;
+        int emb_dim = batch[0]->emb->size() / batch[0]->emb_len;
+    #ifdef _WIN_X86
+        Ort::MemoryInfo m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    #else
+        Ort::MemoryInfo m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    #endif
+        std::vector<Ort::Value> decoder_onnx;
+
+        // enc
+        std::vector<float> enc_input;
+        enc_input.reserve(batch_in * enc_frames * enc_dim);
+        for (auto task : batch) {
+            enc_input.insert(enc_input.end(), task->enc->begin(), task->enc->end());
+        }
+        const int64_t enc_shape_[3] = {batch_in, enc_frames, enc_dim};
+        decoder_onnx.emplace_back(Ort::Value::CreateTensor<float>(
+            m_memoryInfo, enc_input.data(), enc_input.size(), enc_shape_, 3));
+
+        // enc_lens, same element type as the encoder produced
+        const int64_t batch_shape_[1] = {batch_in};
+        std::vector<int32_t> enc_len32(batch_in);
+        std::vector<int64_t> enc_len64(batch_in);
+        for (int index = 0; index < batch_in; index++) {
+            enc_len32[index] = batch[index]->enc_len;
+            enc_len64[index] = batch[index]->enc_len;
+        }
+        if (enc_len_type_ == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64) {
+            decoder_onnx.emplace_back(Ort::Value::CreateTensor<int64_t>(
+                m_memoryInfo, enc_len64.data(), enc_len64.size(), batch_shape_, 1));
+        } else {
+            decoder_onnx.emplace_back(Ort::Value::CreateTensor<int32_t>(
+                m_memoryInfo, enc_len32.data(), enc_len32.size(), batch_shape_, 1));
+        }
+
+        // acoustic_embeds, zero padded to the longest of the batch
+        std::vector<float> emb_input((size_t)batch_in * emb_len * emb_dim, 0.0f);
+        for (int index = 0; index < batch_in; index++) {
+            std::copy(batch[index]->emb->begin(), batch[index]->emb->end(),
+                      emb_input.begin() + (size_t)index * emb_len * emb_dim);
+        }
+        const int64_t emb_shape_[3] = {batch_in, emb_len, emb_dim};
+        decoder_onnx.emplace_back(Ort::Value::CreateTensor<float>(
+            m_memoryInfo, emb_input.data(), emb_input.size(), emb_shape_, 3));
+
+        // acoustic_embeds_len, the real lengths mask the padding
+        std::vector<int32_t> emb_length(batch_in);
+        for (int index = 0; index < batch_in; index++) {
+            emb_length[index] = batch[index]->emb_len;
+        }
+        decoder_onnx.emplace_back(Ort::Value::CreateTensor<int32_t>(
+            m_memoryInfo, emb_length.data(), emb_length.size(), batch_shape_, 1));
+
+        // fsmn caches
+        std::vector<std::vector<float>> fsmn_input(fsmn_layers_);
+        for (int l = 0; l < fsmn_layers_; l++) {
+            int cache_size = (*(batch[0]->fsmn_cache))[l].size();
+            fsmn_input[l].reserve(batch_in * cache_size);
+            for (auto task : batch) {
+                fsmn_input[l].insert(fsmn_input[l].end(), (*(task->fsmn_cache))[l].begin(), (*(task->fsmn_cache))[l].end());
+            }
+        }
+        for (int l = 0; l < fsmn_layers_; l++) {
+            const int64_t fsmn_shape_[3] = {batch_in, fsmn_dims_, (int64_t)(*(batch[0]->fsmn_cache))[l].size() / fsmn_dims_};
+            decoder_onnx.emplace_back(Ort::Value::CreateTensor<float>(
+                m_memoryInfo, fsmn_input[l].data(), fsmn_input[l].size(), fsmn_shape_, 3));
+        }
+
+        auto decoder_tensor = RunSession(*decoder_session_, de_szInputNames_.data(), decoder_onnx.data(), decoder_onnx.size(), de_szOutputNames_.data(), de_szOutputNames_.size());
+
+        std::vector<int64_t> decoder_shape = decoder_tensor[0].GetTensorTypeAndShapeInfo().GetShape();
+        float* float_data = decoder_tensor[0].GetTensorMutableData<float>();
+        int logits_stride = decoder_shape[1] * decoder_shape[2];
+        for (int index = 0; index < batch_in; index++) {
+            DecodeTask* task = batch[index];
+            const float* logits_data = float_data + (size_t)index * logits_stride;
+            task->logits.assign(logits_data, logits_data + (size_t)task->emb_len * decoder_shape[2]);
+            task->vocab_size = decoder_shape[2];
+        }
+        for (int l = 0; l < fsmn_layers_; l++) {
+            std::vector<int64_t> cache_shape = decoder_tensor[2+l].GetTensorTypeAndShapeInfo().GetShape();
+            float* cache_data = decoder_tensor[2+l].GetTensorMutableData<float>();
+            int cache_dims = cache_shape[1];
+            int cache_frames = cache_shape[2];
+            int cache_stride = cache_dims * cache_frames;
+            for (int index = 0; index < batch_in; index++) {
+                std::vector<float> &cache = (*(batch[index]->fsmn_cache))[l];
+                const float* out_cache = cache_data + (size_t)index * cache_stride;
+                int len = batch[index]->emb_len;
+                int pad = emb_len - len;
+                if (pad == 0) {
+                    cache.assign(out_cache, out_cache + cache_stride);
+                    continue;
+                }
+                // the out cache is the last cache_frames of [in cache, input, padding]. Without
+                // the padding they are the in cache shifted by len, then the len input frames,
+                // which sit right before the padding (Decode keeps len + pad <= cache_frames)
+                const float* in_cache = fsmn_input[l].data() + (size_t)index * cache_stride;
+                cache.resize(cache_stride);
+                for (int d = 0; d < cache_dims; d++) {
+                    float* row = cache.data() + (size_t)d * cache_frames;
+                    const float* in_row = in_cache + (size_t)d * cache_frames;
+                    const float* out_row = out_cache + (size_t)d * cache_frames;
+                    std::copy(in_row + len, in_row + cache_frames, row);
+                    std::copy(out_row + cache_frames - len - pad, out_row + cache_frames - pad,
+                              row + cache_frames - len);
+                }
+            }
+        }
+        for (auto task : batch) {
+            task->ok = true;
+        }
+    }catch (std::exception const &e)
+    {
+        LOG(ERROR)<<e.what();
+    }
+}
+
+bool ParaformerOnlineScheduler::Encode(const std::vector<float> &feats, int num_frames, int feat_dim,
+                                       std::vector<float> &enc, int &enc_frames, int &enc_len, std::vector<float> &alphas)
+{
+    EncodeTask task;
+    task.feats = &feats;
+    task.num_frames = num_frames;
+    task.feat_dim = feat_dim;
+    // the encoder keeps no state across chunks, only equally sized chunks are stacked
+    encoder_queue_.Submit(task,
+        [](const std::vector<EncodeTask*> &batch, const EncodeTask &item){
+            return item.num_frames == batch[0]->num_frames && item.feat_dim == batch[0]->feat_dim;
+        },
+        [this](std::vector<EncodeTask*> &batch){ RunEncode(batch); });
+    if (task.ok) {
+        enc.swap(task.enc);
+        enc_frames = task.enc_frames;
+        enc_len = task.enc_len;
+        alphas.swap(task.alphas);
+    }
+    return task.ok;
+}
+
+bool ParaformerOnlineScheduler::Decode(const std::vector<float> &enc, int enc_frames, int enc_len,
+                                       const std::vector<float> &emb, int emb_len,
+                                       std::vector<std::vector<float>> &fsmn_cache, std::vector<float> &logits, int &vocab_size)
+{
+    DecodeTask task;
+    task.enc = &enc;
+    task.enc_frames = enc_frames;
+    task.enc_len = enc_len;
+    task.emb = &emb;
+    task.emb_len = emb_len;
+    task.fsmn_cache = &fsmn_cache;
+    // the acoustic embeddings are padded to the longest chunk of the batch.
+    // The decoder fsmn is causal, so the padding only reaches the caches, and
+    // RunDecode restores those from the in caches while the longest chunk fits
+    // in the cache frames. Longer chunks only join chunks of their own length
+    int cache_frames = fsmn_cache.empty() ? 0 : fsmn_cache[0].size() / fsmn_dims_;
+    decoder_queue_.Submit(task,
+        [cache_frames](const std::vector<DecodeTask*> &batch, const DecodeTask &item){
+            if (item.enc_frames != batch[0]->enc_frames || item.enc->size() != batch[0]->enc->size()
+                || item.emb->size() / item.emb_len != batch[0]->emb->size() / batch[0]->emb_len) {
+                return false;
+            }
+            int max_len = item.emb_len;
+            bool same_len = true;
+            for (auto task : batch) {
+                max_len = std::max(max_len, task->emb_len);
+                same_len = same_len && task->emb_len == item.emb_len;
+            }
+            return same_len || max_len <= cache_frames;
+        },
+        [this](std::vector<DecodeTask*> &batch){ RunDecode(batch); });
+    if (task.ok) {
+        logits.swap(task.logits);
+        vocab_size = task.vocab_size;
+    }
+    return task.ok;
+}
+
+} // namespace funasr
@@ -0,0 +1,83 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include <atomic>
+#include "batch-queue.h"
+
+namespace funasr {
+
+    class ParaformerOnlineScheduler {
+    /**
+     * Cross-stream batching of streaming Paraformer chunks.
+     * Every ParaformerOnline stream sharing one Paraformer submits its chunk
+     * here; chunks of concurrent streams are stacked along the batch axis and
+     * run by one encoder/decoder call. Encoder chunks are only grouped when
+     * their shapes match. Decoder chunks may differ in the number of fired
+     * tokens: their acoustic embeddings are padded and the FSMN caches of the
+     * shorter ones are restored after the run.
+    */
+    public:
+        ParaformerOnlineScheduler(std::shared_ptr<Ort::Session> encoder_session,
+                                  std::shared_ptr<Ort::Session> decoder_session,
+                                  const vector<const char*> &en_szInputNames,
+                                  const vector<const char*> &en_szOutputNames,
+                                  const vector<const char*> &de_szInputNames,
+                                  const vector<const char*> &de_szOutputNames,
+                                  int fsmn_layers, int fsmn_dims, int max_batch, int max_wait_ms);
+        ~ParaformerOnlineScheduler(){};
+
+        // feats: [num_frames, feat_dim]; enc: [enc_frames, encoder_size]; alphas: [enc_frames]
+        bool Encode(const std::vector<float> &feats, int num_frames, int feat_dim,
+                    std::vector<float> &enc, int &enc_frames, int &enc_len, std::vector<float> &alphas);
+        // emb: [emb_len, encoder_size]; fsmn_cache: fsmn_layers x [fsmn_dims * fsmn_lorder], updated in place
+        bool Decode(const std::vector<float> &enc, int enc_frames, int enc_len,
+                    const std::vector<float> &emb, int emb_len,
+                    std::vector<std::vector<float>> &fsmn_cache, std::vector<float> &logits, int &vocab_size);
+
+        FUNASR_BATCH_STATS GetEncoderStats() {return encoder_queue_.GetStats();};
+        FUNASR_BATCH_STATS GetDecoderStats() {return decoder_queue_.GetStats();};
+
+    private:
+        struct EncodeTask {
+            const std::vector<float>* feats = nullptr;
+            int num_frames = 0;
+            int feat_dim = 0;
+            std::vector<float> enc;
+            int enc_frames = 0;
+            int enc_len = 0;
+            std::vector<float> alphas;
+            bool ok = false;
+        };
+        struct DecodeTask {
+            const std::vector<float>* enc = nullptr;
+            int enc_frames = 0;
+            int enc_len = 0;
+            const std::vector<float>* emb = nullptr;
+            int emb_len = 0;
+            std::vector<std::vector<float>>* fsmn_cache = nullptr;
+            std::vector<float> logits;
+            int vocab_size = 0;
+            bool ok = false;
+        };
+        void RunEncode(std::vector<EncodeTask*> &batch);
+        void RunDecode(std::vector<DecodeTask*> &batch);
+
+        std::shared_ptr<Ort::Session> encoder_session_ = nullptr;
+        std::shared_ptr<Ort::Session> decoder_session_ = nullptr;
+        vector<const char*> en_szInputNames_;
+        vector<const char*> en_szOutputNames_;
+        vector<const char*> de_szInputNames_;
+        vector<const char*> de_szOutputNames_;
+        int fsmn_layers_ = 16;
+        int fsmn_dims_ = 512;
+        // element type of the encoder's enc_len output, fed back to the decoder
+        std::atomic<int> enc_len_type_{ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32};
+
+        BatchQueue<EncodeTask> encoder_queue_;
+        BatchQueue<DecodeTask> decoder_queue_;
+    };
+
+} // namespace funasr
@@ -34,6 +34,7 @@ ParaformerOnline::ParaformerOnline(Model* offline_handle, std::vector<int> chunk
         para_handle->fsmn_dims,
         para_handle->cif_threshold,
         para_handle->tail_alphas);
+        scheduler_ = para_handle->online_scheduler_.get();
     }else if(model_type == MODEL_SVS){
         SenseVoiceSmall* svs_handle = dynamic_cast<SenseVoiceSmall*>(offline_handle_);
         InitOnline(
@@ -83,6 +84,7 @@ void ParaformerOnline::InitOnline(
         float cif_threshold_,
         float tail_alphas_){
     fbank_opts_ = fbank_opts;
+    fbank_plan_ = FbankPlan::Get(fbank_opts_);
     encoder_session_ = encoder_session;
     decoder_session_ = decoder_session;
     en_szInputNames_ = en_szInputNames;
@@ -118,7 +120,6 @@ void ParaformerOnline::InitOnline(
 
 void ParaformerOnline::FbankKaldi(float sample_rate, std::vector<std::vector<float>> &wav_feats,
                                std::vector<float> &waves) {
-    knf::OnlineFbank fbank(fbank_opts_);
     // cache merge
     waves.insert(waves.begin(), input_cache_.begin(), input_cache_.end());
     int frame_number = ComputeFrameNum(waves.size(), frame_sample_length_, frame_shift_sample_length_);
@@ -131,17 +132,7 @@ void ParaformerOnline::FbankKaldi(float sample_rate, std::vector<std::vector<flo
     // Delete audio that haven't undergone fbank processing
     waves.erase(waves.begin() + (frame_number - 1) * frame_shift_sample_length_ + frame_sample_length_, waves.end());
 
-    std::vector<float> buf(waves.size());
-    for (int32_t i = 0; i != waves.size(); ++i) {
-        buf[i] = waves[i] * 32768;
-    }
-    fbank.AcceptWaveform(sample_rate, buf.data(), buf.size());
-    int32_t frames = fbank.NumFramesReady();
-    for (int32_t i = 0; i != frames; ++i) {
-        const float *frame = fbank.GetFrame(i);
-        vector<float> frame_vector(frame, frame + fbank_opts_.mel_opts.num_bins);
-        wav_feats.emplace_back(frame_vector);
-    }
+    fbank_plan_->Compute(waves.data(), waves.size(), wav_feats);
 }
 
 void ParaformerOnline::ExtractFeats(float sample_rate, vector<std::vector<float>> &wav_feats,
@@ -194,75 +185,60 @@ void ParaformerOnline::ExtractFeats(float sample_rate, vector<std::vector<float>
 }
 
 int ParaformerOnline::OnlineLfrCmvn(vector<vector<float>> &wav_feats, bool input_finished) {
-    vector<vector<float>> out_feats;
-    int T = wav_feats.size();
-    int T_lrf = ceil((T - (lfr_m - 1) / 2) / (float)lfr_n);
-    int lfr_splice_frame_idxs = T_lrf;
-    vector<float> p;
-    for (int i = 0; i < T_lrf; i++) {
-        if (lfr_m <= T - i * lfr_n) {
-            for (int j = 0; j < lfr_m; j++) {
-                p.insert(p.end(), wav_feats[i * lfr_n + j].begin(), wav_feats[i * lfr_n + j].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        } else {
-            if (input_finished) {
-                int num_padding = lfr_m - (T - i * lfr_n);
-                for (int j = 0; j < (wav_feats.size() - i * lfr_n); j++) {
-                    p.insert(p.end(), wav_feats[i * lfr_n + j].begin(), wav_feats[i * lfr_n + j].end());
-                }
-                for (int j = 0; j < num_padding; j++) {
-                    p.insert(p.end(), wav_feats[wav_feats.size() - 1].begin(), wav_feats[wav_feats.size() - 1].end());
-                }
-                out_feats.emplace_back(p);
-                p.clear();
-            } else {
-                lfr_splice_frame_idxs = i;
-                break;
-            }
-        }
-    }
-    lfr_splice_frame_idxs = std::min(T - 1, lfr_splice_frame_idxs * lfr_n);
-    lfr_splice_cache_.clear();
-    lfr_splice_cache_.insert(lfr_splice_cache_.begin(), wav_feats.begin() + lfr_splice_frame_idxs, wav_feats.end());
-
-    // Apply cmvn
-    for (auto &out_feat: out_feats) {
-        for (int j = 0; j < means_list_.size(); j++) {
-            out_feat[j] = (out_feat[j] + means_list_[j]) * vars_list_[j];
-        }
-    }
-    wav_feats = out_feats;
-    return lfr_splice_frame_idxs;
+    return funasr::OnlineLfrCmvn(wav_feats, lfr_m, lfr_n, means_list_, vars_list_, input_finished, lfr_splice_cache_);
 }
 
+std::map<int, std::shared_ptr<const std::vector<float>>> ParaformerOnline::pos_emb_table_;
+std::mutex ParaformerOnline::pos_emb_mtx_;
+
 void ParaformerOnline::GetPosEmb(std::vector<std::vector<float>> &wav_feats, int timesteps, int feat_dim)
 {
     int start_idx = start_idx_cache_;
     start_idx_cache_ += timesteps;
     int mm = start_idx_cache_;
 
-    int i;
     float scale = -0.0330119726594128;
 
-    std::vector<float> tmp(mm*feat_dim);
-
-    for (i = 0; i < feat_dim/2; i++) {
-        float tmptime = exp(i * scale);
-        int j;
-        for (j = 0; j < mm; j++) {
-            int sin_idx = j * feat_dim + i;
-            int cos_idx = j * feat_dim + i + feat_dim/2;
-            float coe = tmptime * (j + 1);
-            tmp[sin_idx] = sin(coe);
-            tmp[cos_idx] = cos(coe);
+    std::shared_ptr<const std::vector<float>> table;
+    {
+        std::lock_guard<std::mutex> lock(pos_emb_mtx_);
+        std::shared_ptr<const std::vector<float>> &shared = pos_emb_table_[feat_dim];
+        size_t cached = shared ? shared->size() / feat_dim : 0;
+        if (cached < (size_t)mm && cached < PARA_POS_EMB_MAX_POS) {
+            // grow geometrically up to the cap and only compute the missing positions
+            size_t rows = std::min((size_t)PARA_POS_EMB_MAX_POS, std::max((size_t)mm, 2 * cached));
+            std::vector<float>* grown = new std::vector<float>(rows * feat_dim);
+            if (cached > 0) {
+                memcpy(grown->data(), shared->data(), sizeof(float) * shared->size());
+            }
+            for (int i = 0; i < feat_dim/2; i++) {
+                float tmptime = exp(i * scale);
+                for (size_t j = cached; j < rows; j++) {
+                    float coe = tmptime * (j + 1);
+                    (*grown)[j * feat_dim + i] = sin(coe);
+                    (*grown)[j * feat_dim + i + feat_dim/2] = cos(coe);
+                }
+            }
+            shared.reset(grown);
         }
+        table = shared;
     }
 
-    for (i = start_idx; i < start_idx + timesteps; i++) {
-        for (int j = 0; j < feat_dim; j++) {
-            wav_feats[i-start_idx][j] += tmp[i*feat_dim+j];
+    size_t table_rows = table->size() / feat_dim;
+    for (int i = start_idx; i < start_idx + timesteps; i++) {
+        std::vector<float> &feat = wav_feats[i-start_idx];
+        if ((size_t)i < table_rows) {
+            const float* row = table->data() + (size_t)i * feat_dim;
+            for (int j = 0; j < feat_dim; j++) {
+                feat[j] += row[j];
+            }
+        } else {
+            for (int j = 0; j < feat_dim/2; j++) {
+                float tmptime = exp(j * scale);
+                float coe = tmptime * (i + 1);
+                feat[j] += sin(coe);
+                feat[j + feat_dim/2] += cos(coe);
+            }
         }
     }
 }
@@ -353,6 +329,7 @@ void ParaformerOnline::InitCache(){
     alphas_cache_.clear();
     feats_cache_.clear();
     decoder_onnx.clear();
+    fsmn_cache_.clear();
 
     // cif cache
     std::vector<float> hidden_cache(encoder_size, 0);
@@ -366,6 +343,10 @@ void ParaformerOnline::InitCache(){
     }
 
     // fsmn cache
+    if(scheduler_ != nullptr){
+        fsmn_cache_.resize(fsmn_layers, fsmn_init_cache_);
+        return;
+    }
 #ifdef _WIN_X86
     Ort::MemoryInfo m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
 #else
@@ -412,8 +393,58 @@ void ParaformerOnline::AddOverlapChunk(std::vector<std::vector<float>> &wav_feat
     }
 }
 
+string ParaformerOnline::ForwardChunkBatched(std::vector<std::vector<float>> &chunk_feats, bool input_finished)
+{
+    string result;
+    try{
+        int32_t num_frames = chunk_feats.size();
+        std::vector<float> wav_feats;
+        wav_feats.reserve(num_frames * feat_dims);
+        for (const auto &chunk_feat: chunk_feats) {
+            wav_feats.insert(wav_feats.end(), chunk_feat.begin(), chunk_feat.end());
+        }
+
+        std::vector<float> enc;
+        std::vector<float> alpha_vec;
+        int enc_frames = 0;
+        int enc_len = 0;
+        if(!scheduler_->Encode(wav_feats, num_frames, feat_dims, enc, enc_frames, enc_len, alpha_vec) || enc_frames == 0){
+            return result;
+        }
+        int hidden_size = enc.size() / enc_frames;
+        std::vector<std::vector<float>> enc_vec(enc_frames);
+        for (int i = 0; i < enc_frames; i++) {
+            enc_vec[i].assign(enc.begin() + i * hidden_size, enc.begin() + (i + 1) * hidden_size);
+        }
+
+        std::vector<std::vector<float>> list_frame;
+        CifSearch(enc_vec, alpha_vec, input_finished, list_frame);
+
+        if(list_frame.size()>0){
+            std::vector<float> emb_input;
+            emb_input.reserve(list_frame.size() * list_frame[0].size());
+            for (const auto &list_frame_: list_frame) {
+                emb_input.insert(emb_input.end(), list_frame_.begin(), list_frame_.end());
+            }
+            std::vector<float> logits;
+            int vocab_size = 0;
+            if(scheduler_->Decode(enc, enc_frames, enc_len, emb_input, list_frame.size(), fsmn_cache_, logits, vocab_size)){
+                result = offline_handle_->GreedySearch(logits.data(), list_frame.size(), vocab_size);
+            }
+        }
+    }catch (std::exception const &e)
+    {
+        LOG(ERROR)<<e.what();
+        return result;
+    }
+    return result;
+}
+
 string ParaformerOnline::ForwardChunk(std::vector<std::vector<float>> &chunk_feats, bool input_finished)
 {
+    if(scheduler_ != nullptr){
+        return ForwardChunkBatched(chunk_feats, input_finished);
+    }
     string result;
     try{
         int32_t num_frames = chunk_feats.size();
@@ -445,7 +476,7 @@ string ParaformerOnline::ForwardChunk(std::vector<std::vector<float>> &chunk_fea
         input_onnx.emplace_back(std::move(onnx_feats));
         input_onnx.emplace_back(std::move(onnx_feats_len)); 
         
-        auto encoder_tensor = encoder_session_->Run(Ort::RunOptions{nullptr}, en_szInputNames_.data(), input_onnx.data(), input_onnx.size(), en_szOutputNames_.data(), en_szOutputNames_.size());
+        auto encoder_tensor = RunSession(*encoder_session_, en_szInputNames_.data(), input_onnx.data(), input_onnx.size(), en_szOutputNames_.data(), en_szOutputNames_.size());
 
         // get enc_vec
         std::vector<int64_t> enc_shape = encoder_tensor[0].GetTensorTypeAndShapeInfo().GetShape();
@@ -497,7 +528,7 @@ string ParaformerOnline::ForwardChunk(std::vector<std::vector<float>> &chunk_fea
                 m_memoryInfo, emb_length.data(), emb_length.size(), emb_length_shape, 1);
             decoder_onnx.insert(decoder_onnx.begin()+3, std::move(onnx_emb_len));
 
-            auto decoder_tensor = decoder_session_->Run(Ort::RunOptions{nullptr}, de_szInputNames_.data(), decoder_onnx.data(), decoder_onnx.size(), de_szOutputNames_.data(), de_szOutputNames_.size());
+            auto decoder_tensor = RunSession(*decoder_session_, de_szInputNames_.data(), decoder_onnx.data(), decoder_onnx.size(), de_szOutputNames_.data(), de_szOutputNames_.size());
             // fsmn cache
             try{
                 decoder_onnx.clear();
@@ -522,7 +553,7 @@ string ParaformerOnline::ForwardChunk(std::vector<std::vector<float>> &chunk_fea
     return result;
 }
 
-string ParaformerOnline::Forward(float* din, int len, bool input_finished, const std::vector<std::vector<float>> &hw_emb, void* wfst_decoder)
+string ParaformerOnline::Forward(float* din, int len, bool input_finished, const HotwordEmbeddingPtr &hw_emb, void* wfst_decoder)
 {
     std::vector<std::vector<float>> wav_feats;
     std::vector<float> waves(din, din+len);
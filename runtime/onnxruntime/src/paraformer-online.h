@@ -62,6 +62,7 @@ namespace funasr {
         Model* offline_handle_ = nullptr;
         // from offline_handle_
         knf::FbankOptions fbank_opts_;
+        std::shared_ptr<FbankPlan> fbank_plan_ = nullptr;
         std::shared_ptr<Ort::Session> encoder_session_ = nullptr;
         std::shared_ptr<Ort::Session> decoder_session_ = nullptr;
         Ort::SessionOptions session_options_;
@@ -98,6 +99,11 @@ namespace funasr {
         std::vector<std::vector<float>> lfr_splice_cache_;
         // position index cache
         int start_idx_cache_ = 0;
+        // sinusoidal position embeddings shared by all streams, feat_dim -> [positions, feat_dim].
+        // A table is never changed once published, growing it publishes a new
+        // one, so chunks read their snapshot without the lock
+        static std::map<int, std::shared_ptr<const std::vector<float>>> pos_emb_table_;
+        static std::mutex pos_emb_mtx_;
         // cif alpha
         std::vector<float> alphas_cache_;
         std::vector<std::vector<float>> hidden_cache_;
@@ -105,6 +111,10 @@ namespace funasr {
         // fsmn init caches
         std::vector<float> fsmn_init_cache_;
         std::vector<Ort::Value> decoder_onnx;
+        // cross-stream batching, borrowed from offline_handle_
+        ParaformerOnlineScheduler* scheduler_ = nullptr;
+        // fsmn caches of this stream when chunks go through scheduler_
+        std::vector<std::vector<float>> fsmn_cache_;
 
         bool is_first_chunk = true;
         bool is_last_chunk = false;
@@ -120,7 +130,8 @@ namespace funasr {
         void AddOverlapChunk(std::vector<std::vector<float>> &wav_feats, bool input_finished);
         
         string ForwardChunk(std::vector<std::vector<float>> &wav_feats, bool input_finished);
-        string Forward(float* din, int len, bool input_finished, const std::vector<std::vector<float>> &hw_emb={{0.0}}, void* wfst_decoder=nullptr);
+        string ForwardChunkBatched(std::vector<std::vector<float>> &wav_feats, bool input_finished);
+        string Forward(float* din, int len, bool input_finished, const HotwordEmbeddingPtr &hw_emb=nullptr, void* wfst_decoder=nullptr);
         string Rescoring();
 
         int GetAsrSampleRate() { return offline_handle_->GetAsrSampleRate(); };
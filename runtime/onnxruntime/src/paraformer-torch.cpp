@@ -27,6 +27,7 @@ void ParaformerTorch::InitAsr(const std::string &am_model, const std::string &am
     fbank_opts_.frame_opts.frame_length_ms = frame_length;
     fbank_opts_.energy_floor = 0;
     fbank_opts_.mel_opts.debug_mel = false;
+    fbank_plan_ = FbankPlan::Get(fbank_opts_);
 
     vocab = new Vocab(token_file.c_str());
 	phone_set_ = new PhoneSet(token_file.c_str());
@@ -168,20 +169,8 @@ void ParaformerTorch::Reset()
 {
 }
 
-void ParaformerTorch::FbankKaldi(float sample_rate, const float* waves, int len, std::vector<std::vector<float>> &asr_feats) {
-    knf::OnlineFbank fbank_(fbank_opts_);
-    std::vector<float> buf(len);
-    for (int32_t i = 0; i != len; ++i) {
-        buf[i] = waves[i] * 32768;
-    }
-    fbank_.AcceptWaveform(sample_rate, buf.data(), buf.size());
-
-    int32_t frames = fbank_.NumFramesReady();
-    for (int32_t i = 0; i != frames; ++i) {
-        const float *frame = fbank_.GetFrame(i);
-        std::vector<float> frame_vector(frame, frame + fbank_opts_.mel_opts.num_bins);
-        asr_feats.emplace_back(frame_vector);
-    }
+void ParaformerTorch::FbankKaldi(float sample_rate, const float* waves, int len, FeatMatrix &asr_feats) {
+    fbank_plan_->Compute(waves, len, asr_feats);
 }
 
 void ParaformerTorch::LoadCmvn(const char *filename)
@@ -256,49 +245,7 @@ string ParaformerTorch::FinalizeDecode(WfstDecoder* &wfst_decoder,
   return wfst_decoder->FinalizeDecode(is_stamp, us_alphas, us_cif_peak);
 }
 
-void ParaformerTorch::LfrCmvn(std::vector<std::vector<float>> &asr_feats) {
-
-    std::vector<std::vector<float>> out_feats;
-    int T = asr_feats.size();
-    int T_lrf = ceil(1.0 * T / lfr_n);
-
-    // Pad frames at start(copy first frame)
-    for (int i = 0; i < (lfr_m - 1) / 2; i++) {
-        asr_feats.insert(asr_feats.begin(), asr_feats[0]);
-    }
-    // Merge lfr_m frames as one,lfr_n frames per window
-    T = T + (lfr_m - 1) / 2;
-    std::vector<float> p;
-    for (int i = 0; i < T_lrf; i++) {
-        if (lfr_m <= T - i * lfr_n) {
-            for (int j = 0; j < lfr_m; j++) {
-                p.insert(p.end(), asr_feats[i * lfr_n + j].begin(), asr_feats[i * lfr_n + j].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        } else {
-            // Fill to lfr_m frames at last window if less than lfr_m frames  (copy last frame)
-            int num_padding = lfr_m - (T - i * lfr_n);
-            for (int j = 0; j < (asr_feats.size() - i * lfr_n); j++) {
-                p.insert(p.end(), asr_feats[i * lfr_n + j].begin(), asr_feats[i * lfr_n + j].end());
-            }
-            for (int j = 0; j < num_padding; j++) {
-                p.insert(p.end(), asr_feats[asr_feats.size() - 1].begin(), asr_feats[asr_feats.size() - 1].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        }
-    }
-    // Apply cmvn
-    for (auto &out_feat: out_feats) {
-        for (int j = 0; j < means_list_.size(); j++) {
-            out_feat[j] = (out_feat[j] + means_list_[j]) * vars_list_[j];
-        }
-    }
-    asr_feats = out_feats;
-}
-
-std::vector<std::string> ParaformerTorch::Forward(float** din, int* len, bool input_finished, const std::vector<std::vector<float>> &hw_emb, void* decoder_handle, int batch_in)
+std::vector<std::string> ParaformerTorch::Forward(float** din, int* len, bool input_finished, const HotwordEmbeddingPtr &hw_emb, void* decoder_handle, int batch_in)
 {
     vector<std::string> results;
     string result="";
@@ -307,28 +254,14 @@ std::vector<std::string> ParaformerTorch::Forward(float** din, int* len, bool in
     int32_t in_feat_dim = fbank_opts_.mel_opts.num_bins;
     int32_t feature_dim = lfr_m*in_feat_dim;
 
-    std::vector<vector<float>> feats_batch;
+    std::vector<FeatMatrix> fbank_batch(batch_in);
     std::vector<int32_t> paraformer_length;
-    int max_size = 0;
     int max_frames = 0;
     for(int index=0; index<batch_in; index++){
-        std::vector<std::vector<float>> asr_feats;
-        FbankKaldi(asr_sample_rate, din[index], len[index], asr_feats);
-        if(asr_feats.size() != 0){
-            LfrCmvn(asr_feats);
-        }
-        int32_t num_frames  = asr_feats.size();
+        FbankKaldi(asr_sample_rate, din[index], len[index], fbank_batch[index]);
+        int32_t num_frames = LfrFrameNum(fbank_batch[index].NumRows(), lfr_n);
         paraformer_length.emplace_back(num_frames);
-        if(max_size < asr_feats.size()*feature_dim){
-            max_size = asr_feats.size()*feature_dim;
-            max_frames = num_frames;
-        }
-
-        std::vector<float> flattened;
-        for (const auto& sub_vector : asr_feats) {
-            flattened.insert(flattened.end(), sub_vector.begin(), sub_vector.end());
-        }
-        feats_batch.emplace_back(flattened);
+        max_frames = std::max(max_frames, num_frames);
     }
 
     if(max_frames == 0){
@@ -341,9 +274,10 @@ std::vector<std::string> ParaformerTorch::Forward(float** din, int* len, bool in
     // padding
     std::vector<float> all_feats(batch_in * max_frames * feature_dim);
     for(int index=0; index<batch_in; index++){
-        feats_batch[index].resize(max_size);
-        std::memcpy(&all_feats[index * max_frames * feature_dim], feats_batch[index].data(),
-                        max_frames * feature_dim * sizeof(float));
+        if(!fbank_batch[index].Empty()){
+            ApplyLfrCmvn(fbank_batch[index], lfr_m, lfr_n, means_list_, vars_list_,
+                         &all_feats[index * max_frames * feature_dim]);
+        }
     }
     torch::Tensor feats =
         torch::from_blob(all_feats.data(),
@@ -359,29 +293,24 @@ std::vector<std::string> ParaformerTorch::Forward(float** din, int* len, bool in
     std::vector<torch::jit::IValue> inputs = {feats, feat_lens};
 
     std::vector<float> batch_embedding;
-    std::vector<float> embedding;
     try{
         if (use_hotword) {
-            if(hw_emb.size()<=0){
+            if(!hw_emb || hw_emb->Empty()){
                 LOG(ERROR) << "hw_emb is null";
                 for(int index=0; index<batch_in; index++){
                     results.push_back(result);
                 }
                 return results;
             }
-            
-            embedding.reserve(hw_emb.size() * hw_emb[0].size());
-            for (auto item : hw_emb) {
-                embedding.insert(embedding.end(), item.begin(), item.end());
-            }
-            batch_embedding.reserve(batch_in * embedding.size());
+
+            batch_embedding.reserve(batch_in * hw_emb->Size());
             for (size_t index = 0; index < batch_in; ++index) {
-                batch_embedding.insert(batch_embedding.end(), embedding.begin(), embedding.end());
+                batch_embedding.insert(batch_embedding.end(), hw_emb->Data(), hw_emb->Data() + hw_emb->Size());
             }
 
             torch::Tensor tensor_hw_emb =
                 torch::from_blob(batch_embedding.data(),
-                        {batch_in, static_cast<int64_t>(hw_emb.size()), static_cast<int64_t>(hw_emb[0].size())}, torch::kFloat).contiguous();
+                        {batch_in, hw_emb->Num(), hw_emb->Dim()}, torch::kFloat).contiguous();
             #ifdef USE_GPU
             tensor_hw_emb = tensor_hw_emb.to(at::kCUDA);
             #endif
@@ -32,7 +32,6 @@ namespace funasr {
 
         void LoadConfigFromYaml(const char* filename);
         void LoadCmvn(const char *filename);
-        void LfrCmvn(std::vector<std::vector<float>> &asr_feats);
 
         using TorchModule = torch::jit::script::Module;
         std::shared_ptr<TorchModule> model_ = nullptr;
@@ -48,9 +47,9 @@ namespace funasr {
         void InitSegDict(const std::string &seg_dict_model);
         std::vector<std::vector<float>> CompileHotwordEmbedding(std::string &hotwords);
         void Reset();
-        void FbankKaldi(float sample_rate, const float* waves, int len, std::vector<std::vector<float>> &asr_feats);
+        void FbankKaldi(float sample_rate, const float* waves, int len, FeatMatrix &asr_feats);
         void WarmUp();
-        std::vector<std::string> Forward(float** din, int* len, bool input_finished=true, const std::vector<std::vector<float>> &hw_emb={{0.0}}, void* wfst_decoder=nullptr, int batch_in=1);
+        std::vector<std::string> Forward(float** din, int* len, bool input_finished=true, const HotwordEmbeddingPtr &hw_emb=nullptr, void* wfst_decoder=nullptr, int batch_in=1);
         string GreedySearch( float* in, int n_len, int64_t token_nums,
                              bool is_stamp=false, std::vector<float> us_alphas={0}, std::vector<float> us_cif_peak={0});
 
@@ -68,8 +67,10 @@ namespace funasr {
         Vocab* GetVocab();
         Vocab* GetLmVocab();
         PhoneSet* GetPhoneSet();
+        HotwordCache* GetHotwordCache() {return &hw_cache_;};
 		
         knf::FbankOptions fbank_opts_;
+        std::shared_ptr<FbankPlan> fbank_plan_ = nullptr;
         vector<float> means_list_;
         vector<float> vars_list_;
         int lfr_m = PARA_LFR_M;
@@ -80,6 +81,8 @@ namespace funasr {
 
         // lm
         std::shared_ptr<fst::Fst<fst::StdArc>> lm_ = nullptr;
+        // compiled hotwords shared by every stream of this model
+        HotwordCache hw_cache_;
 
         string window_type = "hamming";
         int frame_length = 25;
@@ -13,8 +13,7 @@ namespace funasr {
 
 Paraformer::Paraformer()
 :use_hotword(false),
- env_(ORT_LOGGING_LEVEL_ERROR, "paraformer"),session_options_{},
- hw_env_(ORT_LOGGING_LEVEL_ERROR, "paraformer_hw"),hw_session_options{} {
+ session_options_{},hw_session_options{} {
 }
 
 // offline
@@ -29,16 +28,17 @@ void Paraformer::InitAsr(const std::string &am_model, const std::string &am_cmvn
     fbank_opts_.frame_opts.frame_length_ms = frame_length;
     fbank_opts_.energy_floor = 0;
     fbank_opts_.mel_opts.debug_mel = false;
+    fbank_plan_ = FbankPlan::Get(fbank_opts_);
     // fbank_ = std::make_unique<knf::OnlineFbank>(fbank_opts);
 
     // session_options_.SetInterOpNumThreads(1);
-    session_options_.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(session_options_, thread_num);
     session_options_.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     // DisableCpuMemArena can improve performance
     session_options_.DisableCpuMemArena();
 
     try {
-        m_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(am_model).c_str(), session_options_);
+        m_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(am_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << am_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am onnx model: " << e.what();
@@ -65,15 +65,16 @@ void Paraformer::InitAsr(const std::string &en_model, const std::string &de_mode
     fbank_opts_.frame_opts.frame_length_ms = frame_length;
     fbank_opts_.energy_floor = 0;
     fbank_opts_.mel_opts.debug_mel = false;
+    fbank_plan_ = FbankPlan::Get(fbank_opts_);
 
     // session_options_.SetInterOpNumThreads(1);
-    session_options_.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(session_options_, thread_num);
     session_options_.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     // DisableCpuMemArena can improve performance
     session_options_.DisableCpuMemArena();
 
     try {
-        encoder_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(en_model).c_str(), session_options_);
+        encoder_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(en_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << en_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am encoder model: " << e.what();
@@ -81,7 +82,7 @@ void Paraformer::InitAsr(const std::string &en_model, const std::string &de_mode
     }
 
     try {
-        decoder_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(de_model).c_str(), session_options_);
+        decoder_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(de_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << de_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am decoder model: " << e.what();
@@ -138,7 +139,7 @@ void Paraformer::InitAsr(const std::string &am_model, const std::string &en_mode
 
     // offline
     try {
-        m_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(am_model).c_str(), session_options_);
+        m_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(am_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << am_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am onnx model: " << e.what();
@@ -233,13 +234,13 @@ void Paraformer::LoadOnlineConfigFromYaml(const char* filename){
 }
 
 void Paraformer::InitHwCompiler(const std::string &hw_model, int thread_num) {
-    hw_session_options.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(hw_session_options, thread_num);
     hw_session_options.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     // DisableCpuMemArena can improve performance
     hw_session_options.DisableCpuMemArena();
 
     try {
-        hw_m_session = std::make_unique<Ort::Session>(hw_env_, ORTSTRING(hw_model).c_str(), hw_session_options);
+        hw_m_session = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(hw_model).c_str(), hw_session_options);
         LOG(INFO) << "Successfully load model from " << hw_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load hw compiler onnx model: " << e.what();
@@ -267,6 +268,15 @@ void Paraformer::InitSegDict(const std::string &seg_dict_model) {
     seg_dict = new SegDict(seg_dict_model.c_str());
 }
 
+void Paraformer::InitOnlineScheduler(int max_batch, int max_wait_ms) {
+    if (max_batch <= 1 || encoder_session_ == nullptr || decoder_session_ == nullptr) {
+        return;
+    }
+    online_scheduler_ = make_unique<ParaformerOnlineScheduler>(encoder_session_, decoder_session_,
+        en_szInputNames_, en_szOutputNames_, de_szInputNames_, de_szOutputNames_,
+        fsmn_layers, fsmn_dims, max_batch, max_wait_ms);
+}
+
 Paraformer::~Paraformer()
 {
     if(vocab){
@@ -295,20 +305,8 @@ void Paraformer::Reset()
 {
 }
 
-void Paraformer::FbankKaldi(float sample_rate, const float* waves, int len, std::vector<std::vector<float>> &asr_feats) {
-    knf::OnlineFbank fbank_(fbank_opts_);
-    std::vector<float> buf(len);
-    for (int32_t i = 0; i != len; ++i) {
-        buf[i] = waves[i] * 32768;
-    }
-    fbank_.AcceptWaveform(sample_rate, buf.data(), buf.size());
-
-    int32_t frames = fbank_.NumFramesReady();
-    for (int32_t i = 0; i != frames; ++i) {
-        const float *frame = fbank_.GetFrame(i);
-        std::vector<float> frame_vector(frame, frame + fbank_opts_.mel_opts.num_bins);
-        asr_feats.emplace_back(frame_vector);
-    }
+void Paraformer::FbankKaldi(float sample_rate, const float* waves, int len, FeatMatrix &asr_feats) {
+    fbank_plan_->Compute(waves, len, asr_feats);
 }
 
 void Paraformer::LoadCmvn(const char *filename)
@@ -383,73 +381,58 @@ string Paraformer::FinalizeDecode(WfstDecoder* &wfst_decoder,
   return wfst_decoder->FinalizeDecode(is_stamp, us_alphas, us_cif_peak);
 }
 
-void Paraformer::LfrCmvn(std::vector<std::vector<float>> &asr_feats) {
-
-    std::vector<std::vector<float>> out_feats;
-    int T = asr_feats.size();
-    int T_lrf = ceil(1.0 * T / lfr_n);
-
-    // Pad frames at start(copy first frame)
-    for (int i = 0; i < (lfr_m - 1) / 2; i++) {
-        asr_feats.insert(asr_feats.begin(), asr_feats[0]);
-    }
-    // Merge lfr_m frames as one,lfr_n frames per window
-    T = T + (lfr_m - 1) / 2;
-    std::vector<float> p;
-    for (int i = 0; i < T_lrf; i++) {
-        if (lfr_m <= T - i * lfr_n) {
-            for (int j = 0; j < lfr_m; j++) {
-                p.insert(p.end(), asr_feats[i * lfr_n + j].begin(), asr_feats[i * lfr_n + j].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        } else {
-            // Fill to lfr_m frames at last window if less than lfr_m frames  (copy last frame)
-            int num_padding = lfr_m - (T - i * lfr_n);
-            for (int j = 0; j < (asr_feats.size() - i * lfr_n); j++) {
-                p.insert(p.end(), asr_feats[i * lfr_n + j].begin(), asr_feats[i * lfr_n + j].end());
-            }
-            for (int j = 0; j < num_padding; j++) {
-                p.insert(p.end(), asr_feats[asr_feats.size() - 1].begin(), asr_feats[asr_feats.size() - 1].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        }
+std::vector<std::string> Paraformer::Forward(float** din, int* len, bool input_finished, const HotwordEmbeddingPtr &hw_emb, void* decoder_handle, int batch_in)
+{
+    if(batch_in < 1){
+        return std::vector<std::string>();
     }
-    // Apply cmvn
-    for (auto &out_feat: out_feats) {
-        for (int j = 0; j < means_list_.size(); j++) {
-            out_feat[j] = (out_feat[j] + means_list_[j]) * vars_list_[j];
-        }
+
+    std::vector<FeatMatrix> fbank_batch(batch_in);
+    std::vector<const FeatMatrix*> fbank_ptrs(batch_in);
+    for(int index=0; index<batch_in; index++){
+        FbankKaldi(asr_sample_rate, din[index], len[index], fbank_batch[index]);
+        fbank_ptrs[index] = &fbank_batch[index];
     }
-    asr_feats = out_feats;
+    return ForwardFeats(fbank_ptrs.data(), batch_in, input_finished, hw_emb, decoder_handle);
 }
 
-std::vector<std::string> Paraformer::Forward(float** din, int* len, bool input_finished, const std::vector<std::vector<float>> &hw_emb, void* decoder_handle, int batch_in)
+std::vector<std::string> Paraformer::ForwardFeats(const FeatMatrix* const* fbank_batch, int batch_in, bool input_finished, const HotwordEmbeddingPtr &hw_emb, void* decoder_handle)
 {
     std::vector<std::string> results;
     string result="";
     WfstDecoder* wfst_decoder = (WfstDecoder*)decoder_handle;
     int32_t in_feat_dim = fbank_opts_.mel_opts.num_bins;
+    int32_t feat_dim = lfr_m*in_feat_dim;
 
-    if(batch_in != 1){
-        results.push_back(result);
+    if(batch_in < 1){
         return results;
     }
 
-    std::vector<std::vector<float>> asr_feats;
-    FbankKaldi(asr_sample_rate, din[0], len[0], asr_feats);
-    if(asr_feats.size() == 0){
-        results.push_back(result);
+    std::vector<int32_t> paraformer_length(batch_in, 0);
+    int32_t max_frames = 0;
+    for(int index=0; index<batch_in; index++){
+        int32_t num_frames = LfrFrameNum(fbank_batch[index]->NumRows(), lfr_n);
+        paraformer_length[index] = num_frames;
+        max_frames = std::max(max_frames, num_frames);
+    }
+
+    if(max_frames == 0){
+        results.resize(batch_in, result);
         return results;
     }
-    LfrCmvn(asr_feats);
-    int32_t feat_dim = lfr_m*in_feat_dim;
-    int32_t num_frames = asr_feats.size();
 
-    std::vector<float> wav_feats;
-    for (const auto &frame_feat: asr_feats) {
-        wav_feats.insert(wav_feats.end(), frame_feat.begin(), frame_feat.end());
+    // padding: [batch_in, max_frames, feat_dim], zeros after each item's own length
+    std::vector<float> wav_feats(batch_in * max_frames * feat_dim, 0.0f);
+    for(int index=0; index<batch_in; index++){
+        if(!fbank_batch[index]->Empty()){
+            ApplyLfrCmvn(*fbank_batch[index], lfr_m, lfr_n, means_list_, vars_list_,
+                         wav_feats.data() + index * max_frames * feat_dim);
+        }
+    }
+    // items without any frame still need a valid length for the encoder mask
+    std::vector<int32_t> onnx_length(paraformer_length);
+    for(auto &item_len : onnx_length){
+        item_len = std::max(item_len, 1);
     }
 
 #ifdef _WIN_X86
@@ -458,18 +441,16 @@ std::vector<std::string> Paraformer::Forward(float** din, int* len, bool input_f
         Ort::MemoryInfo m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
 #endif
 
-    const int64_t input_shape_[3] = {1, num_frames, feat_dim};
+    const int64_t input_shape_[3] = {batch_in, max_frames, feat_dim};
     Ort::Value onnx_feats = Ort::Value::CreateTensor<float>(m_memoryInfo,
         wav_feats.data(),
         wav_feats.size(),
         input_shape_,
         3);
 
-    const int64_t paraformer_length_shape[1] = {1};
-    std::vector<int32_t> paraformer_length;
-    paraformer_length.emplace_back(num_frames);
+    const int64_t paraformer_length_shape[1] = {batch_in};
     Ort::Value onnx_feats_len = Ort::Value::CreateTensor<int32_t>(
-          m_memoryInfo, paraformer_length.data(), paraformer_length.size(), paraformer_length_shape, 1);
+          m_memoryInfo, onnx_length.data(), onnx_length.size(), paraformer_length_shape, 1);
 
     std::vector<Ort::Value> input_onnx;
     input_onnx.emplace_back(std::move(onnx_feats));
@@ -478,70 +459,95 @@ std::vector<std::string> Paraformer::Forward(float** din, int* len, bool input_f
     std::vector<float> embedding;
     try{
         if (use_hotword) {
-            if(hw_emb.size()<=0){
+            if(!hw_emb || hw_emb->Empty()){
                 LOG(ERROR) << "hw_emb is null";
-                results.push_back(result);
+                results.resize(batch_in, result);
                 return results;
             }
-            //PrintMat(hw_emb, "input_clas_emb");
-            const int64_t hotword_shape[3] = {1, static_cast<int64_t>(hw_emb.size()), static_cast<int64_t>(hw_emb[0].size())};
-            embedding.reserve(hw_emb.size() * hw_emb[0].size());
-            for (auto item : hw_emb) {
-                embedding.insert(embedding.end(), item.begin(), item.end());
+            const int64_t hotword_shape[3] = {batch_in, hw_emb->Num(), hw_emb->Dim()};
+            // the embedding is packed once when compiled, only a batch repeats it
+            float* hw_data = const_cast<float*>(hw_emb->Data());
+            if (batch_in > 1) {
+                embedding.resize(batch_in * hw_emb->Size());
+                for (int index = 0; index < batch_in; index++) {
+                    memcpy(embedding.data() + index * hw_emb->Size(), hw_emb->Data(), hw_emb->Size() * sizeof(float));
+                }
+                hw_data = embedding.data();
             }
-            //LOG(INFO) << "hotword shape " << hotword_shape[0] << " " << hotword_shape[1] << " " << hotword_shape[2] << " size " << embedding.size();
             Ort::Value onnx_hw_emb = Ort::Value::CreateTensor<float>(
-                m_memoryInfo, embedding.data(), embedding.size(), hotword_shape, 3);
+                m_memoryInfo, hw_data, batch_in * hw_emb->Size(), hotword_shape, 3);
 
             input_onnx.emplace_back(std::move(onnx_hw_emb));
         }
     }catch (std::exception const &e)
     {
         LOG(ERROR)<<e.what();
-        results.push_back(result);
+        results.resize(batch_in, result);
         return results;
     }
 
     try {
-        auto outputTensor = m_session_->Run(Ort::RunOptions{nullptr}, m_szInputNames.data(), input_onnx.data(), input_onnx.size(), m_szOutputNames.data(), m_szOutputNames.size());
+        auto outputTensor = RunSession(*m_session_, m_szInputNames.data(), input_onnx.data(), input_onnx.size(), m_szOutputNames.data(), m_szOutputNames.size());
         std::vector<int64_t> outputShape = outputTensor[0].GetTensorTypeAndShapeInfo().GetShape();
         //LOG(INFO) << "paraformer out shape " << outputShape[0] << " " << outputShape[1] << " " << outputShape[2];
 
-        int64_t outputCount = std::accumulate(outputShape.begin(), outputShape.end(), 1, std::multiplies<int64_t>());
         float* floatData = outputTensor[0].GetTensorMutableData<float>();
         auto encoder_out_lens = outputTensor[1].GetTensorMutableData<int64_t>();
-        // timestamp
+        int64_t token_stride = outputShape[1] * outputShape[2];
+
+        std::vector<int64_t> us_alphas_shape, us_peaks_shape;
+        float* us_alphas_data = nullptr;
+        float* us_peaks_data = nullptr;
         if(outputTensor.size() == 4){
-            std::vector<int64_t> us_alphas_shape = outputTensor[2].GetTensorTypeAndShapeInfo().GetShape();
-            float* us_alphas_data = outputTensor[2].GetTensorMutableData<float>();
-            std::vector<float> us_alphas(us_alphas_shape[1]);
-            for (int i = 0; i < us_alphas_shape[1]; i++) {
-                us_alphas[i] = us_alphas_data[i];
-            }
+            us_alphas_shape = outputTensor[2].GetTensorTypeAndShapeInfo().GetShape();
+            us_alphas_data = outputTensor[2].GetTensorMutableData<float>();
+            us_peaks_shape = outputTensor[3].GetTensorTypeAndShapeInfo().GetShape();
+            us_peaks_data = outputTensor[3].GetTensorMutableData<float>();
+        }
 
-            std::vector<int64_t> us_peaks_shape = outputTensor[3].GetTensorTypeAndShapeInfo().GetShape();
-            float* us_peaks_data = outputTensor[3].GetTensorMutableData<float>();
-            std::vector<float> us_peaks(us_peaks_shape[1]);
-            for (int i = 0; i < us_peaks_shape[1]; i++) {
-                us_peaks[i] = us_peaks_data[i];
+        for(int index=0; index<batch_in; index++){
+            result="";
+            if(paraformer_length[index] == 0){
+                results.push_back(result);
+                continue;
             }
-			if (lm_ == nullptr) {
-                result = GreedySearch(floatData, *encoder_out_lens, outputShape[2], true, us_alphas, us_peaks);
-			} else {
-			    result = BeamSearch(wfst_decoder, floatData, *encoder_out_lens, outputShape[2]);
-                if (input_finished) {
-                    result = FinalizeDecode(wfst_decoder, true, us_alphas, us_peaks);
+            float* item_data = floatData + index * token_stride;
+            int64_t item_len = encoder_out_lens[index];
+            // timestamp
+            if(outputTensor.size() == 4){
+                // upsampled cif outputs are 3x the lfr frames, drop the padded tail
+                int64_t alphas_len = batch_in == 1 ? us_alphas_shape[1] :
+                    std::min<int64_t>(us_alphas_shape[1], paraformer_length[index] * 3);
+                std::vector<float> us_alphas(us_alphas_data + index * us_alphas_shape[1],
+                                             us_alphas_data + index * us_alphas_shape[1] + alphas_len);
+
+                int64_t peaks_len = batch_in == 1 ? us_peaks_shape[1] :
+                    std::min<int64_t>(us_peaks_shape[1], paraformer_length[index] * 3);
+                std::vector<float> us_peaks(us_peaks_data + index * us_peaks_shape[1],
+                                            us_peaks_data + index * us_peaks_shape[1] + peaks_len);
+                if (lm_ == nullptr) {
+                    result = GreedySearch(item_data, item_len, outputShape[2], true, us_alphas, us_peaks);
+                } else {
+                    result = BeamSearch(wfst_decoder, item_data, item_len, outputShape[2]);
+                    if (input_finished) {
+                        result = FinalizeDecode(wfst_decoder, true, us_alphas, us_peaks);
+                    }
                 }
-			}
-        }else{
-			if (lm_ == nullptr) {
-                result = GreedySearch(floatData, *encoder_out_lens, outputShape[2]);
-			} else {
-			    result = BeamSearch(wfst_decoder, floatData, *encoder_out_lens, outputShape[2]);
-                if (input_finished) {
-                    result = FinalizeDecode(wfst_decoder);
+            }else{
+                if (lm_ == nullptr) {
+                    result = GreedySearch(item_data, item_len, outputShape[2]);
+                } else {
+                    result = BeamSearch(wfst_decoder, item_data, item_len, outputShape[2]);
+                    if (input_finished) {
+                        result = FinalizeDecode(wfst_decoder);
+                    }
                 }
-			}
+            }
+            results.push_back(result);
+            // every item of the batch is an independent utterance for the wfst decoder
+            if (wfst_decoder && batch_in > 1){
+                wfst_decoder->StartUtterance();
+            }
         }
     }
     catch (std::exception const &e)
@@ -549,7 +555,7 @@ std::vector<std::string> Paraformer::Forward(float** din, int* len, bool input_f
         LOG(ERROR)<<e.what();
     }
 
-    results.push_back(result);
+    results.resize(batch_in, "");
     return results;
 }
 
@@ -631,7 +637,7 @@ std::vector<std::vector<float>> Paraformer::CompileHotwordEmbedding(std::string
 
     std::vector<std::vector<float>> result;
     try {
-        auto outputTensor = hw_m_session->Run(Ort::RunOptions{nullptr}, hw_m_szInputNames.data(), input_onnx.data(), input_onnx.size(), hw_m_szOutputNames.data(), hw_m_szOutputNames.size());
+        auto outputTensor = RunSession(*hw_m_session, hw_m_szInputNames.data(), input_onnx.data(), input_onnx.size(), hw_m_szOutputNames.data(), hw_m_szOutputNames.size());
         std::vector<int64_t> outputShape = outputTensor[0].GetTensorTypeAndShapeInfo().GetShape();
 
         int64_t outputCount = std::accumulate(outputShape.begin(), outputShape.end(), 1, std::multiplies<int64_t>());
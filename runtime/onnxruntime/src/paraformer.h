@@ -29,10 +29,8 @@ namespace funasr {
         void LoadConfigFromYaml(const char* filename);
         void LoadOnlineConfigFromYaml(const char* filename);
         void LoadCmvn(const char *filename);
-        void LfrCmvn(std::vector<std::vector<float>> &asr_feats);
 
         std::shared_ptr<Ort::Session> hw_m_session = nullptr;
-        Ort::Env hw_env_;
         Ort::SessionOptions hw_session_options;
         vector<string> hw_m_strInputNames, hw_m_strOutputNames;
         vector<const char*> hw_m_szInputNames;
@@ -49,17 +47,21 @@ namespace funasr {
         void InitAsr(const std::string &am_model, const std::string &en_model, const std::string &de_model, const std::string &am_cmvn, 
             const std::string &am_config, const std::string &token_file, const std::string &online_token_file, int thread_num);
         void InitHwCompiler(const std::string &hw_model, int thread_num);
+        void InitOnlineScheduler(int max_batch, int max_wait_ms);
         void InitSegDict(const std::string &seg_dict_model);
         std::vector<std::vector<float>> CompileHotwordEmbedding(std::string &hotwords);
         void Reset();
-        void FbankKaldi(float sample_rate, const float* waves, int len, std::vector<std::vector<float>> &asr_feats);
-        std::vector<std::string> Forward(float** din, int* len, bool input_finished=true, const std::vector<std::vector<float>> &hw_emb={{0.0}}, void* wfst_decoder=nullptr, int batch_in=1);
+        void FbankKaldi(float sample_rate, const float* waves, int len, FeatMatrix &asr_feats);
+        std::vector<std::string> Forward(float** din, int* len, bool input_finished=true, const HotwordEmbeddingPtr &hw_emb=nullptr, void* wfst_decoder=nullptr, int batch_in=1);
+        std::vector<std::string> ForwardFeats(const FeatMatrix* const* feats, int batch_in, bool input_finished=true, const HotwordEmbeddingPtr &hw_emb=nullptr, void* wfst_decoder=nullptr);
+        const FbankPlan* GetFbankPlan() {return fbank_plan_.get();};
         string GreedySearch( float* in, int n_len, int64_t token_nums,
                              bool is_stamp=false, std::vector<float> us_alphas={0}, std::vector<float> us_cif_peak={0});
 
         string Rescoring();
         string GetLang(){return language;};
         int GetAsrSampleRate() { return asr_sample_rate; };
+        void SetBatchSize(int batch_size) {batch_size_ = batch_size;};
         int GetBatchSize() {return batch_size_;};
         void StartUtterance();
         void EndUtterance();
@@ -70,8 +72,10 @@ namespace funasr {
         Vocab* GetVocab();
         Vocab* GetLmVocab();
         PhoneSet* GetPhoneSet();
+        HotwordCache* GetHotwordCache() {return &hw_cache_;};
 		
         knf::FbankOptions fbank_opts_;
+        std::shared_ptr<FbankPlan> fbank_plan_ = nullptr;
         vector<float> means_list_;
         vector<float> vars_list_;
         int lfr_m = PARA_LFR_M;
@@ -79,7 +83,6 @@ namespace funasr {
 
         // paraformer-offline
         std::shared_ptr<Ort::Session> m_session_ = nullptr;
-        Ort::Env env_;
         Ort::SessionOptions session_options_;
 
         vector<string> m_strInputNames, m_strOutputNames;
@@ -97,9 +100,13 @@ namespace funasr {
         vector<string> de_strInputNames, de_strOutputNames;
         vector<const char*> de_szInputNames_;
         vector<const char*> de_szOutputNames_;
+        // shared by all online streams of this model, null when chunks run one by one
+        std::unique_ptr<ParaformerOnlineScheduler> online_scheduler_ = nullptr;
 
         // lm
         std::shared_ptr<fst::Fst<fst::StdArc>> lm_ = nullptr;
+        // compiled hotwords shared by every stream of this model
+        HotwordCache hw_cache_;
 
         string window_type = "hamming";
         int frame_length = 25;
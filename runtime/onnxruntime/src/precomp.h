@@ -5,6 +5,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <deque>
+#include <map>
+#include <mutex>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -45,6 +47,10 @@ using namespace std;
 #include "com-define.h"
 #include "commonfunc.h"
 #include "predefine-coe.h"
+#include "feat-matrix.h"
+#include "fbank-plan.h"
+#include "hotword-cache.h"
+#include "compute-scheduler.h"
 #include "model.h"
 #include "vad-model.h"
 #include "punc-model.h"
@@ -52,6 +58,7 @@ using namespace std;
 #include "ct-transformer.h"
 #include "ct-transformer-online.h"
 #include "e2e-vad.h"
+#include "fsmn-vad-scheduler.h"
 #include "fsmn-vad.h"
 #include "encode_converter.h"
 #include "vocab.h"
@@ -63,6 +70,7 @@ using namespace std;
 #include "util.h"
 #include "seg_dict.h"
 #include "resample.h"
+#include "paraformer-online-scheduler.h"
 #include "paraformer.h"
 #include "sensevoice-small.h"
 #ifdef USE_GPU
@@ -70,6 +78,8 @@ using namespace std;
 #endif
 #include "paraformer-online.h"
 #include "offline-stream.h"
+#include "offline-incremental-stream.h"
+#include "tpass-batcher.h"
 #include "tpass-stream.h"
 #include "tpass-online-stream.h"
 #include "funasrruntime.h"
@@ -29,6 +29,9 @@
 #include <stdio.h>
 
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <type_traits>
 
 namespace funasr {
@@ -73,11 +76,21 @@ I Lcm(I m, I n) {
 }
 
 static float DotProduct(const float *a, const float *b, int32_t n) {
-  float sum = 0;
-  for (int32_t i = 0; i != n; ++i) {
-    sum += a[i] * b[i];
+  // independent partial sums, so the compiler can keep them in one vector
+  // register instead of waiting on a single serial accumulator
+  float sum[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  int32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    for (int32_t k = 0; k != 8; ++k) {
+      sum[k] += a[i + k] * b[i + k];
+    }
+  }
+  float tail = 0;
+  for (; i != n; ++i) {
+    tail += a[i] * b[i];
   }
-  return sum;
+  return ((sum[0] + sum[4]) + (sum[1] + sum[5])) +
+         ((sum[2] + sum[6]) + (sum[3] + sum[7])) + tail;
 }
 
 LinearResample::LinearResample(int32_t samp_rate_in_hz,
@@ -97,13 +110,32 @@ LinearResample::LinearResample(int32_t samp_rate_in_hz,
   input_samples_in_unit_ = samp_rate_in_ / base_freq;
   output_samples_in_unit_ = samp_rate_out_ / base_freq;
 
-  SetIndexesAndWeights();
+  filter_ = GetFilter();
   Reset();
 }
 
-void LinearResample::SetIndexesAndWeights() {
-  first_index_.resize(output_samples_in_unit_);
-  weights_.resize(output_samples_in_unit_);
+std::shared_ptr<const ResampleFilter> LinearResample::GetFilter() const {
+  typedef std::tuple<int32_t, int32_t, float, int32_t> FilterKey;
+  static std::mutex mtx;
+  static std::map<FilterKey, std::shared_ptr<const ResampleFilter>> filters;
+
+  FilterKey key(samp_rate_in_, samp_rate_out_, filter_cutoff_, num_zeros_);
+  std::lock_guard<std::mutex> lock(mtx);
+  auto iter = filters.find(key);
+  if (iter != filters.end()) {
+    return iter->second;
+  }
+  std::shared_ptr<ResampleFilter> filter = std::make_shared<ResampleFilter>();
+  SetIndexesAndWeights(filter.get());
+  filters[key] = filter;
+  return filter;
+}
+
+void LinearResample::SetIndexesAndWeights(ResampleFilter *filter) const {
+  std::vector<int32_t> &first_index = filter->first_index;
+  std::vector<std::vector<float>> &weights = filter->weights;
+  first_index.resize(output_samples_in_unit_);
+  weights.resize(output_samples_in_unit_);
 
   double window_width = num_zeros_ / (2.0 * filter_cutoff_);
 
@@ -120,14 +152,14 @@ void LinearResample::SetIndexesAndWeights() {
     int32_t min_input_index = ceil(min_t * samp_rate_in_),
             max_input_index = floor(max_t * samp_rate_in_),
             num_indices = max_input_index - min_input_index + 1;
-    first_index_[i] = min_input_index;
-    weights_[i].resize(num_indices);
+    first_index[i] = min_input_index;
+    weights[i].resize(num_indices);
     for (int32_t j = 0; j < num_indices; j++) {
       int32_t input_index = min_input_index + j;
       double input_t = input_index / static_cast<double>(samp_rate_in_),
              delta_t = input_t - output_t;
       // sign of delta_t doesn't matter.
-      weights_[i][j] = FilterFunc(delta_t) / samp_rate_in_;
+      weights[i][j] = FilterFunc(delta_t) / samp_rate_in_;
     }
   }
 }
@@ -174,7 +206,7 @@ void LinearResample::Resample(const float *input, int32_t input_dim, bool flush,
     int64_t first_samp_in;
     int32_t samp_out_wrapped;
     GetIndexes(samp_out, &first_samp_in, &samp_out_wrapped);
-    const std::vector<float> &weights = weights_[samp_out_wrapped];
+    const std::vector<float> &weights = filter_->weights[samp_out_wrapped];
     // first_input_index is the first index into "input" that we have a weight
     // for.
     int32_t first_input_index =
@@ -275,7 +307,7 @@ void LinearResample::GetIndexes(int64_t samp_out, int64_t *first_samp_in,
   *samp_out_wrapped =
       static_cast<int32_t>(samp_out - unit_index * output_samples_in_unit_);
   *first_samp_in =
-      first_index_[*samp_out_wrapped] + unit_index * input_samples_in_unit_;
+      filter_->first_index[*samp_out_wrapped] + unit_index * input_samples_in_unit_;
 }
 
 void LinearResample::SetRemainder(const float *input, int32_t input_dim) {
@@ -23,6 +23,7 @@
 // kaldi/src/feat/resample.h
 #pragma once 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace funasr {
@@ -31,6 +32,20 @@ namespace funasr {
    integers, as this is an easy way to specify that their ratio be rational.
 */
 
+/// Filter taps for one (input rate, output rate, cutoff, num_zeros) setting.
+/// They only depend on the setting, so every LinearResample using it shares
+/// one immutable copy, built on first use.
+struct ResampleFilter {
+  /// The first input-sample index that we sum over, for this output-sample
+  /// index.  May be negative; any truncation at the beginning is handled
+  /// separately.  This is just for the first few output samples, but we can
+  /// extrapolate the correct input-sample index for arbitrary output samples.
+  std::vector<int32_t> first_index;
+
+  /// Weights on the input samples, for this output-sample index.
+  std::vector<std::vector<float>> weights;
+};
+
 class LinearResample {
  public:
   /// Constructor.  We make the input and output sample rates integers, because
@@ -75,7 +90,8 @@ class LinearResample {
   int32_t GetOutputSamplingRate() const { return samp_rate_out_; }
 
  private:
-  void SetIndexesAndWeights();
+  std::shared_ptr<const ResampleFilter> GetFilter() const;
+  void SetIndexesAndWeights(ResampleFilter *filter) const;
 
   float FilterFunc(float) const;
 
@@ -115,14 +131,8 @@ class LinearResample {
                                     ///< = samp_rate_out_hz /
                                     ///< Gcd(samp_rate_in_hz, samp_rate_out_hz)
 
-  /// The first input-sample index that we sum over, for this output-sample
-  /// index.  May be negative; any truncation at the beginning is handled
-  /// separately.  This is just for the first few output samples, but we can
-  /// extrapolate the correct input-sample index for arbitrary output samples.
-  std::vector<int32_t> first_index_;
-
-  /// Weights on the input samples, for this output-sample index.
-  std::vector<std::vector<float>> weights_;
+  /// first_index and weights for each output-sample index in a unit
+  std::shared_ptr<const ResampleFilter> filter_;
 
   // the following variables keep track of where we are in a particular signal,
   // if it is being provided over multiple calls to Resample().
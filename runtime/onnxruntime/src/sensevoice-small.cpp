@@ -12,7 +12,7 @@ namespace funasr {
 
 SenseVoiceSmall::SenseVoiceSmall()
 :use_hotword(false),
- env_(ORT_LOGGING_LEVEL_ERROR, "sensevoice"),session_options_{} {
+ session_options_{} {
 }
 
 // offline
@@ -27,15 +27,16 @@ void SenseVoiceSmall::InitAsr(const std::string &am_model, const std::string &am
     fbank_opts_.frame_opts.frame_length_ms = frame_length;
     fbank_opts_.energy_floor = 0;
     fbank_opts_.mel_opts.debug_mel = false;
+    fbank_plan_ = FbankPlan::Get(fbank_opts_);
 
     // session_options_.SetInterOpNumThreads(1);
-    session_options_.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(session_options_, thread_num);
     session_options_.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     // DisableCpuMemArena can improve performance
     session_options_.DisableCpuMemArena();
 
     try {
-        m_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(am_model).c_str(), session_options_);
+        m_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(am_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << am_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am onnx model: " << e.what();
@@ -61,15 +62,16 @@ void SenseVoiceSmall::InitAsr(const std::string &en_model, const std::string &de
     fbank_opts_.frame_opts.frame_length_ms = frame_length;
     fbank_opts_.energy_floor = 0;
     fbank_opts_.mel_opts.debug_mel = false;
+    fbank_plan_ = FbankPlan::Get(fbank_opts_);
 
     // session_options_.SetInterOpNumThreads(1);
-    session_options_.SetIntraOpNumThreads(thread_num);
+    ComputeScheduler::Instance().SetSessionThreads(session_options_, thread_num);
     session_options_.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
     // DisableCpuMemArena can improve performance
     session_options_.DisableCpuMemArena();
 
     try {
-        encoder_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(en_model).c_str(), session_options_);
+        encoder_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(en_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << en_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am encoder model: " << e.what();
@@ -77,7 +79,7 @@ void SenseVoiceSmall::InitAsr(const std::string &en_model, const std::string &de
     }
 
     try {
-        decoder_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(de_model).c_str(), session_options_);
+        decoder_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(de_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << de_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am decoder model: " << e.what();
@@ -134,7 +136,7 @@ void SenseVoiceSmall::InitAsr(const std::string &am_model, const std::string &en
 
     // offline
     try {
-        m_session_ = std::make_unique<Ort::Session>(env_, ORTSTRING(am_model).c_str(), session_options_);
+        m_session_ = std::make_unique<Ort::Session>(ComputeScheduler::Instance().GetEnv(), ORTSTRING(am_model).c_str(), session_options_);
         LOG(INFO) << "Successfully load model from " << am_model;
     } catch (std::exception const &e) {
         LOG(ERROR) << "Error when load am onnx model: " << e.what();
@@ -249,20 +251,8 @@ void SenseVoiceSmall::Reset()
 {
 }
 
-void SenseVoiceSmall::FbankKaldi(float sample_rate, const float* waves, int len, std::vector<std::vector<float>> &asr_feats) {
-    knf::OnlineFbank fbank_(fbank_opts_);
-    std::vector<float> buf(len);
-    for (int32_t i = 0; i != len; ++i) {
-        buf[i] = waves[i] * 32768;
-    }
-    fbank_.AcceptWaveform(sample_rate, buf.data(), buf.size());
-
-    int32_t frames = fbank_.NumFramesReady();
-    for (int32_t i = 0; i != frames; ++i) {
-        const float *frame = fbank_.GetFrame(i);
-        std::vector<float> frame_vector(frame, frame + fbank_opts_.mel_opts.num_bins);
-        asr_feats.emplace_back(frame_vector);
-    }
+void SenseVoiceSmall::FbankKaldi(float sample_rate, const float* waves, int len, FeatMatrix &asr_feats) {
+    fbank_plan_->Compute(waves, len, asr_feats);
 }
 
 void SenseVoiceSmall::LoadCmvn(const char *filename)
@@ -378,48 +368,6 @@ string SenseVoiceSmall::GreedySearch(float * in, int n_len,  int64_t token_nums,
     }
 }
 
-void SenseVoiceSmall::LfrCmvn(std::vector<std::vector<float>> &asr_feats) {
-
-    std::vector<std::vector<float>> out_feats;
-    int T = asr_feats.size();
-    int T_lrf = ceil(1.0 * T / lfr_n);
-
-    // Pad frames at start(copy first frame)
-    for (int i = 0; i < (lfr_m - 1) / 2; i++) {
-        asr_feats.insert(asr_feats.begin(), asr_feats[0]);
-    }
-    // Merge lfr_m frames as one,lfr_n frames per window
-    T = T + (lfr_m - 1) / 2;
-    std::vector<float> p;
-    for (int i = 0; i < T_lrf; i++) {
-        if (lfr_m <= T - i * lfr_n) {
-            for (int j = 0; j < lfr_m; j++) {
-                p.insert(p.end(), asr_feats[i * lfr_n + j].begin(), asr_feats[i * lfr_n + j].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        } else {
-            // Fill to lfr_m frames at last window if less than lfr_m frames  (copy last frame)
-            int num_padding = lfr_m - (T - i * lfr_n);
-            for (int j = 0; j < (asr_feats.size() - i * lfr_n); j++) {
-                p.insert(p.end(), asr_feats[i * lfr_n + j].begin(), asr_feats[i * lfr_n + j].end());
-            }
-            for (int j = 0; j < num_padding; j++) {
-                p.insert(p.end(), asr_feats[asr_feats.size() - 1].begin(), asr_feats[asr_feats.size() - 1].end());
-            }
-            out_feats.emplace_back(p);
-            p.clear();
-        }
-    }
-    // Apply cmvn
-    for (auto &out_feat: out_feats) {
-        for (int j = 0; j < means_list_.size(); j++) {
-            out_feat[j] = (out_feat[j] + means_list_[j]) * vars_list_[j];
-        }
-    }
-    asr_feats = out_feats;
-}
-
 std::vector<std::vector<float>> SenseVoiceSmall::CompileHotwordEmbedding(std::string &hotwords) {
     int embedding_dim = encoder_size;
     std::vector<std::vector<float>> hw_emb;
@@ -439,20 +387,17 @@ std::vector<std::string> SenseVoiceSmall::Forward(float** din, int* len, bool in
         return results;
     }
 
-    std::vector<std::vector<float>> asr_feats;
-    FbankKaldi(asr_sample_rate, din[0], len[0], asr_feats);
-    if(asr_feats.size() == 0){
+    FeatMatrix fbank_feats;
+    FbankKaldi(asr_sample_rate, din[0], len[0], fbank_feats);
+    if(fbank_feats.Empty()){
         results.push_back(result);
         return results;
     }
-    LfrCmvn(asr_feats);
     int32_t feat_dim = lfr_m*in_feat_dim;
-    int32_t num_frames = asr_feats.size();
+    int32_t num_frames = LfrFrameNum(fbank_feats.NumRows(), lfr_n);
 
-    std::vector<float> wav_feats;
-    for (const auto &frame_feat: asr_feats) {
-        wav_feats.insert(wav_feats.end(), frame_feat.begin(), frame_feat.end());
-    }
+    std::vector<float> wav_feats(num_frames * feat_dim);
+    ApplyLfrCmvn(fbank_feats, lfr_m, lfr_n, means_list_, vars_list_, wav_feats.data());
 
     //lid textnorm
     int svs_lid = 0;
@@ -502,7 +447,7 @@ std::vector<std::string> SenseVoiceSmall::Forward(float** din, int* len, bool in
     input_onnx.emplace_back(std::move(onnx_itn));
 
     try {
-        auto outputTensor = m_session_->Run(Ort::RunOptions{nullptr}, m_szInputNames.data(), input_onnx.data(), input_onnx.size(), m_szOutputNames.data(), m_szOutputNames.size());
+        auto outputTensor = RunSession(*m_session_, m_szInputNames.data(), input_onnx.data(), input_onnx.size(), m_szOutputNames.data(), m_szOutputNames.size());
         float* floatData = outputTensor[0].GetTensorMutableData<float>();
         std::vector<int64_t> outputShape = outputTensor[0].GetTensorTypeAndShapeInfo().GetShape();
 
@@ -21,10 +21,8 @@ namespace funasr {
         void LoadConfigFromYaml(const char* filename);
         void LoadOnlineConfigFromYaml(const char* filename);
         void LoadCmvn(const char *filename);
-        void LfrCmvn(std::vector<std::vector<float>> &asr_feats);
 
         std::shared_ptr<Ort::Session> hw_m_session = nullptr;
-        Ort::Env hw_env_;
         Ort::SessionOptions hw_session_options;
         vector<string> hw_m_strInputNames, hw_m_strOutputNames;
         vector<const char*> hw_m_szInputNames;
@@ -44,7 +42,7 @@ namespace funasr {
         // void InitSegDict(const std::string &seg_dict_model);
         std::vector<std::vector<float>> CompileHotwordEmbedding(std::string &hotwords);
         void Reset();
-        void FbankKaldi(float sample_rate, const float* waves, int len, std::vector<std::vector<float>> &asr_feats);
+        void FbankKaldi(float sample_rate, const float* waves, int len, FeatMatrix &asr_feats);
         std::vector<std::string> Forward(float** din, int* len, bool input_finished=true, std::string svs_lang="auto", bool svs_itn=true, int batch_in=1);
         string CTCSearch( float * in, std::vector<int32_t> paraformer_length, std::vector<int64_t> outputShape);
         string GreedySearch( float* in, int n_len, int64_t token_nums,
@@ -64,6 +62,7 @@ namespace funasr {
         // PhoneSet* GetPhoneSet();
 		
         knf::FbankOptions fbank_opts_;
+        std::shared_ptr<FbankPlan> fbank_plan_ = nullptr;
         vector<float> means_list_;
         vector<float> vars_list_;
         int lfr_m = PARA_LFR_M;
@@ -71,7 +70,6 @@ namespace funasr {
 
         // paraformer-offline
         std::shared_ptr<Ort::Session> m_session_ = nullptr;
-        Ort::Env env_;
         Ort::SessionOptions session_options_;
 
         vector<string> m_strInputNames, m_strOutputNames;
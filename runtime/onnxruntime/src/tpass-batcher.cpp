@@ -0,0 +1,82 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+
+#include "precomp.h"
+
+namespace funasr {
+
+TpassBatcher::TpassBatcher(Model* asr_handle, int max_batch, int max_wait_ms)
+:asr_handle_(asr_handle),
+ queue_(max_batch, max_wait_ms){
+    LOG(INFO) << "2pass offline batcher enabled, max batch: " << queue_.GetMaxBatch() << ", max wait: " << queue_.GetMaxWaitMs() << " ms";
+}
+
+bool TpassBatcher::CanJoin(const std::vector<BatchTask*> &batch, const BatchTask &item)
+{
+    // the whole batch shares the hotword embedding of its first segment
+    const BatchTask &leader = *(batch[0]);
+    if(leader.hw_emb != item.hw_emb &&
+       (!leader.hw_emb || !item.hw_emb || *(leader.hw_emb) != *(item.hw_emb))){
+        return false;
+    }
+    // segments are padded to the longest one
+    int max_len = item.len;
+    for(auto task : batch){
+        max_len = std::max(max_len, task->len);
+    }
+    return max_len * (int)(batch.size() + 1) <= max_batch_samples_;
+}
+
+void TpassBatcher::RunBatch(std::vector<BatchTask*> &batch)
+{
+    int batch_in = batch.size();
+    const FbankPlan* fbank_plan = asr_handle_->GetFbankPlan();
+    std::vector<std::string> msgs;
+    try{
+        if(fbank_plan){
+            // only segments without cached frames go through the frontend
+            std::vector<FeatMatrix> fbank_batch(batch_in);
+            std::vector<const FeatMatrix*> feats(batch_in);
+            for(int idx=0; idx<batch_in; idx++){
+                feats[idx] = batch[idx]->feats;
+                if(feats[idx] == nullptr){
+                    fbank_plan->Compute(batch[idx]->din, batch[idx]->len, fbank_batch[idx]);
+                    feats[idx] = &fbank_batch[idx];
+                }
+            }
+            msgs = asr_handle_->ForwardFeats(feats.data(), batch_in, true, batch[0]->hw_emb, nullptr);
+        }else{
+            std::vector<float*> buff(batch_in);
+            std::vector<int> len(batch_in);
+            for(int idx=0; idx<batch_in; idx++){
+                buff[idx] = batch[idx]->din;
+                len[idx] = batch[idx]->len;
+            }
+            msgs = asr_handle_->Forward(buff.data(), len.data(), true, batch[0]->hw_emb, nullptr, batch_in);
+        }
+    }catch (std::exception const &e)
+    {
+        LOG(ERROR)<<e.what();
+    }
+    for(int idx=0; idx<batch_in; idx++){
+        batch[idx]->result = idx < msgs.size() ? msgs[idx] : "";
+    }
+}
+
+std::string TpassBatcher::Infer(float* din, int len, const HotwordEmbeddingPtr &hw_emb,
+                               const FeatMatrix* feats)
+{
+    BatchTask task;
+    task.din = din;
+    task.len = len;
+    task.hw_emb = hw_emb;
+    task.feats = feats;
+    queue_.Submit(task,
+        [this](const std::vector<BatchTask*> &batch, const BatchTask &item){ return CanJoin(batch, item); },
+        [this](std::vector<BatchTask*> &batch){ RunBatch(batch); });
+    return task.result;
+}
+
+} // namespace funasr
@@ -0,0 +1,46 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights Reserved.
+ * MIT License  (https://opensource.org/licenses/MIT)
+*/
+#pragma once
+
+#include "model.h"
+#include "batch-queue.h"
+
+namespace funasr {
+
+    class TpassBatcher {
+    /**
+     * Dynamic batcher for the offline (second) pass of 2pass streams.
+     * Final VAD segments of many TpassOnlineStreams are queued here, decoded
+     * together by one padded Forward on the shared asr_handle and every result
+     * is handed back to the caller it came from.
+    */
+    public:
+        TpassBatcher(Model* asr_handle, int max_batch, int max_wait_ms);
+        ~TpassBatcher(){};
+
+        // blocks until the batch holding this segment has been decoded
+        // feats are the fbank frames of din when the caller already has them
+        std::string Infer(float* din, int len, const HotwordEmbeddingPtr &hw_emb,
+                          const FeatMatrix* feats=nullptr);
+        FUNASR_BATCH_STATS GetStats() {return queue_.GetStats();};
+
+    private:
+        struct BatchTask {
+            float* din = nullptr;
+            int len = 0;
+            HotwordEmbeddingPtr hw_emb;
+            const FeatMatrix* feats = nullptr;
+            std::string result;
+        };
+        void RunBatch(std::vector<BatchTask*> &batch);
+        bool CanJoin(const std::vector<BatchTask*> &batch, const BatchTask &item);
+
+        Model* asr_handle_ = nullptr;
+        // padded samples per batch, same budget as Audio::FetchDynamic
+        int max_batch_samples_ = 300*MODEL_SAMPLE_RATE;
+        BatchQueue<BatchTask> queue_;
+    };
+
+} // namespace funasr
@@ -12,12 +12,34 @@ TpassOnlineStream::TpassOnlineStream(TpassStream* tpass_stream, std::vector<int>
 
     if(tpass_obj->asr_handle){
         asr_online_handle = make_unique<ParaformerOnline>((tpass_obj->asr_handle).get(), chunk_size, tpass_stream->GetModelType());
+        // the offline pass reuses the vad fbank frames when both frontends match
+        ((FsmnVadOnline*)vad_online_handle.get())->EnableFbankCache((tpass_obj->asr_handle)->GetFbankPlan());
     }else{
         LOG(ERROR)<<"asr_handle is null";
         exit(-1);
     }
 }
 
+void TpassOnlineStream::PushSegment(TpassSegment segment){
+    std::lock_guard<std::mutex> lock(segments_mtx_);
+    segments_.push_back(std::move(segment));
+}
+
+bool TpassOnlineStream::PopSegment(TpassSegment &segment){
+    std::lock_guard<std::mutex> lock(segments_mtx_);
+    if(segments_.empty()){
+        return false;
+    }
+    segment = std::move(segments_.front());
+    segments_.pop_front();
+    return true;
+}
+
+int TpassOnlineStream::PendingSegments(){
+    std::lock_guard<std::mutex> lock(segments_mtx_);
+    return segments_.size();
+}
+
 TpassOnlineStream* CreateTpassOnlineStream(void* tpass_stream, std::vector<int> chunk_size)
 {
     return new TpassOnlineStream((TpassStream*)tpass_stream, chunk_size);
@@ -1,7 +1,7 @@
 #include "precomp.h"
 
 namespace funasr {
-TpassStream::TpassStream(std::map<std::string, std::string>& model_path, int thread_num)
+TpassStream::TpassStream(std::map<std::string, std::string>& model_path, int thread_num, int batch_size, int batch_wait_ms)
 {
     // VAD model
     if(model_path.find(VAD_DIR) != model_path.end()){
@@ -132,13 +132,26 @@ TpassStream::TpassStream(std::map<std::string, std::string>& model_path, int thr
         }
     }
 #endif
-      
+
+    // batching relies on Paraformer's padded Forward
+    if(batch_size > 1 && model_type == MODEL_PARA){
+        batcher_handle = make_unique<TpassBatcher>(asr_handle.get(), batch_size, batch_wait_ms);
+        // online chunks of all connections share the same knobs
+        ((Paraformer*)asr_handle.get())->InitOnlineScheduler(batch_size, batch_wait_ms);
+    }
+    if(batch_size > 1 && use_vad){
+        ((FsmnVad*)vad_handle.get())->InitOnlineScheduler(batch_size, batch_wait_ms);
+    }
+}
+
+TpassStream::~TpassStream()
+{
 }
 
-TpassStream *CreateTpassStream(std::map<std::string, std::string>& model_path, int thread_num)
+TpassStream *CreateTpassStream(std::map<std::string, std::string>& model_path, int thread_num, int batch_size, int batch_wait_ms)
 {
     TpassStream *mm;
-    mm = new TpassStream(model_path, thread_num);
+    mm = new TpassStream(model_path, thread_num, batch_size, batch_wait_ms);
     return mm;
 }
 } // namespace funasr
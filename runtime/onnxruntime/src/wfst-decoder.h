@@ -5,6 +5,7 @@
 #include "fst/fstlib.h"
 #include "fst/symbol-table.h"
 #include "bias-lm.h"
+#include "hotword-cache.h"
 #include "phone-set.h"
 #include "util.h"
 
@@ -62,7 +63,8 @@ class WfstDecoder {
               Vocab* vocab,
               float glob_beam,
               float lat_beam,
-              float am_scale);
+              float am_scale,
+              HotwordCache* hw_cache = nullptr);
   ~WfstDecoder();
   void StartUtterance();
   void EndUtterance();
@@ -81,6 +83,7 @@ class WfstDecoder {
   fst::Fst<fst::StdArc>* lm_ = nullptr;
   std::shared_ptr<kaldi::LatticeFasterOnlineDecoder> decoder_ = nullptr;
   std::shared_ptr<BiasLm> bias_lm_ = nullptr;
+  HotwordCache* hw_cache_ = nullptr;
 };
 } // namespace funasr
 #endif // WFST_DECODER_
@@ -0,0 +1,115 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights
+ * Reserved. MIT License  (https://opensource.org/licenses/MIT)
+ */
+
+// per connection audio bytes for the websocket servers. The received
+// websocket payloads are kept as they are (a block holds a reference to its
+// message), so the network thread never copies or moves audio and can hand
+// any range of it to a decoder thread.
+
+#ifndef AUDIO_BYTE_QUEUE_H_
+#define AUDIO_BYTE_QUEUE_H_
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class AudioByteQueue {
+ public:
+  // owner keeps data alive for as long as the block is queued
+  void Push(std::shared_ptr<const void> owner, const char* data, size_t size) {
+    if (size == 0) {
+      return;
+    }
+    blocks_.push_back(Block{std::move(owner), data, size});
+    size_ += size;
+  }
+
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+
+  // moves the first n bytes into a new queue, only a block cut in two is
+  // shared by both queues
+  AudioByteQueue Take(size_t n) {
+    AudioByteQueue front;
+    n = std::min(n, size_);
+    while (n > 0) {
+      Block& block = blocks_.front();
+      if (block.size <= n) {
+        n -= block.size;
+        front.Push(std::move(block.owner), block.data, block.size);
+        PopBlock();
+      } else {
+        front.Push(block.owner, block.data, n);
+        block.data += n;
+        block.size -= n;
+        size_ -= n;
+        n = 0;
+      }
+    }
+    return front;
+  }
+
+  AudioByteQueue TakeAll() { return Take(size_); }
+
+  // the first n bytes as one contiguous range: points into the block when
+  // they are all in it, else they are gathered into scratch
+  const char* Front(size_t n, std::vector<char>& scratch) const {
+    n = std::min(n, size_);
+    if (!blocks_.empty() && blocks_.front().size >= n) {
+      return blocks_.front().data;
+    }
+    scratch.resize(n);
+    CopyTo(scratch.data(), n);
+    return scratch.data();
+  }
+
+  void Pop(size_t n) {
+    n = std::min(n, size_);
+    while (n > 0) {
+      Block& block = blocks_.front();
+      if (block.size <= n) {
+        n -= block.size;
+        PopBlock();
+      } else {
+        block.data += n;
+        block.size -= n;
+        size_ -= n;
+        n = 0;
+      }
+    }
+  }
+
+  // copies the first n bytes to dst
+  void CopyTo(char* dst, size_t n) const {
+    for (const Block& block : blocks_) {
+      if (n == 0) {
+        break;
+      }
+      size_t len = std::min(n, block.size);
+      memcpy(dst, block.data, len);
+      dst += len;
+      n -= len;
+    }
+  }
+
+ private:
+  struct Block {
+    std::shared_ptr<const void> owner;
+    const char* data;
+    size_t size;
+  };
+
+  void PopBlock() {
+    size_ -= blocks_.front().size;
+    blocks_.pop_front();
+  }
+
+  std::deque<Block> blocks_;
+  size_t size_ = 0;
+};
+
+#endif  // AUDIO_BYTE_QUEUE_H_
@@ -16,7 +16,10 @@
 // hotwords
 std::unordered_map<std::string, int> hws_map_;
 int fst_inc_wts_=20;
+int hotword_cache_mb_=64, hotword_fst_cache_mb_=256;
 float global_beam_, lattice_beam_, am_scale_;
+funasr::AdmissionLimits admission_limits_;
+float vad_energy_gate_db_=-100;
 
 using namespace std;
 void GetValue(TCLAP::ValueArg<std::string>& value_arg, string key,
@@ -106,9 +109,30 @@ int main(int argc, char* argv[]) {
     TCLAP::ValueArg<int> io_thread_num("", "io-thread-num", "io thread num",
                                        false, 2, "int");
     TCLAP::ValueArg<int> decoder_thread_num(
-        "", "decoder-thread-num", "decoder thread num", false, 8, "int");
+        "", "decoder-thread-num", "threads running the vad and online asr of the streams", false, 8, "int");
+    TCLAP::ValueArg<int> offline_thread_num(
+        "", "offline-thread-num",
+        "threads running the offline pass of the segments, their model runs wait behind those of the online asr",
+        false, 4, "int");
     TCLAP::ValueArg<int> model_thread_num("", "model-thread-num",
                                           "model thread num", false, 2, "int");
+    TCLAP::ValueArg<int> compute_thread_num("", "compute-thread-num",
+        "threads doing model compute, shared by all models: 0 gives each model session its own pool of model-thread-num threads, -1 uses the number of cores", false, 0, "int");
+    TCLAP::ValueArg<int> max_decode_tasks("", "max-decode-tasks",
+        "max decode tasks queued or running, more are answered busy, 0 is unbounded", false, 0, "int");
+    TCLAP::ValueArg<int> max_connection_audio_mb("", "max-connection-audio-mb",
+        "max MB of audio one connection may buffer before it is answered busy, 0 is unbounded", false, 0, "int");
+    TCLAP::ValueArg<float> max_queued_audio_seconds("", "max-queued-audio-seconds",
+        "max seconds of audio queued for decoding over all connections, more are answered busy, 0 is unbounded", false, 0, "float");
+    TCLAP::ValueArg<int> batch_size("", BATCHSIZE,
+        "max number of offline-pass segments or online chunks from different connections decoded in one batch, 1 disables batching",
+        false, 1, "int");
+    TCLAP::ValueArg<int> batch_wait_ms("", "batch-wait-ms",
+        "max time in ms a segment or chunk waits for others to join its batch",
+        false, 20, "int");
+    TCLAP::ValueArg<float> vad_energy_gate_db("", "vad-energy-gate-db",
+        "chunks whose frames all stay below this many dB while no segment is open skip the vad model, digital silence is -60, -100 disables the gate",
+        false, -100, "float");
 
     TCLAP::ValueArg<std::string> certfile(
         "", "certfile",
@@ -134,10 +158,16 @@ int main(int argc, char* argv[]) {
         false, "/workspace/resources/hotwords.txt", "string");
     TCLAP::ValueArg<std::int32_t> fst_inc_wts("", FST_INC_WTS, 
         "the fst hotwords incremental bias", false, 20, "int32_t");
+    TCLAP::ValueArg<std::int32_t> hotword_cache_mb("", "hotword-cache-mb",
+        "memory in MB for compiled nn hotword embeddings shared by connections, 0 disables the cache", false, 64, "int32_t");
+    TCLAP::ValueArg<std::int32_t> hotword_fst_cache_mb("", "hotword-fst-cache-mb",
+        "memory in MB for fst hotword graphs shared by connections, 0 disables the cache", false, 256, "int32_t");
 
     // add file
     cmd.add(hotword);
     cmd.add(fst_inc_wts);
+    cmd.add(hotword_cache_mb);
+    cmd.add(hotword_fst_cache_mb);
     cmd.add(global_beam);
     cmd.add(lattice_beam);
     cmd.add(am_scale);
@@ -166,7 +196,15 @@ int main(int argc, char* argv[]) {
     cmd.add(port);
     cmd.add(io_thread_num);
     cmd.add(decoder_thread_num);
+    cmd.add(offline_thread_num);
     cmd.add(model_thread_num);
+    cmd.add(compute_thread_num);
+    cmd.add(max_decode_tasks);
+    cmd.add(max_connection_audio_mb);
+    cmd.add(max_queued_audio_seconds);
+    cmd.add(batch_size);
+    cmd.add(batch_wait_ms);
+    cmd.add(vad_energy_gate_db);
     cmd.parse(argc, argv);
 
     std::map<std::string, std::string> model_path;
@@ -505,10 +543,12 @@ int main(int argc, char* argv[]) {
     int s_port = port.getValue();
     int s_io_thread_num = io_thread_num.getValue();
     int s_decoder_thread_num = decoder_thread_num.getValue();
+    int s_offline_thread_num = std::max(offline_thread_num.getValue(), 1);
 
     int s_model_thread_num = model_thread_num.getValue();
 
     asio::io_context io_decoder;  // context for decoding
+    asio::io_context io_offline;  // context for the offline pass
     asio::io_context io_server;   // context for server
 
     std::vector<std::thread> decoder_threads;
@@ -520,6 +560,12 @@ int main(int argc, char* argv[]) {
     std::string hotword_path;
     hotword_path = model_path.at(HOTWORD);
     fst_inc_wts_ = fst_inc_wts.getValue();
+    hotword_cache_mb_ = hotword_cache_mb.getValue();
+    hotword_fst_cache_mb_ = hotword_fst_cache_mb.getValue();
+    admission_limits_.max_tasks = max_decode_tasks.getValue();
+    admission_limits_.max_conn_bytes = (long long)max_connection_audio_mb.getValue() << 20;
+    admission_limits_.max_queued_seconds = max_queued_audio_seconds.getValue();
+    vad_energy_gate_db_ = vad_energy_gate_db.getValue();
     LOG(INFO) << "hotword path: " << hotword_path;
     funasr::ExtractHws(hotword_path, hws_map_);
 
@@ -536,6 +582,13 @@ int main(int argc, char* argv[]) {
     for (int32_t i = 0; i < s_decoder_thread_num; ++i) {
       decoder_threads.emplace_back([&io_decoder]() { io_decoder.run(); });
     }
+    auto offline_guard = asio::make_work_guard(io_offline);
+    for (int32_t i = 0; i < s_offline_thread_num; ++i) {
+      decoder_threads.emplace_back([&io_offline]() {
+        FunSetComputeBackground(true);
+        io_offline.run();
+      });
+    }
 
     server server_;  // server for websocket
     wss_server wss_server_;
@@ -564,13 +617,22 @@ int main(int argc, char* argv[]) {
     }
 
     WebSocketServer websocket_srv(
-        io_decoder, is_ssl, server, wss_server, s_certfile,
+        io_decoder, io_offline, is_ssl, server, wss_server, s_certfile,
         s_keyfile);  // websocket server for asr engine
-    websocket_srv.initAsr(model_path, s_model_thread_num);  // init asr model
+    FunSetComputeThreads(compute_thread_num.getValue(), s_model_thread_num);
+    websocket_srv.initAsr(model_path, s_model_thread_num,
+                          batch_size.getValue(), batch_wait_ms.getValue());  // init asr model
 
     LOG(INFO) << "decoder-thread-num: " << s_decoder_thread_num;
+    LOG(INFO) << "offline-thread-num: " << s_offline_thread_num;
     LOG(INFO) << "io-thread-num: " << s_io_thread_num;
     LOG(INFO) << "model-thread-num: " << s_model_thread_num;
+    LOG(INFO) << "compute-thread-num: " << compute_thread_num.getValue();
+    LOG(INFO) << "max-decode-tasks: " << max_decode_tasks.getValue()
+              << ", max-connection-audio-mb: " << max_connection_audio_mb.getValue()
+              << ", max-queued-audio-seconds: " << max_queued_audio_seconds.getValue();
+    LOG(INFO) << "vad-energy-gate-db: " << vad_energy_gate_db_;
+    LOG(INFO) << "batch-size: " << batch_size.getValue();
     LOG(INFO) << "asr model init finished. listen on port:" << s_port;
 
     // Start the ASIO network io_service run loop
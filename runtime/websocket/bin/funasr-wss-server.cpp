@@ -16,7 +16,10 @@
 // hotwords
 std::unordered_map<std::string, int> hws_map_;
 int fst_inc_wts_=20;
+int hotword_cache_mb_=64, hotword_fst_cache_mb_=256;
 float global_beam_, lattice_beam_, am_scale_;
+funasr::AdmissionLimits admission_limits_;
+int vad_thread_num_=0, vad_window_seconds_=60;
 
 using namespace std;
 void GetValue(TCLAP::ValueArg<std::string>& value_arg, string key,
@@ -104,6 +107,18 @@ int main(int argc, char* argv[]) {
         "", "decoder-thread-num", "decoder thread num", false, 8, "int");
     TCLAP::ValueArg<int> model_thread_num("", "model-thread-num",
                                           "model thread num", false, 1, "int");
+    TCLAP::ValueArg<int> compute_thread_num("", "compute-thread-num",
+        "threads doing model compute, shared by all models: 0 gives each model session its own pool of model-thread-num threads, -1 uses the number of cores", false, 0, "int");
+    TCLAP::ValueArg<int> max_decode_tasks("", "max-decode-tasks",
+        "max decode tasks queued or running, more are answered busy, 0 is unbounded", false, 0, "int");
+    TCLAP::ValueArg<int> max_connection_audio_mb("", "max-connection-audio-mb",
+        "max MB of audio one connection may buffer before it is answered busy, 0 is unbounded", false, 0, "int");
+    TCLAP::ValueArg<float> max_queued_audio_seconds("", "max-queued-audio-seconds",
+        "max seconds of audio queued for decoding over all connections, more are answered busy, 0 is unbounded", false, 0, "float");
+    TCLAP::ValueArg<int> vad_thread_num("", "vad-thread-num",
+        "threads scoring the vad windows of one long file in parallel, 0 scores a file in one pass", false, 0, "int");
+    TCLAP::ValueArg<int> vad_window_seconds("", "vad-window-seconds",
+        "seconds of audio per vad window, files up to this long are scored in one pass", false, 60, "int");
 
     TCLAP::ValueArg<std::string> certfile("", "certfile", 
         "default: ../../../ssl_key/server.crt, path of certficate for WSS connection. if it is empty, it will be in WS mode.",
@@ -125,12 +140,18 @@ int main(int argc, char* argv[]) {
         false, "/workspace/resources/hotwords.txt", "string");
     TCLAP::ValueArg<std::int32_t> fst_inc_wts("", FST_INC_WTS, 
         "the fst hotwords incremental bias", false, 20, "int32_t");
+    TCLAP::ValueArg<std::int32_t> hotword_cache_mb("", "hotword-cache-mb",
+        "memory in MB for compiled nn hotword embeddings shared by connections, 0 disables the cache", false, 64, "int32_t");
+    TCLAP::ValueArg<std::int32_t> hotword_fst_cache_mb("", "hotword-fst-cache-mb",
+        "memory in MB for fst hotword graphs shared by connections, 0 disables the cache", false, 256, "int32_t");
     TCLAP::SwitchArg use_gpu("", INFER_GPU, "Whether to use GPU, default is false", false);
-    TCLAP::ValueArg<std::int32_t> batch_size("", BATCHSIZE, "batch_size for ASR model when using GPU", false, 4, "int32_t");
+    TCLAP::ValueArg<std::int32_t> batch_size("", BATCHSIZE, "batch_size for ASR model", false, 4, "int32_t");
 
     // add file
     cmd.add(hotword);
     cmd.add(fst_inc_wts);
+    cmd.add(hotword_cache_mb);
+    cmd.add(hotword_fst_cache_mb);
     cmd.add(global_beam);
     cmd.add(lattice_beam);
     cmd.add(am_scale);
@@ -158,6 +179,12 @@ int main(int argc, char* argv[]) {
     cmd.add(io_thread_num);
     cmd.add(decoder_thread_num);
     cmd.add(model_thread_num);
+    cmd.add(compute_thread_num);
+    cmd.add(max_decode_tasks);
+    cmd.add(max_connection_audio_mb);
+    cmd.add(max_queued_audio_seconds);
+    cmd.add(vad_thread_num);
+    cmd.add(vad_window_seconds);
     cmd.add(use_gpu);
     cmd.add(batch_size);
     cmd.parse(argc, argv);
@@ -463,6 +490,13 @@ int main(int argc, char* argv[]) {
     std::string hotword_path;
     hotword_path = model_path.at(HOTWORD);
     fst_inc_wts_ = fst_inc_wts.getValue();
+    hotword_cache_mb_ = hotword_cache_mb.getValue();
+    hotword_fst_cache_mb_ = hotword_fst_cache_mb.getValue();
+    admission_limits_.max_tasks = max_decode_tasks.getValue();
+    admission_limits_.max_conn_bytes = (long long)max_connection_audio_mb.getValue() << 20;
+    admission_limits_.max_queued_seconds = max_queued_audio_seconds.getValue();
+    vad_thread_num_ = vad_thread_num.getValue();
+    vad_window_seconds_ = vad_window_seconds.getValue();
     LOG(INFO) << "hotword path: " << hotword_path;
     funasr::ExtractHws(hotword_path, hws_map_);
 
@@ -508,11 +542,17 @@ int main(int argc, char* argv[]) {
     WebSocketServer websocket_srv(
         io_decoder, is_ssl, server, wss_server, s_certfile,
         s_keyfile);  // websocket server for asr engine
+    FunSetComputeThreads(compute_thread_num.getValue(), s_model_thread_num);
     websocket_srv.initAsr(model_path, s_model_thread_num, use_gpu_, batch_size_);  // init asr model
 
     LOG(INFO) << "decoder-thread-num: " << s_decoder_thread_num;
     LOG(INFO) << "io-thread-num: " << s_io_thread_num;
     LOG(INFO) << "model-thread-num: " << s_model_thread_num;
+    LOG(INFO) << "compute-thread-num: " << compute_thread_num.getValue();
+    LOG(INFO) << "max-decode-tasks: " << max_decode_tasks.getValue()
+              << ", max-connection-audio-mb: " << max_connection_audio_mb.getValue()
+              << ", max-queued-audio-seconds: " << max_queued_audio_seconds.getValue();
+    LOG(INFO) << "vad-thread-num: " << vad_thread_num_ << ", vad-window-seconds: " << vad_window_seconds_;
     LOG(INFO) << "asr model init finished. listen on port:" << s_port;
 
     // Start the ASIO network io_service run loop
@@ -0,0 +1,92 @@
+/**
+ * Copyright FunASR (https://github.com/alibaba-damo-academy/FunASR). All Rights
+ * Reserved. MIT License  (https://opensource.org/licenses/MIT)
+ */
+
+// connection -> session map for the websocket servers. The map is split in
+// shards with a lock each, so opening, closing and looking up connections on
+// different io threads rarely wait on each other and no operation ever walks
+// all the connections.
+
+#ifndef SESSION_MAP_H_
+#define SESSION_MAP_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <websocketpp/common/connection_hdl.hpp>
+
+template <typename Session>
+class SessionMap {
+ public:
+  typedef std::shared_ptr<Session> SessionPtr;
+
+  void Insert(websocketpp::connection_hdl hdl, SessionPtr session) {
+    Shard& shard = GetShard(hdl);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.sessions[hdl] = std::move(session);
+  }
+
+  SessionPtr Find(websocketpp::connection_hdl hdl) {
+    Shard& shard = GetShard(hdl);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.sessions.find(hdl);
+    return it == shard.sessions.end() ? nullptr : it->second;
+  }
+
+  // removes the connection and hands its session to the caller, the session
+  // itself lives on for as long as decoder jobs still hold it
+  SessionPtr Erase(websocketpp::connection_hdl hdl) {
+    Shard& shard = GetShard(hdl);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.sessions.find(hdl);
+    if (it == shard.sessions.end()) {
+      return nullptr;
+    }
+    SessionPtr session = std::move(it->second);
+    shard.sessions.erase(it);
+    return session;
+  }
+
+  size_t Size() {
+    size_t size = 0;
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      size += shard.sessions.size();
+    }
+    return size;
+  }
+
+ private:
+  static const size_t kNumShards = 64;
+
+  struct Shard {
+    std::mutex lock;
+    std::map<websocketpp::connection_hdl, SessionPtr,
+             std::owner_less<websocketpp::connection_hdl>>
+        sessions;
+  };
+
+  // The shard comes from the address of the connection, which is alive while
+  // its handlers run. A handle whose connection has expired maps to the
+  // nullptr shard and is never found there, so sessions must be erased from
+  // on_close, not after the connection is gone.
+  Shard& GetShard(const websocketpp::connection_hdl& hdl) {
+    uint64_t key = reinterpret_cast<uintptr_t>(hdl.lock().get());
+    // connections are 16 byte aligned heap blocks, mix all the bits into the
+    // low ones before the modulo (the fmix64 finalizer of MurmurHash3)
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return shards_[key % kNumShards];
+  }
+
+  Shard shards_[kNumShards];
+};
+
+#endif  // SESSION_MAP_H_
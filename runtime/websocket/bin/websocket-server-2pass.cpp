@@ -18,7 +18,10 @@
 
 extern std::unordered_map<std::string, int> hws_map_;
 extern int fst_inc_wts_;
+extern int hotword_cache_mb_, hotword_fst_cache_mb_;
 extern float global_beam_, lattice_beam_, am_scale_;
+extern funasr::AdmissionLimits admission_limits_;
+extern float vad_energy_gate_db_;
 
 context_ptr WebSocketServer::on_tls_init(tls_mode mode,
                                          websocketpp::connection_hdl hdl,
@@ -96,29 +99,41 @@ nlohmann::json handle_result(FUNASR_RESULT result) {
 
   return jsonresult;
 }
-// feed buffer to asr engine for decoder
+void WebSocketServer::send_result(websocketpp::connection_hdl& hdl,
+                                  const nlohmann::json& jsonresult) {
+  websocketpp::lib::error_code ec;
+  if (is_ssl) {
+    wss_server_->send(hdl, jsonresult.dump(),
+                      websocketpp::frame::opcode::text, ec);
+  } else {
+    server_->send(hdl, jsonresult.dump(),
+                  websocketpp::frame::opcode::text, ec);
+  }
+}
+
+// feed buffer to asr engine for decoder. Only the vad and the online asr run
+// here, the segments the vad closes go to the offline pool, so a long
+// offline pass holds up neither this stream's partial results nor others'
 void WebSocketServer::do_decoder(
-    std::vector<char>& buffer, 
+    AudioByteQueue& buffer, 
     websocketpp::connection_hdl& hdl,
-    nlohmann::json& msg, 
-    std::vector<std::vector<std::string>>& punc_cache,
-    std::vector<std::vector<float>> &hotwords_embedding,
-    websocketpp::lib::mutex& thread_lock, 
+    std::shared_ptr<FUNASR_MESSAGE>& session,
     bool& is_final, 
-    std::string wav_name,
-    std::string modetype,
-    bool itn,
-    int audio_fs,
-    std::string wav_format,
-    FUNASR_HANDLE& tpass_online_handle,
-    FUNASR_DEC_HANDLE& decoder_handle,
-    std::string svs_lang,
-    bool sys_itn) {
+    std::shared_ptr<const FUNASR_SESSION_CONFIG>& config,
+    funasr::AdmissionTicket& ticket) {
+  // the job holds the session, so its handles stay valid until it returns,
+  // and its admission ticket until it is done
+  std::atomic<bool>& is_eof = session->is_eof;
+  std::vector<std::vector<std::string>>& punc_cache = *session->punc_cache;
+  FUNASR_HANDLE& tpass_online_handle = session->tpass_online_handle;
+  const std::string& wav_name = config->wav_name;
+  const std::string& modetype = config->mode;
+  const std::string& wav_format = config->wav_format;
+  bool itn = config->itn;
+  int audio_fs = config->audio_fs;
   // lock for each connection
   if(!tpass_online_handle){
-    scoped_lock guard(thread_lock);
 	  LOG(INFO) << "tpass_online_handle  is free, return";
-	  msg["access_num"]=(int)msg["access_num"]-1;
 	  return;
   }
   try {
@@ -131,100 +146,88 @@ void WebSocketServer::do_decoder(
     } else if (modetype == "2pass") {
       asr_mode_ = 2;
     }
+    bool has_offline = asr_mode_ != 1;
 
-    while (buffer.size() >= 800 * 2 && !msg["is_eof"]) {
-      std::vector<char> subvector = {buffer.begin(), buffer.begin() + 800 * 2};
-      buffer.erase(buffer.begin(), buffer.begin() + 800 * 2);
+    // only a step split over two websocket messages is copied into scratch
+    std::vector<char> scratch;
+    while (buffer.Size() >= 800 * 2 && !is_eof) {
+      const char* step_data = buffer.Front(800 * 2, scratch);
 
       try {
         if (tpass_online_handle) {
-          Result = FunTpassInferBuffer(tpass_handle, tpass_online_handle,
-                                       subvector.data(), subvector.size(),
-                                       punc_cache, false, audio_fs,
-                                       wav_format, (ASR_TYPE)asr_mode_,
-                                       hotwords_embedding, itn, decoder_handle,
-                                       svs_lang, sys_itn);
+          Result = FunTpassOnlineInferBuffer(tpass_handle, tpass_online_handle,
+                                             step_data, 800 * 2,
+                                             punc_cache, false, audio_fs,
+                                             wav_format, (ASR_TYPE)asr_mode_,
+                                             itn);
 
         } else {
-          scoped_lock guard(thread_lock);
-          msg["access_num"]=(int)msg["access_num"]-1;
           return;
         }
       } catch (std::exception const& e) {
-        scoped_lock guard(thread_lock);
         LOG(ERROR) << e.what();
-        msg["access_num"]=(int)msg["access_num"]-1;
         return;
       }
+      buffer.Pop(800 * 2);
       if (Result) {
-        websocketpp::lib::error_code ec;
         nlohmann::json jsonresult = handle_result(Result);
         jsonresult["wav_name"] = wav_name;
         jsonresult["is_final"] = false;
         if (jsonresult["text"] != "") {
-          if (is_ssl) {
-            wss_server_->send(hdl, jsonresult.dump(),
-                              websocketpp::frame::opcode::text, ec);
-          } else {
-            server_->send(hdl, jsonresult.dump(),
-                          websocketpp::frame::opcode::text, ec);
-          }
+          send_result(hdl, jsonresult);
         }
         FunASRFreeResult(Result);
       }
+      if (has_offline && FunTpassOfflinePending(tpass_online_handle) > 0 &&
+          !session->offline_queued.exchange(true)) {
+        session->offline_strand_->post(
+            std::bind(&WebSocketServer::do_offline, this, hdl, session,
+                      false, config, ticket));
+      }
     }
-    if (is_final && !msg["is_eof"]) {
+    if (is_final && !is_eof) {
       try {
         if (tpass_online_handle) {
-          Result = FunTpassInferBuffer(tpass_handle, tpass_online_handle,
-                                       buffer.data(), buffer.size(), punc_cache,
-                                       is_final, audio_fs,
-                                       wav_format, (ASR_TYPE)asr_mode_,
-                                       hotwords_embedding, itn, decoder_handle,
-                                       svs_lang, sys_itn);
+          Result = FunTpassOnlineInferBuffer(tpass_handle, tpass_online_handle,
+                                             buffer.Front(buffer.Size(), scratch),
+                                             buffer.Size(), punc_cache,
+                                             is_final, audio_fs,
+                                             wav_format, (ASR_TYPE)asr_mode_,
+                                             itn);
         } else {
-          scoped_lock guard(thread_lock);
-          msg["access_num"]=(int)msg["access_num"]-1;	 
           return;
         }
       } catch (std::exception const& e) {
-        scoped_lock guard(thread_lock);
         LOG(ERROR) << e.what();
-        msg["access_num"]=(int)msg["access_num"]-1;
         return;
       }
-      if(punc_cache.size()>0){
-        for (auto& vec : punc_cache) {
-          vec.clear();
-        }
-      }
+      // the offline pass clears its own cache after the last segment
+      punc_cache[0].clear();
       if (Result) {
-        websocketpp::lib::error_code ec;
         nlohmann::json jsonresult = handle_result(Result);
         jsonresult["wav_name"] = wav_name;
-        jsonresult["is_final"] = true;
-        if (is_ssl) {
-          wss_server_->send(hdl, jsonresult.dump(),
-                            websocketpp::frame::opcode::text, ec);
+        if (has_offline) {
+          // the final result comes after the last offline segment
+          jsonresult["is_final"] = false;
+          if (jsonresult["text"] != "") {
+            send_result(hdl, jsonresult);
+          }
+          session->offline_strand_->post(
+              std::bind(&WebSocketServer::do_offline, this, hdl, session,
+                        true, config, ticket));
         } else {
-          server_->send(hdl, jsonresult.dump(),
-                        websocketpp::frame::opcode::text, ec);
+          punc_cache[1].clear();
+          jsonresult["is_final"] = true;
+          send_result(hdl, jsonresult);
         }
         FunASRFreeResult(Result);
       }else{
         if(wav_format != "pcm" && wav_format != "PCM"){
-          websocketpp::lib::error_code ec;
           nlohmann::json jsonresult;
           jsonresult["text"] = "ERROR. Real-time transcription service ONLY SUPPORT PCM stream.";
           jsonresult["wav_name"] = wav_name;
           jsonresult["is_final"] = true;
-          if (is_ssl) {
-            wss_server_->send(hdl, jsonresult.dump(),
-                              websocketpp::frame::opcode::text, ec);
-          } else {
-            server_->send(hdl, jsonresult.dump(),
-                          websocketpp::frame::opcode::text, ec);
-          }
+          send_result(hdl, jsonresult);
         }
       }
     }
@@ -232,158 +235,288 @@ void WebSocketServer::do_decoder(
   } catch (std::exception const& e) {
     std::cerr << "Error: " << e.what() << std::endl;
   }
-  scoped_lock guard(thread_lock);
-  msg["access_num"]=(int)msg["access_num"]-1;
- 
+}
+
+void WebSocketServer::do_offline(
+    websocketpp::connection_hdl& hdl,
+    std::shared_ptr<FUNASR_MESSAGE>& session,
+    bool& is_final,
+    std::shared_ptr<const FUNASR_SESSION_CONFIG>& config,
+    funasr::AdmissionTicket& ticket) {
+  std::atomic<bool>& is_eof = session->is_eof;
+  std::vector<std::vector<std::string>>& punc_cache = *session->punc_cache;
+  FUNASR_HANDLE& tpass_online_handle = session->tpass_online_handle;
+  if (!tpass_online_handle) {
+    return;
+  }
+  // segments queued from now on need another job
+  session->offline_queued = false;
+  try {
+    // with is_final the last result is held back to be sent as the final one
+    nlohmann::json last_result;
+    bool has_last = false;
+    while (!is_eof) {
+      FUNASR_RESULT Result = nullptr;
+      try {
+        Result = FunTpassOfflineInfer(tpass_handle, tpass_online_handle,
+                                      punc_cache, session->hotwords_embedding,
+                                      config->itn, session->decoder_handle,
+                                      config->svs_lang, config->svs_itn);
+      } catch (std::exception const& e) {
+        LOG(ERROR) << e.what();
+        return;
+      }
+      if (!Result) {
+        break;
+      }
+      nlohmann::json jsonresult = handle_result(Result);
+      FunASRFreeResult(Result);
+      jsonresult["wav_name"] = config->wav_name;
+      jsonresult["is_final"] = false;
+      if (has_last && last_result["text"] != "") {
+        send_result(hdl, last_result);
+      }
+      has_last = false;
+      if (is_final) {
+        last_result = jsonresult;
+        has_last = true;
+      } else if (jsonresult["text"] != "") {
+        send_result(hdl, jsonresult);
+      }
+    }
+    if (is_final && !is_eof) {
+      punc_cache[1].clear();
+      if (!has_last) {
+        last_result["text"] = "";
+        last_result["wav_name"] = config->wav_name;
+      }
+      if (!last_result.contains("mode")) {
+        last_result["mode"] = "2pass-offline";
+      }
+      last_result["is_final"] = true;
+      send_result(hdl, last_result);
+    }
+  } catch (std::exception const& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+  }
+}
+
+// copies the session settings with the fields of a client text frame
+// applied, decoder jobs already posted keep the old snapshot
+void update_config(const nlohmann::json& jsonresult,
+                   std::shared_ptr<const FUNASR_SESSION_CONFIG>& config) {
+  std::shared_ptr<FUNASR_SESSION_CONFIG> new_config =
+      std::make_shared<FUNASR_SESSION_CONFIG>(*config);
+  if (jsonresult.contains("wav_name")) {
+    new_config->wav_name = jsonresult["wav_name"].get<std::string>();
+  }
+  if (jsonresult.contains("mode")) {
+    new_config->mode = jsonresult["mode"].get<std::string>();
+  }
+  if (jsonresult.contains("wav_format")) {
+    new_config->wav_format = jsonresult["wav_format"].get<std::string>();
+  }
+  if (jsonresult.contains("audio_fs")) {
+    new_config->audio_fs = jsonresult["audio_fs"].get<int>();
+  }
+  if (jsonresult.contains("itn")) {
+    new_config->itn = jsonresult["itn"].get<bool>();
+  }
+  if (jsonresult.contains("svs_lang")) {
+    new_config->svs_lang = jsonresult["svs_lang"].get<std::string>();
+  }
+  if (jsonresult.contains("svs_itn")) {
+    new_config->svs_itn = jsonresult["svs_itn"].get<bool>();
+  }
+  config = new_config;
+}
+
+// frees the engine handles of a session, called by its shared_ptr when
+// neither the session map nor a decoder job refers to it any more
+void release_session(FUNASR_MESSAGE* data_msg) {
+  try{
+    FunWfstDecoderUnloadHwsRes(data_msg->decoder_handle);
+    FunASRWfstDecoderUninit(data_msg->decoder_handle);
+    data_msg->decoder_handle = nullptr;
+    FunTpassOnlineUninit(data_msg->tpass_online_handle);
+    data_msg->tpass_online_handle = nullptr;
+  }catch (std::exception const& e) {
+    LOG(ERROR) << e.what();
+  }
+  delete data_msg;
 }
 
 void WebSocketServer::on_open(websocketpp::connection_hdl hdl) {
-  scoped_lock guard(m_lock);     // for threads safty
   try{
-    std::shared_ptr<FUNASR_MESSAGE> data_msg =
-        std::make_shared<FUNASR_MESSAGE>();  // put a new data vector for new
-                                            // connection
-    data_msg->samples = std::make_shared<std::vector<char>>();
+    std::shared_ptr<FUNASR_MESSAGE> data_msg(
+        new FUNASR_MESSAGE(), release_session);  // put a new data vector for
+                                                  // new connection
+    data_msg->samples = std::make_shared<AudioByteQueue>();
     data_msg->thread_lock = std::make_shared<websocketpp::lib::mutex>();  
 
-    data_msg->msg = nlohmann::json::parse("{}");
-    data_msg->msg["wav_format"] = "pcm";
-    data_msg->msg["wav_name"] = "wav-default-id";
-    data_msg->msg["mode"] = "2pass";
-    data_msg->msg["itn"] = true;
-    data_msg->msg["audio_fs"] = 16000; // default is 16k
-    data_msg->msg["access_num"] = 0; // the number of access for this object, when it is 0, we can free it saftly
-    data_msg->msg["is_eof"]=false; // if this connection is closed
-    data_msg->msg["svs_lang"]="auto";
-    data_msg->msg["svs_itn"]=true;
+    data_msg->config = std::make_shared<FUNASR_SESSION_CONFIG>();
     FUNASR_DEC_HANDLE decoder_handle =
       FunASRWfstDecoderInit(tpass_handle, ASR_TWO_PASS, global_beam_, lattice_beam_, am_scale_);
     data_msg->decoder_handle = decoder_handle;
     data_msg->punc_cache =
         std::make_shared<std::vector<std::vector<std::string>>>(2);
   	data_msg->strand_ =	std::make_shared<asio::io_context::strand>(io_decoder_);
+    data_msg->offline_strand_ =
+        std::make_shared<asio::io_context::strand>(io_offline_);
 
-    data_map.emplace(hdl, data_msg);
+    data_map.Insert(hdl, data_msg);
+    if (admission_.RejectConnection()) {
+      reject_busy(hdl, data_msg, "server busy");
+    }
   }catch (std::exception const& e) {
     std::cerr << "Error: " << e.what() << std::endl;
   }
 }
 
-void remove_hdl(
-    websocketpp::connection_hdl hdl,
-    std::map<websocketpp::connection_hdl, std::shared_ptr<FUNASR_MESSAGE>,
-             std::owner_less<websocketpp::connection_hdl>>& data_map) {
- 
-  std::shared_ptr<FUNASR_MESSAGE> data_msg = nullptr;
-  auto it_data = data_map.find(hdl);
-  if (it_data != data_map.end()) {
-    data_msg = it_data->second;
-  } else {
+void WebSocketServer::on_close(websocketpp::connection_hdl hdl) {
+  std::shared_ptr<FUNASR_MESSAGE> data_msg = data_map.Erase(hdl);
+  if (data_msg == nullptr) {
     return;
   }
-  // scoped_lock guard_decoder(*(data_msg->thread_lock));  //wait for do_decoder
-  // finished and avoid access freed tpass_online_handle
-  unique_lock guard_decoder(*(data_msg->thread_lock));
-  if (data_msg->msg["access_num"]==0 && data_msg->msg["is_eof"]==true) {
-    FunWfstDecoderUnloadHwsRes(data_msg->decoder_handle);
-    FunASRWfstDecoderUninit(data_msg->decoder_handle);
-    data_msg->decoder_handle = nullptr;
-    FunTpassOnlineUninit(data_msg->tpass_online_handle);
-    data_msg->tpass_online_handle = nullptr;
-	  data_map.erase(hdl);
+  // decoder jobs still queued on the strand see is_eof and return early, the
+  // last one to finish releases the handles, else it happens right here
+  data_msg->is_eof=true;
+}
+
+// the ticket of a decoder job holding bytes of the session's audio, the
+// bytes count as buffered by the connection until the job is done
+static funasr::AdmissionTicket hold_queued_bytes(funasr::AdmissionTicket ticket,
+                                                 std::shared_ptr<FUNASR_MESSAGE> session,
+                                                 size_t bytes) {
+  session->queued_bytes += bytes;
+  return funasr::AdmissionTicket(ticket.get(), [ticket, session, bytes](void*) {
+    session->queued_bytes -= bytes;
+  });
+}
+
+// the client gets a final busy result and a try again later close, nothing
+// of the session is queued after this
+void WebSocketServer::reject_busy(websocketpp::connection_hdl hdl,
+                                  std::shared_ptr<FUNASR_MESSAGE>& session,
+                                  const std::string& reason) {
+  session->is_eof = true;
+  LOG(WARNING) << "reject " << session->config->wav_name << ": " << reason;
+  websocketpp::lib::error_code ec;
+  nlohmann::json jsonresult;
+  jsonresult["text"] = "";
+  jsonresult["wav_name"] = session->config->wav_name;
+  jsonresult["is_final"] = true;
+  jsonresult["busy"] = true;
+  jsonresult["reason"] = reason;
+  if (is_ssl) {
+    wss_server_->send(hdl, jsonresult.dump(),
+                      websocketpp::frame::opcode::text, ec);
+    wss_server_->close(hdl, websocketpp::close::status::try_again_later,
+                       reason, ec);
+  } else {
+    server_->send(hdl, jsonresult.dump(),
+                  websocketpp::frame::opcode::text, ec);
+    server_->close(hdl, websocketpp::close::status::try_again_later,
+                   reason, ec);
   }
- 
-  guard_decoder.unlock();
 }
 
-void WebSocketServer::on_close(websocketpp::connection_hdl hdl) {
-  scoped_lock guard(m_lock);
-  std::shared_ptr<FUNASR_MESSAGE> data_msg = nullptr;
-  auto it_data = data_map.find(hdl);
-  if (it_data != data_map.end()) {
-    data_msg = it_data->second;
+template <typename ConnectionPtr>
+static void reply_stats(ConnectionPtr con, const std::string& stats) {
+  if (con->get_resource() == "/stats") {
+    con->set_status(websocketpp::http::status_code::ok);
+    con->append_header("Content-Type", "application/json");
+    con->set_body(stats);
   } else {
-    return;
+    con->set_status(websocketpp::http::status_code::not_found);
+  }
+}
+
+void WebSocketServer::on_http(websocketpp::connection_hdl hdl) {
+  if (is_ssl) {
+    reply_stats(wss_server_->get_con_from_hdl(hdl), admission_.StatsJson());
+  } else {
+    reply_stats(server_->get_con_from_hdl(hdl), admission_.StatsJson());
   }
-  unique_lock guard_decoder(*(data_msg->thread_lock));
-  data_msg->msg["is_eof"]=true;
-  guard_decoder.unlock();
 }
  
-// remove closed connection
-void WebSocketServer::check_and_clean_connection() {
+// log the engine statistics when they change
+void WebSocketServer::report_stats() {
+  long long last_batches[2] = {0, 0};
+  long long last_vad_batches = 0;
+  long long last_hw_lookups = 0;
+  long long last_compute_runs = 0;
+  long long last_admitted = 0, last_rejected = 0;
   while(true){
     std::this_thread::sleep_for(std::chrono::milliseconds(5000));
-    std::vector<websocketpp::connection_hdl> to_remove;  // remove list
-    auto iter = data_map.begin();
-    while (iter != data_map.end()) {  // loop to find closed connection
-      websocketpp::connection_hdl hdl = iter->first;
-      try{
-        if (is_ssl) {
-          wss_server::connection_ptr con = wss_server_->get_con_from_hdl(hdl);
-          if (con->get_state() != 1) {  // session::state::open ==1
-            to_remove.push_back(hdl);
-          }
-        } else {
-          server::connection_ptr con = server_->get_con_from_hdl(hdl);
-          if (con->get_state() != 1) {  // session::state::open ==1
-            to_remove.push_back(hdl);
-          }
-        }
-      }
-      catch (std::exception const &e)
-      {
-        // if connection is close, we set is_eof = true
-        std::shared_ptr<FUNASR_MESSAGE> data_msg = nullptr;
-        auto it_data = data_map.find(hdl);
-        if (it_data != data_map.end()) {
-          data_msg = it_data->second;
-        } else {
-            continue;
-        }
-        unique_lock guard_decoder(*(data_msg->thread_lock));
-        data_msg->msg["is_eof"]=true;
-        guard_decoder.unlock();
-        to_remove.push_back(hdl);
-        LOG(INFO)<<"connection is closed.";
-        
-      }
-      iter++;
+    funasr::AdmissionStats admission_stats = admission_.GetStats();
+    if (admission_stats.admitted != last_admitted ||
+        admission_stats.rejected != last_rejected) {
+      last_admitted = admission_stats.admitted;
+      last_rejected = admission_stats.rejected;
+      LOG(INFO) << "admission: tasks=" << admission_stats.tasks
+                << ", queued_seconds=" << admission_stats.queued_seconds
+                << ", admitted=" << admission_stats.admitted
+                << ", rejected=" << admission_stats.rejected;
     }
-    for (auto hdl : to_remove) {
-      {
-        unique_lock lock(m_lock);
-        remove_hdl(hdl, data_map);
+    FUNASR_COMPUTE_STATS compute_stats = FunGetComputeStats();
+    if (compute_stats.runs != last_compute_runs) {
+      last_compute_runs = compute_stats.runs;
+      LOG(INFO) << "compute: slots=" << compute_stats.slots
+                << ", running=" << compute_stats.running
+                << ", waiting=" << compute_stats.waiting
+                << ", runs=" << compute_stats.runs
+                << ", waits=" << compute_stats.waits;
+    }
+    FUNASR_CACHE_STATS emb_stats = FunGetHotwordCacheStats(tpass_handle, false, ASR_TWO_PASS);
+    FUNASR_CACHE_STATS fst_stats = FunGetHotwordCacheStats(tpass_handle, true, ASR_TWO_PASS);
+    long long hw_lookups = emb_stats.hits + emb_stats.misses + fst_stats.hits + fst_stats.misses;
+    if (hw_lookups != last_hw_lookups) {
+      last_hw_lookups = hw_lookups;
+      LOG(INFO) << "hotword cache: emb_hits=" << emb_stats.hits
+                << ", emb_misses=" << emb_stats.misses
+                << ", emb_bytes=" << emb_stats.bytes
+                << ", fst_hits=" << fst_stats.hits
+                << ", fst_misses=" << fst_stats.misses
+                << ", fst_bytes=" << fst_stats.bytes;
+    }
+    for (int i = 0; i < 2; i++) {
+      ASR_TYPE mode = i == 0 ? ASR_OFFLINE : ASR_ONLINE;
+      FUNASR_BATCH_STATS stats = FunTpassGetBatchStats(tpass_handle, mode);
+      if (stats.batches != last_batches[i]) {
+        last_batches[i] = stats.batches;
+        LOG(INFO) << (mode == ASR_OFFLINE ? "offline batcher" : "online batcher")
+                  << ": queue_depth=" << stats.queue_depth
+                  << ", batches=" << stats.batches
+                  << ", segments=" << stats.segments
+                  << ", avg_batch=" << stats.avg_batch
+                  << ", max_batch=" << stats.max_batch
+                  << ", avg_wait_ms=" << stats.avg_wait_ms;
       }
     }
+    FUNASR_BATCH_STATS vad_stats = FunTpassGetVadBatchStats(tpass_handle);
+    if (vad_stats.batches != last_vad_batches) {
+      last_vad_batches = vad_stats.batches;
+      LOG(INFO) << "vad batcher: queue_depth=" << vad_stats.queue_depth
+                << ", batches=" << vad_stats.batches
+                << ", chunks=" << vad_stats.segments
+                << ", avg_batch=" << vad_stats.avg_batch
+                << ", max_batch=" << vad_stats.max_batch
+                << ", avg_wait_ms=" << vad_stats.avg_wait_ms;
+    }
   }
 }
 void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
                                  message_ptr msg) {
-  unique_lock lock(m_lock);
   // find the sample data vector according to one connection
-
-  std::shared_ptr<FUNASR_MESSAGE> msg_data = nullptr;
-
-  auto it_data = data_map.find(hdl);
-  if (it_data != data_map.end()) {
-    msg_data = it_data->second;
-    if(msg_data->msg["is_eof"]){
-      lock.unlock();
-      return;
-    }
-  } else {
-    lock.unlock();
+  std::shared_ptr<FUNASR_MESSAGE> msg_data = data_map.Find(hdl);
+  if (msg_data == nullptr || msg_data->is_eof) {
     return;
   }
 
-  std::shared_ptr<std::vector<char>> sample_data_p = msg_data->samples;
-  std::shared_ptr<std::vector<std::vector<std::string>>> punc_cache_p =
-      msg_data->punc_cache;
+  std::shared_ptr<AudioByteQueue> sample_data_p = msg_data->samples;
   std::shared_ptr<websocketpp::lib::mutex> thread_lock_p = msg_data->thread_lock;
 
-  lock.unlock();
-
   if (sample_data_p == nullptr) {
     LOG(INFO) << "error when fetch sample data vector";
     return;
@@ -399,19 +532,16 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
       }catch (std::exception const &e)
       {
         LOG(ERROR)<<e.what();
-        msg_data->msg["is_eof"]=true;
+        msg_data->is_eof=true;
         guard_decoder.unlock();
         return;
       }
 
-      if (jsonresult.contains("wav_name")) {
-        msg_data->msg["wav_name"] = jsonresult["wav_name"];
-      }
-      if (jsonresult.contains("mode")) {
-        msg_data->msg["mode"] = jsonresult["mode"];
-      }
-      if (jsonresult.contains("wav_format")) {
-        msg_data->msg["wav_format"] = jsonresult["wav_format"];
+      try{
+        update_config(jsonresult, msg_data->config);
+      }catch (std::exception const &e)
+      {
+        LOG(ERROR)<<e.what();
       }
 
       // hotwords: fst/nn
@@ -455,14 +585,10 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
         FunWfstDecoderLoadHwsRes(msg_data->decoder_handle, fst_inc_wts_, merged_hws_map);
 
         // nn
-        std::vector<std::vector<float>> new_hotwords_embedding = CompileHotwordEmbedding(tpass_handle, nn_hotwords, ASR_TWO_PASS);
         msg_data->hotwords_embedding =
-            std::make_shared<std::vector<std::vector<float>>>(new_hotwords_embedding);
+            CompileSharedHotwordEmbedding(tpass_handle, nn_hotwords, ASR_TWO_PASS);
       }
 
-      if (jsonresult.contains("audio_fs")) {
-        msg_data->msg["audio_fs"] = jsonresult["audio_fs"];
-      }
       if (jsonresult.contains("chunk_size")) {
         if (msg_data->tpass_online_handle == nullptr) {
           std::vector<int> chunk_size_vec =
@@ -478,43 +604,28 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
           }
         }
       }
-      if (jsonresult.contains("itn")) {
-        msg_data->msg["itn"] = jsonresult["itn"];
-      }
-      if (jsonresult.contains("svs_lang")) {
-        msg_data->msg["svs_lang"] = jsonresult["svs_lang"];
-      }
-      if (jsonresult.contains("svs_itn")) {
-        msg_data->msg["svs_itn"] = jsonresult["svs_itn"];
-      }
       LOG(INFO) << "jsonresult=" << jsonresult
-                << ", msg_data->msg=" << msg_data->msg;
+                << ", wav_name=" << msg_data->config->wav_name
+                << ", mode=" << msg_data->config->mode;
       if ((jsonresult["is_speaking"] == false ||
           jsonresult["is_finished"] == true) && 
-          msg_data->msg["is_eof"] != true &&
+          !msg_data->is_eof &&
           msg_data->hotwords_embedding != nullptr) {
         LOG(INFO) << "client done";
 
         // if it is in final message, post the sample_data to decode
         try{
-		  
-          std::vector<std::vector<float>> hotwords_embedding_(*(msg_data->hotwords_embedding));
+          funasr::AdmissionTicket ticket =
+              admission_.Admit(sample_data_p->Size(), msg_data->config->audio_fs);
+          if (!ticket) {
+            reject_busy(hdl, msg_data, "server busy");
+            break;
+          }
+          ticket = hold_queued_bytes(std::move(ticket), msg_data, sample_data_p->Size());
           msg_data->strand_->post(
               std::bind(&WebSocketServer::do_decoder, this,
-                        std::move(*(sample_data_p.get())), std::move(hdl),
-                        std::ref(msg_data->msg), std::ref(*(punc_cache_p.get())),
-                        std::move(hotwords_embedding_),
-                        std::ref(*thread_lock_p), std::move(true),
-                        msg_data->msg["wav_name"],
-                        msg_data->msg["mode"],
-                        msg_data->msg["itn"],
-                        msg_data->msg["audio_fs"],
-                        msg_data->msg["wav_format"],
-                        std::ref(msg_data->tpass_online_handle),
-                        std::ref(msg_data->decoder_handle),
-                        msg_data->msg["svs_lang"],
-                        msg_data->msg["svs_itn"]));
-		      msg_data->msg["access_num"]=(int)(msg_data->msg["access_num"])+1;
+                        sample_data_p->TakeAll(), std::move(hdl), msg_data,
+                        std::move(true), msg_data->config, std::move(ticket)));
         }
         catch (std::exception const &e)
         {
@@ -528,43 +639,39 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
       const auto* pcm_data = static_cast<const char*>(payload.data());
       int32_t num_samples = payload.size();
 
+      // the queue keeps msg alive instead of copying its payload
+      sample_data_p->Push(msg, pcm_data, num_samples);
+      // the online path moves the audio into decoder jobs as it comes, so
+      // the bytes those jobs still hold count as buffered too
+      if (admission_.ConnectionOverLimit(sample_data_p->Size() + msg_data->queued_bytes)) {
+        reject_busy(hdl, msg_data, "connection audio over limit");
+        break;
+      }
       if (isonline) {
-        sample_data_p->insert(sample_data_p->end(), pcm_data,
-                              pcm_data + num_samples);
         int setpsize =
             800 * 2;  // TODO, need get from client
                       // if sample_data size > setpsize, we post data to decode
-        if (sample_data_p->size() > setpsize) {
-          int chunksize = floor(sample_data_p->size() / setpsize);
-          // make sure the subvector size is an integer multiple of setpsize
-          std::vector<char> subvector = {
-              sample_data_p->begin(),
-              sample_data_p->begin() + chunksize * setpsize};
+        if (sample_data_p->Size() > setpsize) {
+          int chunksize = floor(sample_data_p->Size() / setpsize);
+          // make sure the subvector size is an integer multiple of setpsize,
           // keep remain in sample_data
-          sample_data_p->erase(sample_data_p->begin(),
-                               sample_data_p->begin() + chunksize * setpsize);
+          AudioByteQueue subvector = sample_data_p->Take(chunksize * setpsize);
 
           try{
             // post to decode
-            if (msg_data->msg["is_eof"] != true && msg_data->hotwords_embedding != nullptr) {
-              std::vector<std::vector<float>> hotwords_embedding_(*(msg_data->hotwords_embedding));
+            if (!msg_data->is_eof && msg_data->hotwords_embedding != nullptr) {
+              funasr::AdmissionTicket ticket =
+                  admission_.Admit(subvector.Size(), msg_data->config->audio_fs);
+              if (!ticket) {
+                reject_busy(hdl, msg_data, "server busy");
+                break;
+              }
+              ticket = hold_queued_bytes(std::move(ticket), msg_data, subvector.Size());
               msg_data->strand_->post(
                         std::bind(&WebSocketServer::do_decoder, this,
                                   std::move(subvector), std::move(hdl),
-                                  std::ref(msg_data->msg),
-                                  std::ref(*(punc_cache_p.get())),
-                                  std::move(hotwords_embedding_),
-                                  std::ref(*thread_lock_p), std::move(false),
-                                  msg_data->msg["wav_name"],
-                                  msg_data->msg["mode"],
-                                  msg_data->msg["itn"],
-                                  msg_data->msg["audio_fs"],
-                                  msg_data->msg["wav_format"],
-                                  std::ref(msg_data->tpass_online_handle),
-                                  std::ref(msg_data->decoder_handle),
-                                  msg_data->msg["svs_lang"],
-                                  msg_data->msg["svs_itn"]));
-              msg_data->msg["access_num"]=(int)(msg_data->msg["access_num"])+1;
+                                  msg_data, std::move(false),
+                                  msg_data->config, std::move(ticket)));
             }
           }
           catch (std::exception const &e)
@@ -572,9 +679,6 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
             LOG(ERROR)<<e.what();
           }
         }
-      } else {
-        sample_data_p->insert(sample_data_p->end(), pcm_data,
-                              pcm_data + num_samples);
       }
       break;
     }
@@ -586,17 +690,20 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
 
 // init asr model
 void WebSocketServer::initAsr(std::map<std::string, std::string>& model_path,
-                              int thread_num) {
+                              int thread_num, int batch_size,
+                              int batch_wait_ms) {
   try {
-    tpass_handle = FunTpassInit(model_path, thread_num);
+    tpass_handle = FunTpassInit(model_path, thread_num, batch_size, batch_wait_ms);
     if (!tpass_handle) {
       LOG(ERROR) << "FunTpassInit init failed";
       exit(-1);
     }
-    LOG(INFO) << "initAsr run check_and_clean_connection";
-    std::thread clean_thread(&WebSocketServer::check_and_clean_connection,this);  
-    clean_thread.detach();
-    LOG(INFO) << "initAsr run check_and_clean_connection finished";
+    FunSetHotwordCacheLimit(tpass_handle, (long long)hotword_cache_mb_ << 20,
+                            (long long)hotword_fst_cache_mb_ << 20, ASR_TWO_PASS);
+    FunTpassSetVadEnergyGate(tpass_handle, vad_energy_gate_db_);
+    admission_.SetLimits(admission_limits_);
+    std::thread stats_thread(&WebSocketServer::report_stats, this);
+    stats_thread.detach();
 
   } catch (const std::exception& e) {
     LOG(INFO) << e.what();
@@ -13,6 +13,7 @@
 #ifndef WEBSOCKET_SERVER_H_
 #define WEBSOCKET_SERVER_H_
 
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -29,10 +30,13 @@
 #include <websocketpp/config/asio.hpp>
 #include <websocketpp/server.hpp>
 
+#include "admission-control.h"
 #include "asio.hpp"
+#include "audio-byte-queue.h"
 #include "com-define.h"
 #include "funasrruntime.h"
 #include "nlohmann/json.hpp"
+#include "session-map.h"
 #include "tclap/CmdLine.h"
 typedef websocketpp::server<websocketpp::config::asio> server;
 typedef websocketpp::server<websocketpp::config::asio_tls> wss_server;
@@ -51,16 +55,36 @@ typedef struct {
   float snippet_time;
 } FUNASR_RECOG_RESULT;
 
+// per connection settings sent by the client in its text frames. A decoder
+// job keeps the snapshot it was posted with, a later text frame replaces the
+// connection's pointer instead of changing it
 typedef struct {
-  nlohmann::json msg;
-  std::shared_ptr<std::vector<char>> samples;
+  std::string wav_name = "wav-default-id";
+  std::string mode = "2pass";
+  std::string wav_format = "pcm";
+  bool itn = true;
+  int audio_fs = 16000;  // default is 16k
+  std::string svs_lang = "auto";
+  bool svs_itn = true;
+} FUNASR_SESSION_CONFIG;
+
+// one connection's state. The session map and every posted decoder job hold
+// a reference, the engine handles are released by the deleter given in
+// on_open when the last of them lets go
+typedef struct {
+  std::shared_ptr<const FUNASR_SESSION_CONFIG> config;
+  std::atomic<bool> is_eof{false};  // if this connection is closed
+  std::shared_ptr<AudioByteQueue> samples;
   std::shared_ptr<std::vector<std::vector<std::string>>> punc_cache;
-  std::shared_ptr<std::vector<std::vector<float>>> hotwords_embedding=nullptr;
+  funasr::HotwordEmbeddingPtr hotwords_embedding=nullptr;
   std::shared_ptr<websocketpp::lib::mutex> thread_lock; // lock for each connection
   FUNASR_HANDLE tpass_online_handle=nullptr;
   std::string online_res = "";
   std::string tpass_res = "";
   std::shared_ptr<asio::io_context::strand>  strand_; // for data execute in order
+  std::shared_ptr<asio::io_context::strand>  offline_strand_; // offline pass, segments in order
+  std::atomic<bool> offline_queued{false};  // a do_offline job waits on offline_strand_
+  std::atomic<long long> queued_bytes{0};  // audio bytes held by posted do_decoder jobs
   FUNASR_DEC_HANDLE decoder_handle=nullptr; 
 } FUNASR_MESSAGE;
 
@@ -69,10 +93,12 @@ typedef struct {
 enum tls_mode { MOZILLA_INTERMEDIATE = 1, MOZILLA_MODERN = 2 };
 class WebSocketServer {
  public:
-  WebSocketServer(asio::io_context& io_decoder, bool is_ssl, server* server,
+  WebSocketServer(asio::io_context& io_decoder, asio::io_context& io_offline,
+                  bool is_ssl, server* server,
                   wss_server* wss_server, std::string& s_certfile,
                   std::string& s_keyfile)
       : io_decoder_(io_decoder),
+        io_offline_(io_offline),
         is_ssl(is_ssl),
         server_(server),
         wss_server_(wss_server) {
@@ -91,6 +117,9 @@ class WebSocketServer {
       // set close handle
       wss_server_->set_close_handler(
           [this](websocketpp::connection_hdl hdl) { on_close(hdl); });
+      // plain http on the same port, for the gauges
+      wss_server_->set_http_handler(
+          [this](websocketpp::connection_hdl hdl) { on_http(hdl); });
       // begin accept
       wss_server_->start_accept();
       // not print log
@@ -108,37 +137,46 @@ class WebSocketServer {
       // set close handle
       server_->set_close_handler(
           [this](websocketpp::connection_hdl hdl) { on_close(hdl); });
+      // plain http on the same port, for the gauges
+      server_->set_http_handler(
+          [this](websocketpp::connection_hdl hdl) { on_http(hdl); });
       // begin accept
       server_->start_accept();
       // not print log
       server_->clear_access_channels(websocketpp::log::alevel::all);
     }
   }
-  void do_decoder(std::vector<char>& buffer, websocketpp::connection_hdl& hdl,
-                  nlohmann::json& msg,
-                  std::vector<std::vector<std::string>>& punc_cache,
-                  std::vector<std::vector<float>> &hotwords_embedding,
-                  websocketpp::lib::mutex& thread_lock, bool& is_final,
-                  std::string wav_name,
-                  std::string modetype,
-                  bool itn,
-                  int audio_fs,
-                  std::string wav_format,
-                  FUNASR_HANDLE& tpass_online_handle,
-                  FUNASR_DEC_HANDLE& decoder_handle,
-                  std::string svs_lang,
-                  bool sys_itn);
+  void do_decoder(AudioByteQueue& buffer, websocketpp::connection_hdl& hdl,
+                  std::shared_ptr<FUNASR_MESSAGE>& session, bool& is_final,
+                  std::shared_ptr<const FUNASR_SESSION_CONFIG>& config,
+                  funasr::AdmissionTicket& ticket);
+  // offline pass of the segments the first pass queued, is_final sends the
+  // final result after them
+  void do_offline(websocketpp::connection_hdl& hdl,
+                  std::shared_ptr<FUNASR_MESSAGE>& session, bool& is_final,
+                  std::shared_ptr<const FUNASR_SESSION_CONFIG>& config,
+                  funasr::AdmissionTicket& ticket);
 
-  void initAsr(std::map<std::string, std::string>& model_path, int thread_num);
+  void initAsr(std::map<std::string, std::string>& model_path, int thread_num,
+               int batch_size = 1, int batch_wait_ms = 20);
   void on_message(websocketpp::connection_hdl hdl, message_ptr msg);
   void on_open(websocketpp::connection_hdl hdl);
   void on_close(websocketpp::connection_hdl hdl);
+  // GET /stats answers the admission gauges as json
+  void on_http(websocketpp::connection_hdl hdl);
   context_ptr on_tls_init(tls_mode mode, websocketpp::connection_hdl hdl,
                           std::string& s_certfile, std::string& s_keyfile);
 
  private:
-  void check_and_clean_connection();
-  asio::io_context& io_decoder_;  // threads for asr decoder
+  void report_stats();
+  void send_result(websocketpp::connection_hdl& hdl,
+                   const nlohmann::json& jsonresult);
+  // tells the client the server is busy and closes with try again later
+  void reject_busy(websocketpp::connection_hdl hdl,
+                   std::shared_ptr<FUNASR_MESSAGE>& session,
+                   const std::string& reason);
+  asio::io_context& io_decoder_;  // threads for the vad and online asr
+  asio::io_context& io_offline_;  // threads for the offline pass
   // std::ofstream fout;
   // FUNASR_HANDLE asr_handle;  // asr engine handle
   FUNASR_HANDLE tpass_handle=nullptr;
@@ -147,13 +185,10 @@ class WebSocketServer {
   server* server_;          // websocket server
   wss_server* wss_server_;  // websocket server
 
-  // use map to keep the received samples data from one connection in offline
-  // engine. if for online engline, a data struct is needed(TODO)
-
-  std::map<websocketpp::connection_hdl, std::shared_ptr<FUNASR_MESSAGE>,
-           std::owner_less<websocketpp::connection_hdl>>
-      data_map;
-  websocketpp::lib::mutex m_lock;  // mutex for sample_map
+  // the sessions of the open connections, an entry is removed in on_close
+  SessionMap<FUNASR_MESSAGE> data_map;
+  // bounds the decoder jobs queued on io_decoder_
+  funasr::AdmissionControl admission_;
 };
 
 #endif  // WEBSOCKET_SERVER_H_
@@ -18,7 +18,10 @@
 
 extern std::unordered_map<std::string, int> hws_map_;
 extern int fst_inc_wts_;
+extern int hotword_cache_mb_, hotword_fst_cache_mb_;
 extern float global_beam_, lattice_beam_, am_scale_;
+extern funasr::AdmissionLimits admission_limits_;
+extern int vad_thread_num_, vad_window_seconds_;
 
 context_ptr WebSocketServer::on_tls_init(tls_mode mode,
                                          websocketpp::connection_hdl hdl,
@@ -58,22 +61,34 @@ context_ptr WebSocketServer::on_tls_init(tls_mode mode,
 }
 
 // feed buffer to asr engine for decoder
-void WebSocketServer::do_decoder(const std::vector<char>& buffer,
+void WebSocketServer::do_decoder(AudioByteQueue& samples,
                                  websocketpp::connection_hdl& hdl,
-                                 nlohmann::json& msg,
-                                 websocketpp::lib::mutex& thread_lock,
-                                 std::vector<std::vector<float>> &hotwords_embedding,
-                                 std::string wav_name,
-                                 bool itn,
-                                 int audio_fs,
-                                 std::string wav_format,
-                                 FUNASR_DEC_HANDLE& decoder_handle,
-                                 std::string svs_lang,
-                                 bool sys_itn) {
+                                 std::shared_ptr<FUNASR_MESSAGE>& session,
+                                 std::shared_ptr<const FUNASR_SESSION_CONFIG>& config,
+                                 funasr::AdmissionTicket& ticket) {
+  // the job holds the session, so its handles stay valid until it returns,
+  // and its admission ticket until it is done
+  funasr::HotwordEmbeddingPtr& hotwords_embedding = session->hotwords_embedding;
+  FUNASR_DEC_HANDLE& decoder_handle = session->decoder_handle;
+  const std::string& wav_name = config->wav_name;
+  const std::string& wav_format = config->wav_format;
+  const std::string& svs_lang = config->svs_lang;
+  bool itn = config->itn;
+  int audio_fs = config->audio_fs;
+  bool sys_itn = config->svs_itn;
+  if (session->is_eof) {
+    LOG(INFO) << "connection is closed, skip decoding " << wav_name;
+    return;
+  }
   try {
+    // the engine wants one buffer, gather the received messages once here
+    // on the decoder thread and let them go
+    std::vector<char> buffer(samples.Size());
+    samples.CopyTo(buffer.data(), buffer.size());
+    samples.Pop(samples.Size());
     int num_samples = buffer.size();  // the size of the buf
 
-    if (!buffer.empty() && hotwords_embedding.size() > 0) {
+    if (!buffer.empty() && hotwords_embedding && !hotwords_embedding->Empty()) {
       std::string asr_result="";
       std::string stamp_res="";
       std::string stamp_sents="";
@@ -147,143 +162,177 @@ void WebSocketServer::do_decoder(const std::vector<char>& buffer,
   } catch (std::exception const& e) {
     std::cerr << "Error: " << e.what() << std::endl;
   }
-  scoped_lock guard(thread_lock);
-  msg["access_num"]=(int)msg["access_num"]-1;
+}
+
+// copies the session settings with the fields of a client text frame
+// applied, decoder jobs already posted keep the old snapshot
+void update_config(const nlohmann::json& jsonresult,
+                   std::shared_ptr<const FUNASR_SESSION_CONFIG>& config) {
+  std::shared_ptr<FUNASR_SESSION_CONFIG> new_config =
+      std::make_shared<FUNASR_SESSION_CONFIG>(*config);
+  if (jsonresult.contains("wav_name")) {
+    new_config->wav_name = jsonresult["wav_name"].get<std::string>();
+  }
+  if (jsonresult.contains("wav_format")) {
+    new_config->wav_format = jsonresult["wav_format"].get<std::string>();
+  }
+  if (jsonresult.contains("audio_fs")) {
+    new_config->audio_fs = jsonresult["audio_fs"].get<int>();
+  }
+  if (jsonresult.contains("itn")) {
+    new_config->itn = jsonresult["itn"].get<bool>();
+  }
+  if (jsonresult.contains("svs_lang")) {
+    new_config->svs_lang = jsonresult["svs_lang"].get<std::string>();
+  }
+  if (jsonresult.contains("svs_itn")) {
+    new_config->svs_itn = jsonresult["svs_itn"].get<bool>();
+  }
+  config = new_config;
+}
+
+// frees the engine handles of a session, called by its shared_ptr when
+// neither the session map nor a decoder job refers to it any more
+void release_session(FUNASR_MESSAGE* data_msg) {
+  try{
+    FunWfstDecoderUnloadHwsRes(data_msg->decoder_handle);
+    FunASRWfstDecoderUninit(data_msg->decoder_handle);
+    data_msg->decoder_handle = nullptr;
+  }catch (std::exception const& e) {
+    LOG(ERROR) << e.what();
+  }
+  delete data_msg;
+  LOG(INFO) << "remove one connection";
 }
 
 void WebSocketServer::on_open(websocketpp::connection_hdl hdl) {
-  scoped_lock guard(m_lock);     // for threads safty
-  std::shared_ptr<FUNASR_MESSAGE> data_msg =
-      std::make_shared<FUNASR_MESSAGE>();  // put a new data vector for new
-                                           // connection
-  data_msg->samples = std::make_shared<std::vector<char>>();
+  std::shared_ptr<FUNASR_MESSAGE> data_msg(
+      new FUNASR_MESSAGE(), release_session);  // put a new data vector for
+                                                // new connection
+  data_msg->samples = std::make_shared<AudioByteQueue>();
   data_msg->thread_lock = std::make_shared<websocketpp::lib::mutex>();
-  data_msg->msg = nlohmann::json::parse("{}");
-  data_msg->msg["wav_format"] = "pcm";
-  data_msg->msg["wav_name"] = "wav-default-id";
-  data_msg->msg["itn"] = true;
-  data_msg->msg["audio_fs"] = 16000; // default is 16k
-  data_msg->msg["access_num"] = 0; // the number of access for this object, when it is 0, we can free it saftly
-  data_msg->msg["is_eof"]=false;
-  data_msg->msg["svs_lang"]="auto";
-  data_msg->msg["svs_itn"]=true;
+  data_msg->config = std::make_shared<FUNASR_SESSION_CONFIG>();
   FUNASR_DEC_HANDLE decoder_handle =
     FunASRWfstDecoderInit(asr_handle, ASR_OFFLINE, global_beam_, lattice_beam_, am_scale_);
   data_msg->decoder_handle = decoder_handle;
-  data_map.emplace(hdl, data_msg);
-  LOG(INFO) << "on_open, active connections: " << data_map.size();
+  data_map.Insert(hdl, data_msg);
+  active_connections_++;
+  LOG(INFO) << "on_open, active connections: " << active_connections_;
+  if (admission_.RejectConnection()) {
+    reject_busy(hdl, data_msg, "server busy");
+  }
 }
 
 void WebSocketServer::on_close(websocketpp::connection_hdl hdl) {
-  scoped_lock guard(m_lock);
-
-  std::shared_ptr<FUNASR_MESSAGE> data_msg = nullptr;
-  auto it_data = data_map.find(hdl);
-  if (it_data != data_map.end()) {
-    data_msg = it_data->second;
-  } else {
+  std::shared_ptr<FUNASR_MESSAGE> data_msg = data_map.Erase(hdl);
+  if (data_msg == nullptr) {
     return;
   }
-  unique_lock guard_decoder(*(data_msg->thread_lock));
-  data_msg->msg["is_eof"]=true;
-  guard_decoder.unlock();
+  // a decoder job still queued sees is_eof and skips decoding, the handles
+  // are released when it returns, else right here
+  data_msg->is_eof=true;
+  active_connections_--;
+  LOG(INFO) << "on_close, active connections: " << active_connections_;
+}
 
-  LOG(INFO) << "on_close, active connections: " << data_map.size();
+// the client gets a final busy result and a try again later close, nothing
+// of the session is queued after this
+void WebSocketServer::reject_busy(websocketpp::connection_hdl hdl,
+                                  std::shared_ptr<FUNASR_MESSAGE>& session,
+                                  const std::string& reason) {
+  session->is_eof = true;
+  LOG(WARNING) << "reject " << session->config->wav_name << ": " << reason;
+  websocketpp::lib::error_code ec;
+  nlohmann::json jsonresult;
+  jsonresult["text"] = "";
+  jsonresult["wav_name"] = session->config->wav_name;
+  jsonresult["is_final"] = true;
+  jsonresult["busy"] = true;
+  jsonresult["reason"] = reason;
+  if (is_ssl) {
+    wss_server_->send(hdl, jsonresult.dump(),
+                      websocketpp::frame::opcode::text, ec);
+    wss_server_->close(hdl, websocketpp::close::status::try_again_later,
+                       reason, ec);
+  } else {
+    server_->send(hdl, jsonresult.dump(),
+                  websocketpp::frame::opcode::text, ec);
+    server_->close(hdl, websocketpp::close::status::try_again_later,
+                   reason, ec);
+  }
 }
 
-void remove_hdl(
-    websocketpp::connection_hdl hdl,
-    std::map<websocketpp::connection_hdl, std::shared_ptr<FUNASR_MESSAGE>,
-             std::owner_less<websocketpp::connection_hdl>>& data_map) {
-  std::shared_ptr<FUNASR_MESSAGE> data_msg = nullptr;
-  auto it_data = data_map.find(hdl);
-  if (it_data != data_map.end()) {
-    data_msg = it_data->second;
+template <typename ConnectionPtr>
+static void reply_stats(ConnectionPtr con, const std::string& stats) {
+  if (con->get_resource() == "/stats") {
+    con->set_status(websocketpp::http::status_code::ok);
+    con->append_header("Content-Type", "application/json");
+    con->set_body(stats);
   } else {
-    return;
+    con->set_status(websocketpp::http::status_code::not_found);
   }
-  unique_lock guard_decoder(*(data_msg->thread_lock));
-  if (data_msg->msg["access_num"]==0 && data_msg->msg["is_eof"]==true) {
-    FunWfstDecoderUnloadHwsRes(data_msg->decoder_handle);
-    FunASRWfstDecoderUninit(data_msg->decoder_handle);
-    data_msg->decoder_handle = nullptr;
-	  data_map.erase(hdl);
-    LOG(INFO) << "remove one connection";
+}
+
+void WebSocketServer::on_http(websocketpp::connection_hdl hdl) {
+  if (is_ssl) {
+    reply_stats(wss_server_->get_con_from_hdl(hdl), admission_.StatsJson());
+  } else {
+    reply_stats(server_->get_con_from_hdl(hdl), admission_.StatsJson());
   }
-  guard_decoder.unlock();
 }
 
-void WebSocketServer::check_and_clean_connection() {
+// log the engine statistics when they change
+void WebSocketServer::report_stats() {
+  long long last_hw_lookups = 0;
+  long long last_compute_runs = 0;
+  long long last_admitted = 0, last_rejected = 0;
   while(true){
     std::this_thread::sleep_for(std::chrono::milliseconds(5000));
-    std::vector<websocketpp::connection_hdl> to_remove;  // remove list
-    auto iter = data_map.begin();
-    while (iter != data_map.end()) {  // loop to find closed connection
-      websocketpp::connection_hdl hdl = iter->first;
-      try{
-        if (is_ssl) {
-          wss_server::connection_ptr con = wss_server_->get_con_from_hdl(hdl);
-          if (con->get_state() != 1) {  // session::state::open ==1
-            to_remove.push_back(hdl);
-          }
-        } else {
-          server::connection_ptr con = server_->get_con_from_hdl(hdl);
-          if (con->get_state() != 1) {  // session::state::open ==1
-            to_remove.push_back(hdl);
-          }
-        }
-      }
-      catch (std::exception const &e)
-      {
-        // if connection is close, we set is_eof = true
-        std::shared_ptr<FUNASR_MESSAGE> data_msg = nullptr;
-        auto it_data = data_map.find(hdl);
-        if (it_data != data_map.end()) {
-          data_msg = it_data->second;
-        } else {
-            continue;
-        }
-        unique_lock guard_decoder(*(data_msg->thread_lock));
-        data_msg->msg["is_eof"]=true;
-        guard_decoder.unlock();
-        to_remove.push_back(hdl);
-        LOG(INFO)<<"connection is closed.";
-        
-      }
-      iter++;
+    funasr::AdmissionStats admission_stats = admission_.GetStats();
+    if (admission_stats.admitted != last_admitted ||
+        admission_stats.rejected != last_rejected) {
+      last_admitted = admission_stats.admitted;
+      last_rejected = admission_stats.rejected;
+      LOG(INFO) << "admission: tasks=" << admission_stats.tasks
+                << ", queued_seconds=" << admission_stats.queued_seconds
+                << ", admitted=" << admission_stats.admitted
+                << ", rejected=" << admission_stats.rejected;
     }
-    for (auto hdl : to_remove) {
-      {
-        unique_lock lock(m_lock);
-        remove_hdl(hdl, data_map);
-      }
+    FUNASR_COMPUTE_STATS compute_stats = FunGetComputeStats();
+    if (compute_stats.runs != last_compute_runs) {
+      last_compute_runs = compute_stats.runs;
+      LOG(INFO) << "compute: slots=" << compute_stats.slots
+                << ", running=" << compute_stats.running
+                << ", waiting=" << compute_stats.waiting
+                << ", runs=" << compute_stats.runs
+                << ", waits=" << compute_stats.waits;
+    }
+    FUNASR_CACHE_STATS emb_stats = FunGetHotwordCacheStats(asr_handle, false);
+    FUNASR_CACHE_STATS fst_stats = FunGetHotwordCacheStats(asr_handle, true);
+    long long hw_lookups = emb_stats.hits + emb_stats.misses + fst_stats.hits + fst_stats.misses;
+    if (hw_lookups != last_hw_lookups) {
+      last_hw_lookups = hw_lookups;
+      LOG(INFO) << "hotword cache: emb_hits=" << emb_stats.hits
+                << ", emb_misses=" << emb_stats.misses
+                << ", emb_bytes=" << emb_stats.bytes
+                << ", fst_hits=" << fst_stats.hits
+                << ", fst_misses=" << fst_stats.misses
+                << ", fst_bytes=" << fst_stats.bytes;
     }
   }
 }
 
 void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
                                  message_ptr msg) {
-  unique_lock lock(m_lock);
   // find the sample data vector according to one connection
-
-  std::shared_ptr<FUNASR_MESSAGE> msg_data = nullptr;
-
-  auto it_data = data_map.find(hdl);
-  if (it_data != data_map.end()) {
-    msg_data = it_data->second;
-    if(msg_data->msg["is_eof"]){
-      lock.unlock();
-      return;
-    }
-  } else{
-    lock.unlock();
+  std::shared_ptr<FUNASR_MESSAGE> msg_data = data_map.Find(hdl);
+  if (msg_data == nullptr || msg_data->is_eof) {
     return;
   }
 
-  std::shared_ptr<std::vector<char>> sample_data_p = msg_data->samples;
+  std::shared_ptr<AudioByteQueue> sample_data_p = msg_data->samples;
   std::shared_ptr<websocketpp::lib::mutex> thread_lock_p = msg_data->thread_lock;
 
-  lock.unlock();
   if (sample_data_p == nullptr) {
     LOG(INFO) << "error when fetch sample data vector";
     return;
@@ -299,16 +348,16 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
       }catch (std::exception const &e)
       {
         LOG(ERROR)<<e.what();
-        msg_data->msg["is_eof"]=true;
+        msg_data->is_eof=true;
         guard_decoder.unlock();
         return;
       }
 
-      if (jsonresult["wav_name"] != nullptr) {
-        msg_data->msg["wav_name"] = jsonresult["wav_name"];
-      }
-      if (jsonresult["wav_format"] != nullptr) {
-        msg_data->msg["wav_format"] = jsonresult["wav_format"];
+      try{
+        update_config(jsonresult, msg_data->config);
+      }catch (std::exception const &e)
+      {
+        LOG(ERROR)<<e.what();
       }
 
       // hotwords: fst/nn
@@ -352,44 +401,26 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
         FunWfstDecoderLoadHwsRes(msg_data->decoder_handle, fst_inc_wts_, merged_hws_map);
 
         // nn
-        std::vector<std::vector<float>> new_hotwords_embedding= CompileHotwordEmbedding(asr_handle, nn_hotwords);
         msg_data->hotwords_embedding =
-            std::make_shared<std::vector<std::vector<float>>>(new_hotwords_embedding);
-      }
-      if (jsonresult.contains("audio_fs")) {
-        msg_data->msg["audio_fs"] = jsonresult["audio_fs"];
-      }
-      if (jsonresult.contains("itn")) {
-        msg_data->msg["itn"] = jsonresult["itn"];
-      }
-      if (jsonresult.contains("svs_lang")) {
-        msg_data->msg["svs_lang"] = jsonresult["svs_lang"];
-      }
-      if (jsonresult.contains("svs_itn")) {
-        msg_data->msg["svs_itn"] = jsonresult["svs_itn"];
+            CompileSharedHotwordEmbedding(asr_handle, nn_hotwords);
       }
       if ((jsonresult["is_speaking"] == false ||
           jsonresult["is_finished"] == true) && 
-          msg_data->msg["is_eof"] != true && 
+          !msg_data->is_eof && 
           msg_data->hotwords_embedding != nullptr) {
         LOG(INFO) << "client done";
+        funasr::AdmissionTicket ticket =
+            admission_.Admit(sample_data_p->Size(), msg_data->config->audio_fs);
+        if (!ticket) {
+          reject_busy(hdl, msg_data, "server busy");
+          break;
+        }
         // for offline, send all receive data to decoder engine
-        std::vector<std::vector<float>> hotwords_embedding_(*(msg_data->hotwords_embedding));
         asio::post(io_decoder_,
                     std::bind(&WebSocketServer::do_decoder, this,
-                              std::move(*(sample_data_p.get())),
-                              std::move(hdl), 
-                              std::ref(msg_data->msg),
-                              std::ref(*thread_lock_p),
-                              std::move(hotwords_embedding_),
-                              msg_data->msg["wav_name"],
-                              msg_data->msg["itn"],
-                              msg_data->msg["audio_fs"],
-                              msg_data->msg["wav_format"],
-                              std::ref(msg_data->decoder_handle),
-                              msg_data->msg["svs_lang"],
-                              msg_data->msg["svs_itn"]));
-        msg_data->msg["access_num"]=(int)(msg_data->msg["access_num"])+1;
+                              sample_data_p->TakeAll(),
+                              std::move(hdl), msg_data,
+                              msg_data->config, std::move(ticket)));
       }
       break;
     }
@@ -401,9 +432,12 @@ void WebSocketServer::on_message(websocketpp::connection_hdl hdl,
       if (isonline) {
         // TODO
       } else {
-        // for offline, we add receive data to end of the sample data vector
-        sample_data_p->insert(sample_data_p->end(), pcm_data,
-                              pcm_data + num_samples);
+        // for offline, we keep the received message at the end of the queue,
+        // its payload is not copied
+        sample_data_p->Push(msg, pcm_data, num_samples);
+        if (admission_.ConnectionOverLimit(sample_data_p->Size())) {
+          reject_busy(hdl, msg_data, "connection audio over limit");
+        }
       }
       break;
     }
@@ -420,12 +454,14 @@ void WebSocketServer::initAsr(std::map<std::string, std::string>& model_path,
     // init model with api
 
     asr_handle = FunOfflineInit(model_path, thread_num, use_gpu, batch_size);
+    FunSetHotwordCacheLimit(asr_handle, (long long)hotword_cache_mb_ << 20,
+                            (long long)hotword_fst_cache_mb_ << 20);
+    admission_.SetLimits(admission_limits_);
+    FunOfflineSetVadParallel(asr_handle, vad_thread_num_, vad_window_seconds_ * 1000);
     LOG(INFO) << "model successfully inited";
     
-    LOG(INFO) << "initAsr run check_and_clean_connection";
-    std::thread clean_thread(&WebSocketServer::check_and_clean_connection,this);  
-    clean_thread.detach();
-    LOG(INFO) << "initAsr run check_and_clean_connection finished";
+    std::thread stats_thread(&WebSocketServer::report_stats, this);
+    stats_thread.detach();
 
   } catch (const std::exception& e) {
     LOG(INFO) << e.what();